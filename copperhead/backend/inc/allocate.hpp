@@ -26,6 +26,7 @@
 #include "cpp_printer.hpp"
 #include "rewriter.hpp"
 #include "prelude/runtime/tags.h"
+#include <map>
 
 /*!
   \file   allocate.hpp
@@ -45,6 +46,18 @@ namespace backend {
 //! A rewrite pass that inserts memory allocation.
 /*! Temporary variables and results need to have storage explicitly
   allocated. This rewrite pass makes this explicit in the program text.
+  It also releases each temporary in the entry point after its last
+  use, so that its storage returns to the memory pool and can be
+  reused by later allocations.  When the entry point returns a
+  sequence, the final phase boundary writes into the container the
+  caller provided, if any, instead of a new allocation.
+
+  A temporary which is dead may also be donated to a later result of
+  the same type, which is then stored in its container. Phase
+  boundaries take temporaries which died at an earlier statement,
+  and scans, sorts and adjacent differences take the container of
+  their input when that input is not used again, so that they run in
+  place.
 */
 class allocate
     : public rewriter<allocate>
@@ -53,8 +66,21 @@ private:
     const copperhead::system_variant& m_target;
     const std::string& m_entry_point;
     bool m_in_entry;
+    //! The result which may be completed into the caller's container
+    std::string m_out;
+    //! The dead temporary donated to the statement being rewritten
+    std::string m_donor;
     std::vector<std::shared_ptr<const statement> > m_allocations;
     std::shared_ptr<const ctype::type_t> container_type(const ctype::type_t& t);
+    //! Finds where each temporary in the entry point becomes dead
+/*! \param donors Filled with the temporary donated to each top
+  level statement which is given one.
+  \return For each top level statement, the temporaries which
+  are not used after it.
+*/
+    std::map<size_t, std::vector<std::string> > liveness(
+        const suite& n,
+        std::map<size_t, std::string>& donors);
 public:
 
 /*!   
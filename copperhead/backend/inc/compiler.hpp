@@ -35,8 +35,10 @@
 #include "tuple_break.hpp"
 #include "dereference.hpp"
 #include "containerize.hpp"
+#include "selectify.hpp"
 #include "prune.hpp"
 #include "iterizer.hpp"
+#include "flatten.hpp"
 #include "backend_translate.hpp"
 
 #include "prelude/runtime/tags.h"
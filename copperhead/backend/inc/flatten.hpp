@@ -0,0 +1,68 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include "node.hpp"
+#include "type.hpp"
+#include "rewriter.hpp"
+#include <string>
+#include <map>
+
+namespace backend {
+
+/*!
+  \addtogroup rewriters
+  @{
+*/
+
+//! A rewrite pass which flattens nested data parallelism
+/*! A \p map over a nested sequence, whose function does nothing but
+  apply \p map, \p reduce, \p scan or \p exclusive_scan to its
+  subsequence, is replaced by the corresponding segmented primitive
+  operating on the flat data of the nested sequence.  The function may
+  first cast literals, as the frontend does for literal arguments of
+  polymorphic functions; the literals are passed directly instead.
+  \p map of \p sum becomes a segmented reduction with \p op_add.
+  Without this rewrite, each inner operation executes sequentially
+  for every element of the outer sequence.
+
+  Only the entry point is rewritten, since the segmented primitives
+  can't be called from within a functor.
+*/
+class flatten
+    : public rewriter<flatten>
+{
+private:
+    const std::string m_entry_point;
+    bool m_in_entry;
+    std::map<std::string, std::shared_ptr<const procedure> > m_procs;
+public:
+    //! Constructor
+/*! 
+  \param entry_point The name of the entry point procedure
+*/
+    flatten(const std::string& entry_point);
+    using rewriter<flatten>::operator();
+    result_type operator()(const suite& n);
+    result_type operator()(const procedure& n);
+    result_type operator()(const bind& n);
+};
+
+/*!
+  @}
+*/
+
+}
@@ -127,4 +127,10 @@ __host__ __device__ a op_not(const a &i) {
     return !i;
 }
 
+//Branch free conditional, emitted by the selectify pass
+template<typename a>
+__host__ __device__ a op_select(const bool &p, const a &t, const a &f) {
+    return p ? t : f;
+}
+
 }
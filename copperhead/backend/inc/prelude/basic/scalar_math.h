@@ -5,6 +5,20 @@ template<typename T>
 T abs(const T& x) {
     return std::abs(x);
 }
+
+//Bring in the float overloads, so that Float32 math stays in single
+//precision instead of round tripping through double
+using std::sqrt;
+using std::exp;
+using std::log;
+using std::sin;
+using std::cos;
+using std::tan;
+using std::erf;
+using std::floor;
+using std::ceil;
+using std::pow;
+using std::atan2;
 #endif
 
 
@@ -44,3 +58,100 @@ struct fn_sqrt {
     }
 };
 
+template<typename T>
+__host__ __device__
+T minimum(const T& x, const T& y) {
+    return (y < x) ? y : x;
+}
+
+template<typename T>
+__host__ __device__
+T maximum(const T& x, const T& y) {
+    return (x < y) ? y : x;
+}
+
+template<typename T>
+struct fn_minimum {
+    typedef T result_type;
+    __host__ __device__
+    T operator()(const T& x, const T& y) const {
+        return minimum(x, y);
+    }
+};
+
+template<typename T>
+struct fn_maximum {
+    typedef T result_type;
+    __host__ __device__
+    T operator()(const T& x, const T& y) const {
+        return maximum(x, y);
+    }
+};
+
+//The float and double specializations call the C library functions
+//directly, which have vector variants (e.g. glibc's libmvec) that
+//the compiler can use when a map is vectorized.  Other types convert
+//through the generic overload.
+#define COPPERHEAD_UNARY_MATH(fn)                       \
+template<typename T>                                    \
+struct fn_##fn {                                        \
+    typedef T result_type;                              \
+    __host__ __device__                                 \
+    T operator()(const T& x) const {                    \
+        return fn(x);                                   \
+    }                                                   \
+};                                                      \
+template<>                                              \
+struct fn_##fn<float> {                                 \
+    typedef float result_type;                          \
+    __host__ __device__                                 \
+    float operator()(const float& x) const {            \
+        return ::fn##f(x);                              \
+    }                                                   \
+};                                                      \
+template<>                                              \
+struct fn_##fn<double> {                                \
+    typedef double result_type;                         \
+    __host__ __device__                                 \
+    double operator()(const double& x) const {          \
+        return ::fn(x);                                 \
+    }                                                   \
+};
+
+#define COPPERHEAD_BINARY_MATH(fn)                                      \
+template<typename T>                                                    \
+struct fn_##fn {                                                        \
+    typedef T result_type;                                              \
+    __host__ __device__                                                 \
+    T operator()(const T& x, const T& y) const {                        \
+        return fn(x, y);                                                \
+    }                                                                   \
+};                                                                      \
+template<>                                                              \
+struct fn_##fn<float> {                                                 \
+    typedef float result_type;                                          \
+    __host__ __device__                                                 \
+    float operator()(const float& x, const float& y) const {            \
+        return ::fn##f(x, y);                                           \
+    }                                                                   \
+};                                                                      \
+template<>                                                              \
+struct fn_##fn<double> {                                                \
+    typedef double result_type;                                         \
+    __host__ __device__                                                 \
+    double operator()(const double& x, const double& y) const {         \
+        return ::fn(x, y);                                              \
+    }                                                                   \
+};
+
+COPPERHEAD_UNARY_MATH(sin)
+COPPERHEAD_UNARY_MATH(cos)
+COPPERHEAD_UNARY_MATH(tan)
+COPPERHEAD_UNARY_MATH(erf)
+COPPERHEAD_UNARY_MATH(floor)
+COPPERHEAD_UNARY_MATH(ceil)
+COPPERHEAD_BINARY_MATH(pow)
+COPPERHEAD_BINARY_MATH(atan2)
+
+#undef COPPERHEAD_UNARY_MATH
+#undef COPPERHEAD_BINARY_MATH
@@ -20,6 +20,7 @@
 
 #include <prelude/config.h>
 #include <prelude/runtime/tags.h>
+#include <prelude/runtime/pool_algorithms.h>
 
 #include <prelude/basic/basic.h>
 #include <prelude/sequences/sequence.h>
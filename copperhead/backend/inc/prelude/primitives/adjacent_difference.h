@@ -22,13 +22,15 @@
 
 namespace copperhead {
 
+namespace detail {
+
+//Thrust permits the result of adjacent_difference to be stored over x
 template<typename F, typename Seq>
 boost::shared_ptr<cuarray>
-adjacent_difference(const F& fn, Seq& x) {
+adjacent_difference_into(const F& fn, Seq& x,
+                         const boost::shared_ptr<cuarray>& result_ary) {
     typedef typename Seq::value_type T;
     typedef typename Seq::tag Tag;
-    boost::shared_ptr<cuarray> result_ary =
-        make_cuarray<T>(x.size());
     sequence<Tag, T> result =
         make_sequence<sequence<Tag, T> >(result_ary,
                                          Tag(),
@@ -41,3 +43,24 @@ adjacent_difference(const F& fn, Seq& x) {
 }
 
 }
+
+template<typename F, typename Seq>
+boost::shared_ptr<cuarray>
+adjacent_difference(const F& fn, Seq& x) {
+    typedef typename Seq::value_type T;
+    return detail::adjacent_difference_into(fn, x,
+                                            make_cuarray<T>(x.size()));
+}
+
+//Stores the result in donor, a container which is no longer needed,
+//when it has the right shape
+template<typename F, typename Seq>
+boost::shared_ptr<cuarray>
+adjacent_difference(const F& fn, Seq& x,
+                    const boost::shared_ptr<cuarray>& donor) {
+    typedef typename Seq::value_type T;
+    return detail::adjacent_difference_into(
+        fn, x, detail::donate_cuarray<T>(donor, x.size()));
+}
+
+}
@@ -17,7 +17,13 @@
 #pragma once
 
 #include <thrust/copy.h>
+#include <thrust/count.h>
 #include <thrust/reduce.h>
+#include <thrust/scan.h>
+#include <thrust/transform.h>
+#include <thrust/for_each.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/zip_iterator.h>
 #include <prelude/runtime/make_cuarray.hpp>
 #include <prelude/runtime/make_sequence.hpp>
 #include <prelude/runtime/tags.h>
@@ -25,8 +31,6 @@
 #include <prelude/primitives/stored_sequence.h>
 #include <prelude/primitives/map.h>
 
-#include <iostream>
-
 namespace copperhead {
 
 namespace detail {
@@ -43,36 +47,154 @@ struct counter {
     }
 };
 
+//Number of elements each block of a blocked compaction processes.
+//Chosen so a block of input stays cache resident between the
+//counting and scattering passes.
+const long filter_block_size = 16384;
+
+//Host systems compact in blocks: each block is counted, then
+//scattered to its offset in the exactly sized result.
+//CUDA uses Thrust's own compaction instead, since a block per thread
+//would leave the device idle.
+template<typename Tag>
+struct blocked_compaction {
+    static const bool value = true;
+};
+
+#ifdef CUDA_SUPPORT
+template<>
+struct blocked_compaction<cuda_tag> {
+    static const bool value = false;
+};
+#endif
+
+template<typename F, typename It>
+struct block_count {
+    typedef long result_type;
+    F m_fn;
+    It m_x;
+    long m_n;
+    block_count(const F& fn, const It& x, const long& n)
+        : m_fn(fn), m_x(x), m_n(n) {}
+    __host__ __device__
+    long operator()(const long& block) const {
+        long begin = block * filter_block_size;
+        long end = begin + filter_block_size;
+        if (end > m_n) {
+            end = m_n;
+        }
+        long count = 0;
+        for(long i = begin; i < end; i++) {
+            if (m_fn(m_x[i])) {
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+template<typename F, typename It, typename Ot>
+struct block_scatter {
+    F m_fn;
+    It m_x;
+    Ot m_o;
+    long m_n;
+    block_scatter(const F& fn, const It& x, const Ot& o, const long& n)
+        : m_fn(fn), m_x(x), m_o(o), m_n(n) {}
+    template<typename Tuple>
+    __host__ __device__
+    void operator()(const Tuple& block_and_offset) const {
+        long begin = thrust::get<0>(block_and_offset) * filter_block_size;
+        long end = begin + filter_block_size;
+        if (end > m_n) {
+            end = m_n;
+        }
+        Ot o = m_o + thrust::get<1>(block_and_offset);
+        for(long i = begin; i < end; i++) {
+            if (m_fn(m_x[i])) {
+                *o = m_x[i];
+                ++o;
+            }
+        }
+    }
+};
+
+template<bool Blocked>
+struct filter_impl {
+    template<typename F, typename Seq>
+    static sp_cuarray fun(const F& fn, Seq& x) {
+        typedef typename Seq::value_type T;
+        typedef typename Seq::tag Tag;
+        typedef typename detail::stored_sequence<Tag, long>::type count_sequence;
+        typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+        typedef typename Seq::iterator_type it;
+        typedef typename sequence_type::iterator_type ot;
+        typedef thrust::counting_iterator<long, Tag> block_iterator;
+
+        long n = x.size();
+        long n_blocks = (n + filter_block_size - 1) / filter_block_size;
+        boost::shared_ptr<cuarray> counts_ary = make_cuarray<long>(n_blocks);
+        count_sequence counts =
+            make_sequence<count_sequence>(counts_ary,
+                                          Tag(),
+                                          true);
+        //First pass: count survivors in each block
+        thrust::transform(block_iterator(0),
+                          block_iterator(n_blocks),
+                          counts.begin(),
+                          block_count<F, it>(fn, x.begin(), n));
+        long result_size = thrust::reduce(counts.begin(), counts.end());
+        thrust::exclusive_scan(counts.begin(), counts.end(), counts.begin());
+
+        boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(result_size);
+        sequence_type result =
+            make_sequence<sequence_type>(result_ary,
+                                         Tag(),
+                                         true);
+        //Second pass: scatter survivors of each block to its offset
+        thrust::for_each(
+            thrust::make_zip_iterator(
+                thrust::make_tuple(block_iterator(0), counts.begin())),
+            thrust::make_zip_iterator(
+                thrust::make_tuple(block_iterator(n_blocks), counts.end())),
+            block_scatter<F, it, ot>(fn, x.begin(), result.begin(), n));
+        return result_ary;
+    }
+};
+
+template<>
+struct filter_impl<false> {
+    template<typename F, typename Seq>
+    static sp_cuarray fun(const F& fn, Seq& x) {
+        typedef typename Seq::value_type T;
+        typedef typename Seq::tag Tag;
+        typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+
+        long result_size = thrust::count_if(x.begin(),
+                                            x.end(),
+                                            fn);
+        boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(result_size);
+        sequence_type result =
+            make_sequence<sequence_type>(result_ary,
+                                         Tag(),
+                                         true);
+        thrust::copy_if(x.begin(),
+                        x.end(),
+                        result.begin(),
+                        fn);
+        return result_ary;
+    }
+};
+
 }
 
+//Filter counts the survivors before allocating, so the result is
+//allocated at exactly its final size and never copied.
 template<typename F, typename Seq>
 sp_cuarray
 filter(const F& fn, Seq& x) {
-    typedef typename Seq::value_type T;
     typedef typename Seq::tag Tag;
-    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
-    typedef typename Seq::iterator_type it;
-    
-    boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(x.size());
-    sequence_type result =
-        make_sequence<sequence_type>(result_ary,
-                                     Tag(),
-                                     true);
-   
-    it result_end = thrust::copy_if(x.begin(),
-                                    x.end(),
-                                    result.begin(),
-                                    fn);
-
-    //XXX Decide if we want to keep this extraneous copy or add a shrink method to cuarray.
-    boost::shared_ptr<cuarray> compacted_ary = make_cuarray<T>(result_end - result.begin());
-    sequence_type compacted =
-        make_sequence<sequence_type>(compacted_ary,
-                                     Tag(),
-                                     true);
-    thrust::copy(result.begin(), result_end, compacted.begin());
-    
-    return compacted_ary;
+    return detail::filter_impl<detail::blocked_compaction<Tag>::value>::fun(fn, x);
 }
 
 }
@@ -0,0 +1,394 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Hash based grouping and joins, which need no sort of their keys.
+//Keys are inserted into an open addressing table whose slots hold
+//the index of a key, or -1 when empty, and live in a cuarray.
+//Insertion is lock free: each slot is claimed with a compare and
+//swap, and a slot whose key is inserted again keeps the smallest
+//index inserted, so that the table's contents do not depend on the
+//order in which threads insert.
+//The table is built and probed on the host.  Keys of device systems
+//are copied to the host first.
+
+#include <vector>
+#include <thrust/copy.h>
+#include <thrust/tuple.h>
+
+#include <prelude/runtime/make_cuarray.hpp>
+#include <prelude/runtime/make_sequence.hpp>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+#include <prelude/primitives/stored_sequence.h>
+#include <prelude/primitives/radix_sort.h>
+
+namespace copperhead {
+namespace detail {
+
+//Keys which compare equal must hash equally, so the zeros of
+//floating point keys are merged before hashing their bits
+template<typename T>
+unsigned long hash_key(const T& x) {
+    unsigned long h = radix_key<T>::to_bits((x == T(0)) ? T(0) : x);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53UL;
+    h ^= h >> 33;
+    return h;
+}
+
+//Elements per block, below which a hash pass is not split further
+static const size_t hash_grain = 16384;
+
+template<typename Tag>
+size_t hash_blocks(size_t n) {
+    size_t blocks = n / hash_grain;
+    size_t limit = 4 * tile_loop<Tag>::threads();
+    blocks = (blocks > limit) ? limit : blocks;
+    return (blocks > 0) ? blocks : 1;
+}
+
+//The passes over a table of m_capacity slots holding indices of
+//m_keys.  Each pass runs over m_blocks blocks of its elements.
+template<typename K>
+struct hash_pass {
+    enum step {
+        clear,          //Empty every slot
+        insert,         //Insert every key
+        find_groups,    //Find each key's first occurrence
+        number_groups,  //Number the first occurrences
+        copy_groups,    //Number the other occurrences
+        count_matches,  //Count the matches of probe keys
+        write_matches   //Write the matching index pairs
+    };
+    step m_step;
+    size_t m_n;
+    size_t m_blocks;
+    const K* m_keys;
+    long* m_table;
+    size_t m_mask;
+    //Group numbering: the first occurrence of each key, the number of
+    //groups first occurring in each block, then the first group
+    //number of each block, and each key's group
+    long* m_first;
+    size_t* m_counts;
+    long* m_groups;
+    //Probing: the probe keys, the table's rows ordered by group, the
+    //position of each group's first row, and the output columns
+    const K* m_probe;
+    const long* m_rows;
+    const long* m_starts;
+    long* m_left;
+    long* m_right;
+
+    size_t begin(size_t j) const {
+        return (m_n * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            switch(m_step) {
+            case clear:
+                for(size_t i = begin(j); i < begin(j + 1); i++) {
+                    m_table[i] = -1;
+                }
+                break;
+            case insert:
+                for(size_t i = begin(j); i < begin(j + 1); i++) {
+                    insert_key(i);
+                }
+                break;
+            case find_groups:
+                find(j);
+                break;
+            case number_groups:
+                number(j);
+                break;
+            case copy_groups:
+                for(size_t i = begin(j); i < begin(j + 1); i++) {
+                    if (m_first[i] != (long)i) {
+                        m_groups[i] = m_groups[m_first[i]];
+                    }
+                }
+                break;
+            case count_matches:
+            case write_matches:
+                match(j);
+                break;
+            }
+        }
+    }
+
+    void insert_key(long i) const {
+        const K& k = m_keys[i];
+        size_t h = hash_key(k) & m_mask;
+        while(true) {
+            long cur = __atomic_load_n(&m_table[h], __ATOMIC_ACQUIRE);
+            if (cur < 0) {
+                if (__atomic_compare_exchange_n(&m_table[h], &cur, i, false,
+                                                __ATOMIC_ACQ_REL,
+                                                __ATOMIC_ACQUIRE)) {
+                    return;
+                }
+                //Another thread claimed the slot, look at it again
+                continue;
+            }
+            if (m_keys[cur] == k) {
+                if ((i < cur) &&
+                    !__atomic_compare_exchange_n(&m_table[h], &cur, i, false,
+                                                 __ATOMIC_ACQ_REL,
+                                                 __ATOMIC_ACQUIRE)) {
+                    continue;
+                }
+                return;
+            }
+            h = (h + 1) & m_mask;
+        }
+    }
+
+    //The index held by the slot of key k, or -1 if k is absent.
+    //A key of the table itself is found by its own index, so that
+    //keys which never compare equal, like NaN, are found too.
+    long lookup(const K& k, long self) const {
+        size_t h = hash_key(k) & m_mask;
+        while(true) {
+            long cur = m_table[h];
+            if ((cur < 0) || (cur == self) || (m_keys[cur] == k)) {
+                return cur;
+            }
+            h = (h + 1) & m_mask;
+        }
+    }
+
+    void find(size_t j) const {
+        size_t firsts = 0;
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            m_first[i] = lookup(m_keys[i], i);
+            if (m_first[i] == (long)i) {
+                firsts++;
+            }
+        }
+        m_counts[j] = firsts;
+    }
+
+    void number(size_t j) const {
+        long group = m_counts[j];
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            if (m_first[i] == (long)i) {
+                m_groups[i] = group++;
+            }
+        }
+    }
+
+    void match(size_t j) const {
+        size_t matches = 0;
+        size_t out = (m_step == write_matches) ? m_counts[j] : 0;
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            long first = lookup(m_probe[i], -1);
+            if (first < 0) {
+                continue;
+            }
+            long group = m_groups[first];
+            long b = m_starts[group];
+            long e = m_starts[group + 1];
+            if (m_step == write_matches) {
+                for(long r = b; r < e; r++, out++) {
+                    m_left[out] = i;
+                    m_right[out] = m_rows[r];
+                }
+            } else {
+                matches += e - b;
+            }
+        }
+        if (m_step == count_matches) {
+            m_counts[j] = matches;
+        }
+    }
+};
+
+//Replaces counts with their exclusive scan, returning the total
+inline size_t scan_counts(std::vector<size_t>& counts) {
+    size_t total = 0;
+    for(size_t j = 0; j < counts.size(); j++) {
+        size_t c = counts[j];
+        counts[j] = total;
+        total += c;
+    }
+    return total;
+}
+
+//A hash table over n keys, which numbers the distinct keys densely,
+//in order of their first occurrence
+template<typename Tag, typename K>
+struct hash_table {
+    const K* m_keys;
+    size_t m_n;
+    size_t m_capacity;
+    sp_cuarray m_table_ary;
+    long* m_table;
+    std::vector<long> m_first;
+    size_t m_group_count;
+
+    hash_table(const K* keys, size_t n)
+        : m_keys(keys), m_n(n), m_capacity(2), m_first(n),
+          m_group_count(0) {
+        //At most half the slots are full, which keeps probes short
+        while(m_capacity < 2 * n) {
+            m_capacity *= 2;
+        }
+        m_table_ary = make_cuarray<long>(m_capacity);
+        m_table = make_sequence<sequence<Tag, long> >(m_table_ary,
+                                                      Tag(),
+                                                      true).m_d;
+    }
+
+    hash_pass<K> pass(typename hash_pass<K>::step step, size_t n) const {
+        hash_pass<K> p;
+        p.m_step = step;
+        p.m_n = n;
+        p.m_blocks = hash_blocks<Tag>(n);
+        p.m_keys = m_keys;
+        p.m_table = m_table;
+        p.m_mask = m_capacity - 1;
+        p.m_first = NULL;
+        p.m_counts = NULL;
+        p.m_groups = NULL;
+        p.m_probe = NULL;
+        p.m_rows = NULL;
+        p.m_starts = NULL;
+        p.m_left = NULL;
+        p.m_right = NULL;
+        return p;
+    }
+
+    //Builds the table, and sets groups[i] to the group of key i
+    void build(long* groups) {
+        hash_pass<K> clearer = pass(hash_pass<K>::clear, m_capacity);
+        tile_loop<Tag>::run(clearer.m_blocks, clearer);
+        hash_pass<K> inserter = pass(hash_pass<K>::insert, m_n);
+        tile_loop<Tag>::run(inserter.m_blocks, inserter);
+
+        hash_pass<K> p = pass(hash_pass<K>::find_groups, m_n);
+        std::vector<size_t> counts(p.m_blocks);
+        p.m_first = m_n ? &m_first[0] : NULL;
+        p.m_counts = &counts[0];
+        p.m_groups = groups;
+        tile_loop<Tag>::run(p.m_blocks, p);
+        m_group_count = scan_counts(counts);
+        p.m_step = hash_pass<K>::number_groups;
+        tile_loop<Tag>::run(p.m_blocks, p);
+        p.m_step = hash_pass<K>::copy_groups;
+        tile_loop<Tag>::run(p.m_blocks, p);
+    }
+};
+
+//Copies a sequence of keys into a cuarray, and views it on the
+//system which builds hash tables
+template<typename Seq>
+sp_cuarray hash_keys(const Seq& x) {
+    typedef typename Seq::tag Tag;
+    typedef typename Seq::value_type K;
+    sp_cuarray keys_ary = make_cuarray<K>(x.size());
+    sequence<Tag, K> keys = make_sequence<sequence<Tag, K> >(keys_ary,
+                                                             Tag(),
+                                                             true);
+    thrust::copy(x.begin(),
+                 x.end(),
+                 keys.begin());
+    return keys_ary;
+}
+
+}
+
+//Numbers the distinct keys of x densely, in order of their first
+//occurrence, and returns the number of each key of x
+template<typename Seq>
+sp_cuarray
+hash_group(const Seq& x) {
+    typedef typename detail::tile_system<typename Seq::tag>::type H;
+    typedef typename Seq::value_type K;
+
+    sp_cuarray keys_ary = detail::hash_keys(x);
+    sequence<H, K> keys = make_sequence<sequence<H, K> >(keys_ary,
+                                                         H(),
+                                                         false);
+    sp_cuarray result_ary = make_cuarray<long>(x.size());
+    sequence<H, long> result = make_sequence<sequence<H, long> >(result_ary,
+                                                                 H(),
+                                                                 true);
+    detail::hash_table<H, K> table(keys.m_d, keys.size());
+    table.build(result.m_d);
+    return result_ary;
+}
+
+//Returns the (i, j) index pairs for which left[i] equals right[j],
+//ordered by i and then by j
+template<typename SeqL, typename SeqR>
+sp_cuarray
+hash_join(const SeqL& left, const SeqR& right) {
+    typedef typename detail::tile_system<typename SeqL::tag>::type H;
+    typedef typename SeqL::value_type K;
+    typedef thrust::tuple<long, long> T;
+
+    //Build a table over the right keys, and order the right rows
+    //by their group
+    sp_cuarray right_ary = detail::hash_keys(right);
+    sequence<H, K> right_keys = make_sequence<sequence<H, K> >(right_ary,
+                                                               H(),
+                                                               false);
+    size_t m = right_keys.size();
+    detail::hash_table<H, K> table(right_keys.m_d, m);
+    std::vector<long> groups(m + 1), sorted_groups(m + 1), rows(m + 1);
+    table.build(&groups[0]);
+    std::copy(groups.begin(), groups.end(), sorted_groups.begin());
+    detail::radix_sort<H>(&sorted_groups[0], m, false, &rows[0]);
+    std::vector<long> starts(table.m_group_count + 1, m);
+    for(size_t r = m; r > 0; r--) {
+        starts[sorted_groups[r - 1]] = r - 1;
+    }
+
+    sp_cuarray left_ary = detail::hash_keys(left);
+    sequence<H, K> left_keys = make_sequence<sequence<H, K> >(left_ary,
+                                                              H(),
+                                                              false);
+    detail::hash_pass<K> p = table.pass(detail::hash_pass<K>::count_matches,
+                                        left_keys.size());
+    std::vector<size_t> counts(p.m_blocks);
+    p.m_counts = &counts[0];
+    p.m_groups = &groups[0];
+    p.m_probe = left_keys.m_d;
+    p.m_rows = &rows[0];
+    p.m_starts = &starts[0];
+    detail::tile_loop<H>::run(p.m_blocks, p);
+    size_t total = detail::scan_counts(counts);
+
+    sp_cuarray result_ary = make_cuarray<T>(total);
+    typedef typename detail::stored_sequence<H, T>::type sequence_type;
+    sequence_type result =
+        make_sequence<sequence_type>(result_ary,
+                                     H(),
+                                     true);
+    p.m_step = detail::hash_pass<K>::write_matches;
+    p.m_left = thrust::get<0>(result.m_seqs).m_d;
+    p.m_right = thrust::get<1>(result.m_seqs).m_d;
+    detail::tile_loop<H>::run(p.m_blocks, p);
+    return result_ary;
+}
+
+}
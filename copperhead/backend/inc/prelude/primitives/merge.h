@@ -0,0 +1,531 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Merges and joins of sorted sequences.
+//merge and merge_by_key merge two sequences sorted by fn, keeping
+//elements of the first sequence before equal elements of the second.
+//set_intersection keeps the elements of the first sequence which are
+//matched by equal elements of the second, as thrust::set_intersection
+//does, and sorted_join returns the index pairs of equal elements.
+//Two sequences are equal when neither compares less than the other.
+//On host systems, work is split by merge path: the merged output is
+//cut into blocks of equal length, and a binary search along each cut
+//finds how many elements of each input precede it, so that blocks
+//take equal shares of the work however the keys are distributed.
+
+#include <vector>
+#include <algorithm>
+#include <thrust/copy.h>
+#include <thrust/merge.h>
+#include <thrust/set_operations.h>
+#include <thrust/tuple.h>
+#include <thrust/iterator/discard_iterator.h>
+#include <thrust/detail/type_traits.h>
+
+#include <prelude/runtime/make_cuarray.hpp>
+#include <prelude/runtime/make_sequence.hpp>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+#include <prelude/primitives/stored_sequence.h>
+
+namespace copperhead {
+namespace detail {
+
+//Elements per block, below which a merge is not split further
+static const size_t merge_grain = 16384;
+
+template<typename Tag>
+size_t merge_blocks(size_t n) {
+    size_t blocks = n / merge_grain;
+    size_t limit = 4 * tile_loop<Tag>::threads();
+    blocks = (blocks > limit) ? limit : blocks;
+    return (blocks > 0) ? blocks : 1;
+}
+
+//The number of elements of a among the first d elements of the merge
+//of a and b, where elements of a go before equal elements of b
+template<typename F, typename IA, typename IB>
+size_t merge_path(F fn, IA a, size_t na, IB b, size_t nb, size_t d) {
+    size_t lo = (d > nb) ? d - nb : 0;
+    size_t hi = (d < na) ? d : na;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (fn(b[d - mid - 1], a[mid])) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+//The first position in [lo, hi) of a whose element is not less
+//than x, or which is greater than x if upper
+template<typename F, typename I, typename T>
+size_t sorted_bound(F fn, I a, size_t lo, size_t hi, const T& x,
+                    bool upper) {
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (upper ? !fn(x, a[mid]) : fn(a[mid], x)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//Merges the keys ka and kb, storing the values va and vb in merged
+//order.  Each block of the output is merged independently.
+template<typename F, typename KA, typename VA,
+         typename KB, typename VB, typename O>
+struct path_merge {
+    F m_fn;
+    KA m_ka;
+    VA m_va;
+    size_t m_na;
+    KB m_kb;
+    VB m_vb;
+    size_t m_nb;
+    O m_out;
+    size_t m_blocks;
+
+    path_merge(const F& fn, KA ka, VA va, size_t na,
+               KB kb, VB vb, size_t nb, O out, size_t blocks)
+        : m_fn(fn), m_ka(ka), m_va(va), m_na(na),
+          m_kb(kb), m_vb(vb), m_nb(nb), m_out(out), m_blocks(blocks) {}
+
+    size_t begin(size_t j) const {
+        return ((m_na + m_nb) * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            merge(j);
+        }
+    }
+
+    void merge(size_t j) const {
+        F fn = m_fn;
+        O out = m_out;
+        size_t d0 = begin(j);
+        size_t d1 = begin(j + 1);
+        size_t i = merge_path(fn, m_ka, m_na, m_kb, m_nb, d0);
+        size_t k = d0 - i;
+        for(size_t d = d0; d < d1; d++) {
+            if ((k == m_nb) || ((i < m_na) && !fn(m_kb[k], m_ka[i]))) {
+                out[d] = m_va[i];
+                i++;
+            } else {
+                out[d] = m_vb[k];
+                k++;
+            }
+        }
+    }
+};
+
+//The passes of a sorted match of left against right, over blocks of
+//their merge.  The first pass finds each left element's equal range
+//in right, and counts its output: the size of that range for a join,
+//and whether it is matched for an intersection.  Each block counts
+//its output, which is scanned on the host, and the second pass
+//writes the output.
+template<typename F, typename IL, typename IR>
+struct sorted_match {
+    enum step {
+        count_join,           //Count the pairs of each left element
+        count_intersection,   //Count whether each left element is kept
+        offset,               //Offset each block's counts
+        write_intersection    //Write the kept left elements
+    };
+    step m_step;
+    F m_fn;
+    IL m_left;
+    size_t m_nl;
+    IR m_right;
+    size_t m_nr;
+    size_t m_blocks;
+    //The start of each left element's equal range in right, the end
+    //of each left element's output, and each block's output count
+    long* m_lo;
+    long* m_ends;
+    size_t* m_counts;
+
+    sorted_match(const F& fn, IL left, size_t nl, IR right, size_t nr,
+                 size_t blocks, long* lo, long* ends)
+        : m_step(count_join), m_fn(fn), m_left(left), m_nl(nl),
+          m_right(right), m_nr(nr), m_blocks(blocks), m_lo(lo),
+          m_ends(ends), m_counts(NULL) {}
+
+    size_t begin(size_t j) const {
+        return ((m_nl + m_nr) * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            if ((m_step == count_join) || (m_step == count_intersection)) {
+                count(j);
+            } else if (m_step == offset) {
+                size_t i0 = merge_path(m_fn, m_left, m_nl, m_right, m_nr,
+                                       begin(j));
+                size_t i1 = merge_path(m_fn, m_left, m_nl, m_right, m_nr,
+                                       begin(j + 1));
+                for(size_t i = i0; i < i1; i++) {
+                    m_ends[i] += m_counts[j];
+                }
+            }
+        }
+    }
+
+    void count(size_t j) const {
+        F fn = m_fn;
+        size_t d0 = begin(j);
+        size_t i0 = merge_path(fn, m_left, m_nl, m_right, m_nr, d0);
+        size_t i1 = merge_path(fn, m_left, m_nl, m_right, m_nr,
+                               begin(j + 1));
+        //Elements of right before the cut precede left[i0] in the
+        //merge, so are less than it
+        size_t lo = d0 - i0;
+        size_t hi = lo;
+        //The first left element equal to left[i]
+        size_t run = (i0 < m_nl) ?
+            sorted_bound(fn, m_left, 0, i0, m_left[i0], false) : i0;
+        size_t total = 0;
+        for(size_t i = i0; i < i1; i++) {
+            bool starts_run = (i == i0) || fn(m_left[i - 1], m_left[i]);
+            if (starts_run && (i > i0)) {
+                run = i;
+            }
+            while((lo < m_nr) && fn(m_right[lo], m_left[i])) {
+                lo++;
+            }
+            if (starts_run) {
+                hi = sorted_bound(fn, m_right, lo, m_nr, m_left[i], true);
+            }
+            m_lo[i] = lo;
+            if (m_step == count_join) {
+                total += hi - lo;
+            } else if (i - run < hi - lo) {
+                total++;
+            }
+            m_ends[i] = total;
+        }
+        m_counts[j] = total;
+    }
+};
+
+//Writes the index pairs of a join, over blocks of equal output
+struct join_writer {
+    const long* m_lo;
+    const long* m_ends;
+    size_t m_nl;
+    size_t m_total;
+    size_t m_blocks;
+    long* m_left;
+    long* m_right;
+
+    size_t begin(size_t j) const {
+        return (m_total * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            size_t o0 = begin(j);
+            size_t o1 = begin(j + 1);
+            //The first left element whose output ends after o0
+            size_t i = std::upper_bound(m_ends, m_ends + m_nl, (long)o0) -
+                m_ends;
+            for(size_t o = o0; o < o1; i++) {
+                long start = (i > 0) ? m_ends[i - 1] : 0;
+                for(; (o < o1) && ((long)o < m_ends[i]); o++) {
+                    m_left[o] = i;
+                    m_right[o] = m_lo[i] + (o - start);
+                }
+            }
+        }
+    }
+};
+
+//Writes the left elements an intersection keeps
+template<typename IL, typename O>
+struct intersection_writer {
+    IL m_left;
+    const long* m_ends;
+    O m_out;
+    size_t m_nl;
+    size_t m_blocks;
+
+    intersection_writer(IL left, const long* ends, O out, size_t nl,
+                        size_t blocks)
+        : m_left(left), m_ends(ends), m_out(out), m_nl(nl),
+          m_blocks(blocks) {}
+
+    size_t begin(size_t j) const {
+        return (m_nl * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        O out = m_out;
+        for(size_t j = b; j < e; j++) {
+            for(size_t i = begin(j); i < begin(j + 1); i++) {
+                long start = (i > 0) ? m_ends[i - 1] : 0;
+                if (m_ends[i] > start) {
+                    out[start] = m_left[i];
+                }
+            }
+        }
+    }
+};
+
+//Runs the counting passes of a sorted match on a host system H,
+//leaving m_ends holding the end of each left element's output, and
+//returns the total output
+template<typename H, typename F, typename IL, typename IR>
+size_t count_sorted_match(sorted_match<F, IL, IR>& m,
+                          typename sorted_match<F, IL, IR>::step step) {
+    std::vector<size_t> counts(m.m_blocks);
+    m.m_step = step;
+    m.m_counts = &counts[0];
+    tile_loop<H>::run(m.m_blocks, m);
+    size_t total = 0;
+    for(size_t j = 0; j < m.m_blocks; j++) {
+        size_t c = counts[j];
+        counts[j] = total;
+        total += c;
+    }
+    m.m_step = sorted_match<F, IL, IR>::offset;
+    tile_loop<H>::run(m.m_blocks, m);
+    m.m_counts = NULL;
+    return total;
+}
+
+//Joins left and right on the host system H
+template<typename H, typename F, typename IL, typename IR>
+sp_cuarray join_sorted(const F& fn, IL left, size_t nl,
+                       IR right, size_t nr) {
+    typedef thrust::tuple<long, long> T;
+    typedef typename stored_sequence<H, T>::type sequence_type;
+
+    std::vector<long> lo(nl + 1), ends(nl + 1);
+    sorted_match<F, IL, IR> m(fn, left, nl, right, nr,
+                              merge_blocks<H>(nl + nr), &lo[0], &ends[0]);
+    size_t total =
+        count_sorted_match<H>(m, sorted_match<F, IL, IR>::count_join);
+
+    sp_cuarray result_ary = make_cuarray<T>(total);
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        H(),
+                                                        true);
+    join_writer w;
+    w.m_lo = &lo[0];
+    w.m_ends = &ends[0];
+    w.m_nl = nl;
+    w.m_total = total;
+    w.m_blocks = merge_blocks<H>(total);
+    w.m_left = thrust::get<0>(result.m_seqs).m_d;
+    w.m_right = thrust::get<1>(result.m_seqs).m_d;
+    tile_loop<H>::run(w.m_blocks, w);
+    return result_ary;
+}
+
+//Copies x, to be worked on by another system
+template<typename Seq>
+sp_cuarray staged_copy(const Seq& x) {
+    typedef typename Seq::tag Tag;
+    typedef typename Seq::value_type T;
+    typedef typename stored_sequence<Tag, T>::type sequence_type;
+    sp_cuarray result_ary = make_cuarray<T>(x.size());
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        Tag(),
+                                                        true);
+    thrust::copy(x.begin(),
+                 x.end(),
+                 result.begin());
+    return result_ary;
+}
+
+//Views a copy made by staged_copy on system H
+template<typename H, typename T>
+typename stored_sequence<H, T>::type
+staged_view(const sp_cuarray& ary) {
+    typedef typename stored_sequence<H, T>::type sequence_type;
+    return make_sequence<sequence_type>(ary, H(), false);
+}
+
+//Merges on host systems
+template<typename Tag, typename F, typename SeqKA, typename SeqVA,
+         typename SeqKB, typename SeqVB, typename O>
+typename thrust::detail::enable_if<tile_loop<Tag>::value>::type
+merge_values(const F& fn, SeqKA& ka, SeqVA& va, SeqKB& kb, SeqVB& vb,
+             O out) {
+    path_merge<F,
+               typename SeqKA::iterator_type,
+               typename SeqVA::iterator_type,
+               typename SeqKB::iterator_type,
+               typename SeqVB::iterator_type,
+               O> m(fn, ka.begin(), va.begin(), ka.size(),
+                    kb.begin(), vb.begin(), kb.size(), out,
+                    merge_blocks<Tag>(ka.size() + kb.size()));
+    tile_loop<Tag>::run(m.m_blocks, m);
+}
+
+template<typename Tag, typename F, typename SeqKA, typename SeqVA,
+         typename SeqKB, typename SeqVB, typename O>
+typename thrust::detail::enable_if<!tile_loop<Tag>::value>::type
+merge_values(const F& fn, SeqKA& ka, SeqVA& va, SeqKB& kb, SeqVB& vb,
+             O out) {
+    thrust::merge_by_key(ka.begin(), ka.end(),
+                         kb.begin(), kb.end(),
+                         va.begin(), vb.begin(),
+                         thrust::make_discard_iterator(), out,
+                         fn);
+}
+
+//Intersects on host systems
+template<typename Tag, typename F, typename SeqA, typename SeqB>
+typename thrust::detail::enable_if<tile_loop<Tag>::value, sp_cuarray>::type
+intersect_sorted(const F& fn, SeqA& a, SeqB& b) {
+    typedef typename SeqA::value_type T;
+    typedef typename stored_sequence<Tag, T>::type sequence_type;
+    typedef typename SeqA::iterator_type IA;
+    typedef typename SeqB::iterator_type IB;
+
+    size_t na = a.size();
+    std::vector<long> lo(na + 1), ends(na + 1);
+    sorted_match<F, IA, IB> m(fn, a.begin(), na, b.begin(), b.size(),
+                              merge_blocks<Tag>(na + b.size()),
+                              &lo[0], &ends[0]);
+    size_t total = count_sorted_match<Tag>(
+        m, sorted_match<F, IA, IB>::count_intersection);
+
+    sp_cuarray result_ary = make_cuarray<T>(total);
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        Tag(),
+                                                        true);
+    intersection_writer<IA, typename sequence_type::iterator_type> w(
+        a.begin(), &ends[0], result.begin(), na, merge_blocks<Tag>(na));
+    tile_loop<Tag>::run(w.m_blocks, w);
+    return result_ary;
+}
+
+//Other systems intersect into a buffer as long as a, and copy out
+//the elements kept
+template<typename Tag, typename F, typename SeqA, typename SeqB>
+typename thrust::detail::enable_if<!tile_loop<Tag>::value, sp_cuarray>::type
+intersect_sorted(const F& fn, SeqA& a, SeqB& b) {
+    typedef typename SeqA::value_type T;
+    typedef typename stored_sequence<Tag, T>::type sequence_type;
+
+    sp_cuarray buffer_ary = make_cuarray<T>(a.size());
+    sequence_type buffer = make_sequence<sequence_type>(buffer_ary,
+                                                        Tag(),
+                                                        true);
+    size_t total = thrust::set_intersection(a.begin(), a.end(),
+                                            b.begin(), b.end(),
+                                            buffer.begin(),
+                                            fn) - buffer.begin();
+    sp_cuarray result_ary = make_cuarray<T>(total);
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        Tag(),
+                                                        true);
+    thrust::copy(buffer.begin(),
+                 buffer.begin() + total,
+                 result.begin());
+    return result_ary;
+}
+
+//Joins on host systems
+template<typename Tag, typename F, typename SeqL, typename SeqR>
+typename thrust::detail::enable_if<tile_loop<Tag>::value, sp_cuarray>::type
+join_sequences(const F& fn, SeqL& left, SeqR& right) {
+    return join_sorted<Tag>(fn, left.begin(), left.size(),
+                            right.begin(), right.size());
+}
+
+//Other systems are joined on the host
+template<typename Tag, typename F, typename SeqL, typename SeqR>
+typename thrust::detail::enable_if<!tile_loop<Tag>::value, sp_cuarray>::type
+join_sequences(const F& fn, SeqL& left, SeqR& right) {
+    typedef typename tile_system<Tag>::type H;
+    sp_cuarray left_ary = staged_copy(left);
+    sp_cuarray right_ary = staged_copy(right);
+    typedef typename SeqL::value_type L;
+    typedef typename SeqR::value_type R;
+    typename stored_sequence<H, L>::type l = staged_view<H, L>(left_ary);
+    typename stored_sequence<H, R>::type r = staged_view<H, R>(right_ary);
+    return join_sorted<H>(fn, l.begin(), l.size(), r.begin(), r.size());
+}
+
+}
+
+//Merges a and b, which are sorted by fn.  The merge is stable:
+//elements of a go before equal elements of b.
+template<typename F, typename SeqA, typename SeqB>
+sp_cuarray
+merge(const F& fn, SeqA& a, SeqB& b) {
+    typedef typename SeqA::tag Tag;
+    typedef typename SeqA::value_type T;
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+
+    sp_cuarray result_ary = make_cuarray<T>(a.size() + b.size());
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        Tag(),
+                                                        true);
+    detail::merge_values<Tag>(fn, a, a, b, b, result.begin());
+    return result_ary;
+}
+
+//Merges keys_a and keys_b, which are sorted by fn, and returns
+//values_a and values_b in merged order.  Values may be zipped
+//sequences.
+template<typename F, typename SeqKA, typename SeqVA,
+         typename SeqKB, typename SeqVB>
+sp_cuarray
+merge_by_key(const F& fn, SeqKA& keys_a, SeqVA& values_a,
+             SeqKB& keys_b, SeqVB& values_b) {
+    typedef typename SeqVA::tag Tag;
+    typedef typename SeqVA::value_type T;
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+
+    sp_cuarray result_ary = make_cuarray<T>(keys_a.size() + keys_b.size());
+    sequence_type result = make_sequence<sequence_type>(result_ary,
+                                                        Tag(),
+                                                        true);
+    detail::merge_values<Tag>(fn, keys_a, values_a, keys_b, values_b,
+                              result.begin());
+    return result_ary;
+}
+
+//The elements of a matched by equal elements of b, where a and b are
+//sorted by fn.  An element which occurs m times in a and n times in
+//b is kept min(m, n) times.
+template<typename F, typename SeqA, typename SeqB>
+sp_cuarray
+set_intersection(const F& fn, SeqA& a, SeqB& b) {
+    return detail::intersect_sorted<typename SeqA::tag>(fn, a, b);
+}
+
+//Returns the (i, j) index pairs for which left[i] equals right[j],
+//where left and right are sorted by fn, ordered by i and then by j
+template<typename F, typename SeqL, typename SeqR>
+sp_cuarray
+sorted_join(const F& fn, SeqL& left, SeqR& right) {
+    return detail::join_sequences<typename SeqL::tag>(fn, left, right);
+}
+
+}
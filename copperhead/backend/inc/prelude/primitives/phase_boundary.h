@@ -22,6 +22,8 @@
 #include <thrust/tuple.h>
 
 #include <prelude/primitives/stored_sequence.h>
+#include <prelude/primitives/simd_map.h>
+#include <prelude/primitives/stencil.h>
 
 namespace copperhead {
 
@@ -36,12 +38,29 @@ boost::shared_ptr<cuarray> phase_boundary(const Seq& in) {
         make_sequence<sequence_type>(result_ary,
                                      Tag(),
                                      true);
-    thrust::copy(in.begin(),
-                 in.end(),
-                 result.begin());
+    detail::materialize(in, result);
     return result_ary;
 }
 
+//Completes in into the caller provided container out, when it has
+//the right shape, instead of allocating a new container.
+template<typename Seq>
+boost::shared_ptr<cuarray> phase_boundary(const Seq& in,
+                                          const sp_cuarray& out) {
+    typedef typename Seq::value_type T;
+    typedef typename Seq::tag Tag;
+    if (!detail::fits<T>(out, in.size())) {
+        return phase_boundary(in);
+    }
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+    sequence_type result =
+        make_sequence<sequence_type>(out,
+                                     Tag(),
+                                     true);
+    detail::materialize(in, result);
+    return out;
+}
+
 namespace detail {
 template<typename Seq>
 struct pb_result_type {
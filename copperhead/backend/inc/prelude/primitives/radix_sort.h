@@ -0,0 +1,277 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Parallel LSD radix sort for host systems.
+//Keys are mapped to unsigned integers whose order matches the order
+//of the keys, then sorted a byte at a time, least significant byte
+//first.  Each pass splits the keys into blocks: the blocks count
+//their digits in parallel, the counts are scanned in digit major
+//order, and the blocks then scatter their keys in parallel.  Since
+//every pass is stable, so is the sort.
+//Passes where every key has the same digit are skipped, which makes
+//sorting small or narrowly ranged keys cheap.
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <thrust/detail/type_traits.h>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+
+namespace copperhead {
+namespace detail {
+
+//Maps keys to unsigned integers of the same width which sort in the
+//same order
+template<typename T>
+struct radix_key {
+    static const bool value = false;
+};
+
+template<typename T, typename U>
+struct signed_radix_key {
+    static const bool value = true;
+    typedef U bits_type;
+    static const U sign = U(1) << (sizeof(U) * 8 - 1);
+    static U to_bits(const T& x) {
+        return U(x) ^ sign;
+    }
+    static U to_exact_bits(const T& x) {
+        return to_bits(x);
+    }
+    static T from_bits(const U& b) {
+        return T(b ^ sign);
+    }
+};
+
+//Negative floating point numbers have their magnitude bits
+//reversed, positive ones have their sign bit set
+template<typename T, typename U>
+struct floating_radix_key {
+    static const bool value = true;
+    typedef U bits_type;
+    static const U sign = U(1) << (sizeof(U) * 8 - 1);
+    //Keys which compare equal must have equal bits, so that a stable
+    //sort keeps them in order: -0.0 sorts as +0.0
+    static U to_bits(const T& x) {
+        return to_exact_bits((x == T(0)) ? T(0) : x);
+    }
+    //Keeps the sign of zero, so that keys survive the round trip
+    static U to_exact_bits(const T& x) {
+        U b;
+        std::memcpy(&b, &x, sizeof(U));
+        return (b & sign) ? ~b : (b | sign);
+    }
+    static T from_bits(const U& b) {
+        U u = (b & sign) ? (b ^ sign) : ~b;
+        T x;
+        std::memcpy(&x, &u, sizeof(U));
+        return x;
+    }
+};
+
+template<>
+struct radix_key<int>
+    : signed_radix_key<int, unsigned int> {};
+
+template<>
+struct radix_key<long>
+    : signed_radix_key<long, unsigned long> {};
+
+template<>
+struct radix_key<float>
+    : floating_radix_key<float, unsigned int> {};
+
+template<>
+struct radix_key<double>
+    : floating_radix_key<double, unsigned long> {};
+
+//Keys can be radix sorted on this system
+template<typename Tag, typename T>
+struct radix_sortable {
+    static const bool value =
+        tile_loop<Tag>::value && radix_key<T>::value;
+};
+
+static const size_t radix_bits = 8;
+static const size_t radix_digits = size_t(1) << radix_bits;
+//Elements per block, below which a pass is not split further
+static const size_t radix_grain = 16384;
+
+//One pass of the radix sort, over m_blocks blocks of m_n elements.
+//Payload indices move with the keys when m_in_idx is not NULL.
+template<typename U>
+struct radix_pass {
+    size_t m_n;
+    size_t m_blocks;
+    size_t m_shift;
+    const U* m_in;
+    U* m_out;
+    const long* m_in_idx;
+    long* m_out_idx;
+    //m_counts[b * radix_digits + d]: digits d in block b, later the
+    //position where block b writes its next digit d
+    size_t* m_counts;
+    bool m_scatter;
+
+    size_t begin(size_t b) const {
+        return (m_n * b) / m_blocks;
+    }
+
+    size_t digit(const U& k) const {
+        return (k >> m_shift) & (radix_digits - 1);
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            if (m_scatter) {
+                scatter(j);
+            } else {
+                count(j);
+            }
+        }
+    }
+
+    void count(size_t j) const {
+        size_t* counts = m_counts + j * radix_digits;
+        for(size_t d = 0; d < radix_digits; d++) {
+            counts[d] = 0;
+        }
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            counts[digit(m_in[i])]++;
+        }
+    }
+
+    void scatter(size_t j) const {
+        size_t* offsets = m_counts + j * radix_digits;
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            size_t dst = offsets[digit(m_in[i])]++;
+            m_out[dst] = m_in[i];
+            if (m_in_idx != NULL) {
+                m_out_idx[dst] = m_in_idx[i];
+            }
+        }
+    }
+};
+
+template<typename T, typename U>
+struct radix_convert {
+    T* m_keys;
+    U* m_bits;
+    long* m_idx;
+    size_t m_n;
+    size_t m_blocks;
+    U m_flip;
+    bool m_to_bits;
+
+    void operator()(size_t b, size_t e) const {
+        size_t lo = (m_n * b) / m_blocks;
+        size_t hi = (m_n * e) / m_blocks;
+        for(size_t i = lo; i < hi; i++) {
+            if (m_to_bits && (m_idx != NULL)) {
+                m_bits[i] = radix_key<T>::to_bits(m_keys[i]) ^ m_flip;
+                m_idx[i] = i;
+            } else if (m_to_bits) {
+                //Without indices the order of equal keys can't be
+                //seen, but the sign of a zero key can
+                m_bits[i] = radix_key<T>::to_exact_bits(m_keys[i]) ^ m_flip;
+            } else {
+                m_keys[i] = radix_key<T>::from_bits(m_bits[i] ^ m_flip);
+            }
+        }
+    }
+};
+
+//Sorts the n keys in place, in descending order if descending is
+//set.  If idx is not NULL, idx[i] is set to the original position
+//of the key which ends up at position i.
+template<typename Tag, typename T>
+void radix_sort(T* keys, size_t n, bool descending, long* idx) {
+    typedef typename radix_key<T>::bits_type U;
+    size_t blocks = n / radix_grain;
+    size_t limit = 4 * tile_loop<Tag>::threads();
+    blocks = (blocks > limit) ? limit : blocks;
+    blocks = (blocks > 0) ? blocks : 1;
+
+    std::vector<U> bits0(n), bits1(n);
+    std::vector<long> idx0, idx1;
+    if (idx != NULL) {
+        idx0.resize(n);
+        idx1.resize(n);
+    }
+    U* in = n ? &bits0[0] : NULL;
+    U* out = n ? &bits1[0] : NULL;
+    long* in_idx = (n && idx) ? &idx0[0] : NULL;
+    long* out_idx = (n && idx) ? &idx1[0] : NULL;
+
+    radix_convert<T, U> convert;
+    convert.m_keys = keys;
+    convert.m_bits = in;
+    convert.m_idx = in_idx;
+    convert.m_n = n;
+    convert.m_blocks = blocks;
+    convert.m_flip = descending ? ~U(0) : U(0);
+    convert.m_to_bits = true;
+    tile_loop<Tag>::run(blocks, convert);
+
+    std::vector<size_t> counts(blocks * radix_digits);
+    for(size_t shift = 0; shift < sizeof(U) * 8; shift += radix_bits) {
+        radix_pass<U> pass;
+        pass.m_n = n;
+        pass.m_blocks = blocks;
+        pass.m_shift = shift;
+        pass.m_in = in;
+        pass.m_out = out;
+        pass.m_in_idx = in_idx;
+        pass.m_out_idx = out_idx;
+        pass.m_counts = &counts[0];
+        pass.m_scatter = false;
+        tile_loop<Tag>::run(blocks, pass);
+
+        //Scan the counts in digit major order, so that each block
+        //writes each digit after the earlier blocks
+        size_t total = 0;
+        bool trivial = false;
+        for(size_t d = 0; d < radix_digits; d++) {
+            size_t start = total;
+            for(size_t j = 0; j < blocks; j++) {
+                size_t c = counts[j * radix_digits + d];
+                counts[j * radix_digits + d] = total;
+                total += c;
+            }
+            trivial = trivial || (total - start == n);
+        }
+        if (trivial) {
+            continue;
+        }
+        pass.m_scatter = true;
+        tile_loop<Tag>::run(blocks, pass);
+        std::swap(in, out);
+        std::swap(in_idx, out_idx);
+    }
+
+    convert.m_bits = in;
+    convert.m_to_bits = false;
+    tile_loop<Tag>::run(blocks, convert);
+    if (idx != NULL) {
+        std::copy(in_idx, in_idx + n, idx);
+    }
+}
+
+}
+}
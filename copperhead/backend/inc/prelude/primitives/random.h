@@ -0,0 +1,36 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <prelude/sequences/random_sequence.h>
+
+namespace copperhead {
+
+template<typename Tag>
+random_uniform_sequence<Tag> random_uniform(const Tag& t,
+                                            const long& seed,
+                                            const long& length) {
+    return random_uniform_sequence<Tag>(seed, length);
+}
+
+template<typename Tag>
+random_normal_sequence<Tag> random_normal(const Tag& t,
+                                          const long& seed,
+                                          const long& length) {
+    return random_normal_sequence<Tag>(seed, length);
+}
+
+}
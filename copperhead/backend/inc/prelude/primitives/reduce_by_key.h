@@ -0,0 +1,360 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Keyed reductions.
+//reduce_by_key reduces each run of consecutive equal keys, as
+//thrust::reduce_by_key does.  group_aggregate groups all equal keys,
+//as a group-by does, and computes the sum, minimum, maximum and
+//count of each group's values in a single pass.
+//Both produce a sequence of tuples, holding each key followed by its
+//reduction.
+//On host systems, runs are reduced by blocks in parallel: the blocks
+//first count the runs which start in them, which places every run's
+//result, and then reduce those runs.  Values at the start of a block
+//which continue a run from an earlier block are folded into that
+//run's result afterwards, in block order.
+
+#include <vector>
+#include <thrust/tuple.h>
+#include <thrust/copy.h>
+#include <thrust/reduce.h>
+#include <thrust/inner_product.h>
+#include <thrust/functional.h>
+#include <thrust/iterator/iterator_traits.h>
+#include <thrust/iterator/permutation_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <thrust/detail/type_traits.h>
+
+#include <prelude/basic/functors.h>
+#include <prelude/runtime/make_cuarray.hpp>
+#include <prelude/runtime/make_sequence.hpp>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+#include <prelude/sequences/zipped_sequence.h>
+#include <prelude/primitives/stored_sequence.h>
+#include <prelude/primitives/sort.h>
+
+namespace copperhead {
+namespace detail {
+
+//Sum, minimum, maximum and count of a group's values
+template<typename V>
+struct group_stats {
+    typedef thrust::tuple<V, V, V, long> type;
+};
+
+template<typename V>
+struct stats_of {
+    typedef typename group_stats<V>::type result_type;
+    __host__ __device__
+    result_type operator()(const V& v) const {
+        return result_type(v, v, v, 1);
+    }
+};
+
+template<typename V>
+struct merge_stats {
+    typedef typename group_stats<V>::type result_type;
+    __host__ __device__
+    result_type operator()(const result_type& a, const result_type& b) const {
+        const V& min_a = thrust::get<1>(a);
+        const V& min_b = thrust::get<1>(b);
+        const V& max_a = thrust::get<2>(a);
+        const V& max_b = thrust::get<2>(b);
+        return result_type(thrust::get<0>(a) + thrust::get<0>(b),
+                           (min_b < min_a) ? min_b : min_a,
+                           (max_a < max_b) ? max_b : max_a,
+                           thrust::get<3>(a) + thrust::get<3>(b));
+    }
+};
+
+//Elements per block, below which a keyed reduction is not split
+static const size_t keyed_grain = 16384;
+
+//Counts the runs which start in each block of a keyed reduction on a
+//host system
+template<typename KI>
+struct run_counter {
+    KI m_keys;
+    size_t m_n;
+    size_t m_blocks;
+    size_t* m_heads;
+
+    run_counter(KI keys, size_t n, size_t blocks, size_t* heads)
+        : m_keys(keys), m_n(n), m_blocks(blocks), m_heads(heads) {}
+
+    size_t begin(size_t j) const {
+        return (m_n * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            size_t heads = 0;
+            for(size_t i = begin(j); i < begin(j + 1); i++) {
+                if ((i == 0) || !(m_keys[i] == m_keys[i - 1])) {
+                    heads++;
+                }
+            }
+            m_heads[j] = heads;
+        }
+    }
+};
+
+//Reduces the runs in each block.  m_heads[j] is the output slot of
+//the first run starting in block j.  Values before that run belong
+//to a run from an earlier block, and are reduced into m_partials[j].
+template<typename KI, typename SI, typename F, typename KO, typename SO>
+struct run_reducer {
+    typedef typename thrust::iterator_value<SI>::type state_type;
+    KI m_keys;
+    SI m_states;
+    size_t m_n;
+    size_t m_blocks;
+    F m_fn;
+    KO m_keys_out;
+    SO m_states_out;
+    const size_t* m_heads;
+    state_type* m_partials;
+    char* m_has_partial;
+
+    run_reducer(KI keys, SI states, size_t n, size_t blocks, const F& fn,
+                KO keys_out, SO states_out, const size_t* heads,
+                state_type* partials, char* has_partial)
+        : m_keys(keys), m_states(states), m_n(n), m_blocks(blocks),
+          m_fn(fn), m_keys_out(keys_out), m_states_out(states_out),
+          m_heads(heads), m_partials(partials), m_has_partial(has_partial) {}
+
+    size_t begin(size_t j) const {
+        return (m_n * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            reduce(j);
+        }
+    }
+
+    void reduce(size_t j) const {
+        F fn = m_fn;
+        KO keys_out = m_keys_out;
+        SO states_out = m_states_out;
+        size_t slot = m_heads[j];
+        bool open = false;
+        state_type s = state_type();
+        m_has_partial[j] = 0;
+        for(size_t i = begin(j); i < begin(j + 1); i++) {
+            state_type v = m_states[i];
+            if ((i == 0) || !(m_keys[i] == m_keys[i - 1])) {
+                if (open) {
+                    states_out[slot] = s;
+                    slot++;
+                }
+                keys_out[slot] = m_keys[i];
+                s = v;
+                open = true;
+            } else if (open) {
+                s = fn(s, v);
+            } else if (m_has_partial[j]) {
+                m_partials[j] = fn(m_partials[j], v);
+            } else {
+                m_partials[j] = v;
+                m_has_partial[j] = 1;
+            }
+        }
+        if (open) {
+            states_out[slot] = s;
+        }
+    }
+};
+
+//Reduces the runs of equal keys in keys, whose values are states,
+//with fn.  runs() counts the runs, so that the output can be
+//allocated, then reduce() stores each run's key and reduction.
+template<typename Tag, typename KI, typename SI, typename F,
+         typename Enable = void>
+struct keyed_reduction {
+    typedef typename thrust::iterator_value<KI>::type key_type;
+    KI m_keys;
+    SI m_states;
+    size_t m_n;
+    F m_fn;
+
+    keyed_reduction(KI keys, SI states, size_t n, const F& fn)
+        : m_keys(keys), m_states(states), m_n(n), m_fn(fn) {}
+
+    size_t runs() {
+        if (m_n == 0) {
+            return 0;
+        }
+        return thrust::inner_product(m_keys + 1, m_keys + m_n,
+                                     m_keys, size_t(1),
+                                     thrust::plus<size_t>(),
+                                     thrust::not_equal_to<key_type>());
+    }
+
+    template<typename KO, typename SO>
+    void reduce(KO keys_out, SO states_out) {
+        thrust::reduce_by_key(m_keys, m_keys + m_n, m_states,
+                              keys_out.begin(), states_out.begin(),
+                              thrust::equal_to<key_type>(), m_fn);
+    }
+};
+
+template<typename Tag, typename KI, typename SI, typename F>
+struct keyed_reduction<Tag, KI, SI, F,
+                       typename thrust::detail::enable_if<
+                           tile_loop<Tag>::value>::type> {
+    typedef typename thrust::iterator_value<SI>::type state_type;
+    KI m_keys;
+    SI m_states;
+    size_t m_n;
+    F m_fn;
+    size_t m_blocks;
+    std::vector<size_t> m_heads;
+
+    keyed_reduction(KI keys, SI states, size_t n, const F& fn)
+        : m_keys(keys), m_states(states), m_n(n), m_fn(fn) {
+        m_blocks = n / keyed_grain;
+        size_t limit = 4 * tile_loop<Tag>::threads();
+        m_blocks = (m_blocks > limit) ? limit : m_blocks;
+        m_blocks = (m_blocks > 0) ? m_blocks : 1;
+        m_heads.resize(m_blocks + 1);
+    }
+
+    size_t runs() {
+        run_counter<KI> counter(m_keys, m_n, m_blocks, &m_heads[0]);
+        tile_loop<Tag>::run(m_blocks, counter);
+        size_t total = 0;
+        for(size_t j = 0; j < m_blocks; j++) {
+            size_t heads = m_heads[j];
+            m_heads[j] = total;
+            total += heads;
+        }
+        m_heads[m_blocks] = total;
+        return total;
+    }
+
+    template<typename KO, typename SO>
+    void reduce(KO keys_out, SO states_out) {
+        std::vector<state_type> partials(m_blocks);
+        std::vector<char> has_partial(m_blocks);
+        run_reducer<KI, SI, F, KO, SO> reducer(
+            m_keys, m_states, m_n, m_blocks, m_fn, keys_out, states_out,
+            &m_heads[0], &partials[0], &has_partial[0]);
+        tile_loop<Tag>::run(m_blocks, reducer);
+        //Fold runs which cross blocks, in order.  The first block
+        //starts with a run, so never has a partial.
+        F fn = m_fn;
+        for(size_t j = 1; j < m_blocks; j++) {
+            if (has_partial[j]) {
+                size_t slot = m_heads[j] - 1;
+                states_out[slot] = fn(state_type(states_out[slot]),
+                                      partials[j]);
+            }
+        }
+    }
+};
+
+}
+
+//Reduces each run of consecutive equal keys.  Returns a sequence
+//holding, for each run, its key and the reduction of its values
+//with fn.
+template<typename F, typename SeqK, typename SeqV>
+sp_cuarray
+reduce_by_key(const F& fn, SeqK& keys, SeqV& values) {
+    typedef typename SeqK::tag Tag;
+    typedef typename SeqK::value_type K;
+    typedef typename SeqV::value_type V;
+    typedef thrust::tuple<K, V> T;
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+
+    detail::keyed_reduction<Tag,
+                            typename SeqK::iterator_type,
+                            typename SeqV::iterator_type,
+                            F> reduction(keys.begin(), values.begin(),
+                                         keys.size(), fn);
+    sp_cuarray result_ary = make_cuarray<T>(reduction.runs());
+    sequence_type result =
+        make_sequence<sequence_type>(result_ary,
+                                     Tag(),
+                                     true);
+    reduction.reduce(thrust::get<0>(result.m_seqs),
+                     thrust::get<1>(result.m_seqs));
+    return result_ary;
+}
+
+//Groups values by key, whether or not equal keys are adjacent.
+//Returns a sequence holding, for each distinct key in ascending
+//order, the key and the sum, minimum, maximum and count of its
+//values.
+template<typename SeqK, typename SeqV>
+sp_cuarray
+group_aggregate(SeqK& keys, SeqV& values) {
+    typedef typename SeqK::tag Tag;
+    typedef typename SeqK::value_type K;
+    typedef typename SeqV::value_type V;
+    typedef thrust::tuple<K, V, V, V, long> T;
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+
+    //Sort a copy of the keys, remembering where each came from
+    sp_cuarray sorted_ary = make_cuarray<K>(keys.size());
+    sequence<Tag, K> sorted = make_sequence<sequence<Tag, K> >(sorted_ary,
+                                                               Tag(),
+                                                               true);
+    thrust::copy(keys.begin(),
+                 keys.end(),
+                 sorted.begin());
+    sp_cuarray idx_ary = make_cuarray<long>(keys.size());
+    sequence<Tag, long> idx = make_sequence<sequence<Tag, long> >(idx_ary,
+                                                                  Tag(),
+                                                                  true);
+    detail::sort_indices(fn_cmp_lt<K>(), sorted, idx);
+
+    //Each value, taken in key order, starts as its own statistics
+    typedef thrust::permutation_iterator<
+        typename SeqV::iterator_type,
+        typename sequence<Tag, long>::iterator_type> ValueIterator;
+    typedef thrust::transform_iterator<
+        detail::stats_of<V>, ValueIterator> StatsIterator;
+    StatsIterator stats(ValueIterator(values.begin(), idx.begin()),
+                        detail::stats_of<V>());
+    detail::keyed_reduction<Tag,
+                            typename sequence<Tag, K>::iterator_type,
+                            StatsIterator,
+                            detail::merge_stats<V> > reduction(
+                                sorted.begin(), stats, sorted.size(),
+                                detail::merge_stats<V>());
+    sp_cuarray result_ary = make_cuarray<T>(reduction.runs());
+    sequence_type result =
+        make_sequence<sequence_type>(result_ary,
+                                     Tag(),
+                                     true);
+    typedef typename detail::stored_sequence<Tag, V>::type SeqS;
+    typedef typename detail::stored_sequence<Tag, long>::type SeqC;
+    typedef zipped_sequence<thrust::tuple<SeqS, SeqS, SeqS, SeqC> > stats_sequence;
+    stats_sequence stats_out(
+        thrust::make_tuple(thrust::get<1>(result.m_seqs),
+                           thrust::get<2>(result.m_seqs),
+                           thrust::get<3>(result.m_seqs),
+                           thrust::get<4>(result.m_seqs)));
+    reduction.reduce(thrust::get<0>(result.m_seqs), stats_out);
+    return result_ary;
+}
+
+}
@@ -27,13 +27,17 @@
 
 namespace copperhead {
 
+namespace detail {
+
+//Each scan reads an element of x before it writes the same position
+//of the result, so the result may be stored over x.
+
 template<typename F, typename Seq>
 sp_cuarray
-scan(const F& fn, Seq& x) {
+scan_into(const F& fn, Seq& x, const sp_cuarray& result_ary) {
     typedef typename F::result_type T;
     typedef typename Seq::tag Tag;
     typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
-    boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(x.size());
     sequence_type result =
         make_sequence<sequence_type>(result_ary,
                                      Tag(),
@@ -48,14 +52,13 @@ scan(const F& fn, Seq& x) {
 
 template<typename F, typename Seq>
 sp_cuarray
-rscan(const F& fn, Seq& x) {
+rscan_into(const F& fn, Seq& x, const sp_cuarray& result_ary) {
     typedef typename F::result_type T;
     typedef typename Seq::tag Tag;
     typedef typename thrust::reverse_iterator<typename Seq::iterator_type> iterator_type;
     iterator_type drbegin(x.end());
     iterator_type drend(x.begin());
     typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
-    boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(x.size());
     sequence_type result =
         make_sequence<sequence_type>(result_ary,
                                      Tag(),
@@ -67,11 +70,11 @@ rscan(const F& fn, Seq& x) {
 
 template<typename F, typename Seq>
 sp_cuarray
-exclusive_scan(const F& fn, const typename Seq::value_type& p, Seq& x) {
+exclusive_scan_into(const F& fn, const typename Seq::value_type& p, Seq& x,
+                    const sp_cuarray& result_ary) {
     typedef typename F::result_type T;
     typedef typename Seq::tag Tag;
     typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
-    boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(x.size());
     sequence_type result =
         make_sequence<sequence_type>(result_ary,
                                      Tag(),
@@ -87,14 +90,14 @@ exclusive_scan(const F& fn, const typename Seq::value_type& p, Seq& x) {
 
 template<typename F, typename Seq>
 sp_cuarray
-exclusive_rscan(const F& fn, const typename Seq::value_type& p, Seq& x) {
+exclusive_rscan_into(const F& fn, const typename Seq::value_type& p, Seq& x,
+                     const sp_cuarray& result_ary) {
     typedef typename F::result_type T;
     typedef typename Seq::tag Tag;
     typedef typename thrust::reverse_iterator<typename Seq::iterator_type> iterator_type;
     iterator_type drbegin(x.end());
     iterator_type drend(x.begin());
     typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
-    boost::shared_ptr<cuarray> result_ary = make_cuarray<T>(x.size());
     sequence_type result =
         make_sequence<sequence_type>(result_ary,
                                      Tag(),
@@ -105,3 +108,73 @@ exclusive_rscan(const F& fn, const typename Seq::value_type& p, Seq& x) {
 }
 
 }
+
+template<typename F, typename Seq>
+sp_cuarray
+scan(const F& fn, Seq& x) {
+    typedef typename F::result_type T;
+    return detail::scan_into(fn, x, make_cuarray<T>(x.size()));
+}
+
+//The last argument of each scan below is a container which is no
+//longer needed, such as the storage of x when x is not used again.
+//The scan is stored there when it has the right shape.
+
+template<typename F, typename Seq>
+sp_cuarray
+scan(const F& fn, Seq& x, const sp_cuarray& donor) {
+    typedef typename F::result_type T;
+    return detail::scan_into(fn, x,
+                             detail::donate_cuarray<T>(donor, x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+rscan(const F& fn, Seq& x) {
+    typedef typename F::result_type T;
+    return detail::rscan_into(fn, x, make_cuarray<T>(x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+rscan(const F& fn, Seq& x, const sp_cuarray& donor) {
+    typedef typename F::result_type T;
+    return detail::rscan_into(fn, x,
+                              detail::donate_cuarray<T>(donor, x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+exclusive_scan(const F& fn, const typename Seq::value_type& p, Seq& x) {
+    typedef typename F::result_type T;
+    return detail::exclusive_scan_into(fn, p, x,
+                                       make_cuarray<T>(x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+exclusive_scan(const F& fn, const typename Seq::value_type& p, Seq& x,
+               const sp_cuarray& donor) {
+    typedef typename F::result_type T;
+    return detail::exclusive_scan_into(
+        fn, p, x, detail::donate_cuarray<T>(donor, x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+exclusive_rscan(const F& fn, const typename Seq::value_type& p, Seq& x) {
+    typedef typename F::result_type T;
+    return detail::exclusive_rscan_into(fn, p, x,
+                                        make_cuarray<T>(x.size()));
+}
+
+template<typename F, typename Seq>
+sp_cuarray
+exclusive_rscan(const F& fn, const typename Seq::value_type& p, Seq& x,
+                const sp_cuarray& donor) {
+    typedef typename F::result_type T;
+    return detail::exclusive_rscan_into(
+        fn, p, x, detail::donate_cuarray<T>(donor, x.size()));
+}
+
+}
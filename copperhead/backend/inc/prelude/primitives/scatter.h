@@ -26,6 +26,13 @@
 
 namespace copperhead {
 
+//permute and scatter write through a permutation iterator, which the
+//pool and OpenMP systems copy in parallel.  When indices repeat, the
+//value which lands in a repeated position depends on the order in
+//which the copies complete, and may differ from run to run.  This
+//matches the prelude, which leaves the choice among duplicates
+//unspecified.  permute expects its indices to be a permutation.
+
 template<typename SeqX, typename SeqI>
 sp_cuarray
 permute(const SeqX& x, const SeqI& i) {
@@ -0,0 +1,333 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Vectorized binary search.
+//lower_bound and upper_bound find, for each needle, the first position
+//in a sorted haystack whose element is not less than the needle, or
+//which is greater than the needle.  The result is a sequence of
+//positions, ready to gather with.
+//On host systems, the search depends on the needles: a few needles
+//are searched for in the haystack directly, sorted needles walk the
+//haystack in step, split into blocks by merge path, and other needles
+//are searched for in a copy of the haystack in Eytzinger order.
+//Eytzinger order lays a binary search tree out breadth first, so that
+//the first levels of every search share a few cache lines, and the
+//next levels can be prefetched.
+
+#include <vector>
+#include <thrust/binary_search.h>
+#include <thrust/functional.h>
+#include <thrust/iterator/iterator_traits.h>
+#include <thrust/detail/type_traits.h>
+
+#include <prelude/runtime/make_cuarray.hpp>
+#include <prelude/runtime/make_sequence.hpp>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+#include <prelude/primitives/merge.h>
+
+namespace copperhead {
+namespace detail {
+
+//Whether haystack element h goes before needle x: when it is less
+//than x for lower bounds, and when it is not greater for upper bounds
+template<bool Upper>
+struct bound_order {
+    template<typename H, typename N>
+    bool operator()(const H& h, const N& x) const {
+        return Upper ? !(x < h) : (h < x);
+    }
+};
+
+//Checks whether each block of needles is sorted, including its first
+//needle against the last needle of the block before
+template<typename IN>
+struct sorted_check {
+    IN m_needles;
+    size_t m_n;
+    size_t m_blocks;
+    char* m_sorted;
+
+    sorted_check(IN needles, size_t n, size_t blocks, char* sorted)
+        : m_needles(needles), m_n(n), m_blocks(blocks), m_sorted(sorted) {}
+
+    size_t begin(size_t j) const {
+        return (m_n * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            m_sorted[j] = 1;
+            size_t i = (begin(j) > 0) ? begin(j) : 1;
+            for(; i < begin(j + 1); i++) {
+                if (m_needles[i] < m_needles[i - 1]) {
+                    m_sorted[j] = 0;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+//Searches for each needle in the haystack directly
+template<bool Upper, typename IH, typename IN>
+struct direct_search {
+    typedef typename thrust::iterator_value<IH>::type value_type;
+    IH m_haystack;
+    size_t m_nh;
+    IN m_needles;
+    size_t m_nn;
+    long* m_out;
+    size_t m_blocks;
+
+    direct_search(IH haystack, size_t nh, IN needles, size_t nn,
+                  long* out, size_t blocks)
+        : m_haystack(haystack), m_nh(nh), m_needles(needles), m_nn(nn),
+          m_out(out), m_blocks(blocks) {}
+
+    size_t begin(size_t j) const {
+        return (m_nn * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        for(size_t j = b; j < e; j++) {
+            for(size_t i = begin(j); i < begin(j + 1); i++) {
+                m_out[i] = sorted_bound(thrust::less<value_type>(),
+                                        m_haystack, 0, m_nh,
+                                        m_needles[i], Upper);
+            }
+        }
+    }
+};
+
+//Walks sorted needles and the haystack in step, as a merge of the
+//needles into the haystack would.  Each block of the merge starts
+//where merge path places it.
+template<bool Upper, typename IH, typename IN>
+struct path_search {
+    IH m_haystack;
+    size_t m_nh;
+    IN m_needles;
+    size_t m_nn;
+    long* m_out;
+    size_t m_blocks;
+
+    path_search(IH haystack, size_t nh, IN needles, size_t nn,
+                long* out, size_t blocks)
+        : m_haystack(haystack), m_nh(nh), m_needles(needles), m_nn(nn),
+          m_out(out), m_blocks(blocks) {}
+
+    size_t begin(size_t j) const {
+        return ((m_nn + m_nh) * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        bound_order<Upper> before;
+        for(size_t j = b; j < e; j++) {
+            size_t d0 = begin(j);
+            size_t d1 = begin(j + 1);
+            size_t i = merge_path(before, m_needles, m_nn,
+                                  m_haystack, m_nh, d0);
+            size_t k = d0 - i;
+            for(size_t d = d0; d < d1; d++) {
+                if ((k == m_nh) ||
+                    ((i < m_nn) && !before(m_haystack[k], m_needles[i]))) {
+                    m_out[i] = k;
+                    i++;
+                } else {
+                    k++;
+                }
+            }
+        }
+    }
+};
+
+//A sorted haystack in Eytzinger order.  m_tree[k] has children
+//m_tree[2k] and m_tree[2k + 1], and m_tree[1] is the root.
+//m_pos[k] is the position of m_tree[k] in the haystack, and m_pos[0]
+//is the haystack's length.
+template<typename T>
+struct eytzinger_tree {
+    size_t m_n;
+    std::vector<T> m_tree;
+    std::vector<long> m_pos;
+
+    template<typename IH>
+    eytzinger_tree(IH haystack, size_t n)
+        : m_n(n), m_tree(n + 1), m_pos(n + 1) {
+        m_pos[0] = n;
+        fill(haystack, 0, 1);
+    }
+
+    //Fills the subtree at k in order, from haystack position i, and
+    //returns the position after it
+    template<typename IH>
+    size_t fill(IH haystack, size_t i, size_t k) {
+        if (k <= m_n) {
+            i = fill(haystack, i, 2 * k);
+            m_tree[k] = haystack[i];
+            m_pos[k] = i;
+            i = fill(haystack, i + 1, 2 * k + 1);
+        }
+        return i;
+    }
+};
+
+//Descendants this many nodes along, four levels down, are prefetched
+static const size_t eytzinger_lookahead = 16;
+
+//Searches for each needle in an Eytzinger ordered haystack
+template<bool Upper, typename T, typename IN>
+struct eytzinger_search {
+    const T* m_tree;
+    const long* m_pos;
+    size_t m_nh;
+    IN m_needles;
+    size_t m_nn;
+    long* m_out;
+    size_t m_blocks;
+
+    eytzinger_search(const eytzinger_tree<T>& tree, IN needles, size_t nn,
+                     long* out, size_t blocks)
+        : m_tree(&tree.m_tree[0]), m_pos(&tree.m_pos[0]), m_nh(tree.m_n),
+          m_needles(needles), m_nn(nn), m_out(out), m_blocks(blocks) {}
+
+    size_t begin(size_t j) const {
+        return (m_nn * j) / m_blocks;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        bound_order<Upper> before;
+        for(size_t j = b; j < e; j++) {
+            for(size_t i = begin(j); i < begin(j + 1); i++) {
+                T x = m_needles[i];
+                size_t k = 1;
+                while(k <= m_nh) {
+                    __builtin_prefetch(m_tree + k * eytzinger_lookahead);
+                    k = 2 * k + (before(m_tree[k], x) ? 1 : 0);
+                }
+                //The last left turn of the search found the bound.
+                //Undo the right turns after it, and it.
+                k >>= __builtin_ffsl(~(long)k);
+                m_out[i] = m_pos[k];
+            }
+        }
+    }
+};
+
+//Searches on host systems
+template<bool Upper, typename Tag, typename SeqH, typename SeqN>
+typename thrust::detail::enable_if<tile_loop<Tag>::value>::type
+search_sorted(SeqH& haystack, SeqN& needles, sequence<Tag, long>& result) {
+    typedef typename SeqH::value_type T;
+    typedef typename SeqH::iterator_type IH;
+    typedef typename SeqN::iterator_type IN;
+
+    size_t nh = haystack.size();
+    size_t nn = needles.size();
+    long* out = result.m_d;
+
+    //Searching directly reads about log2(nh) elements per needle,
+    //the other searches read the whole haystack
+    size_t depth = 1;
+    while((size_t(1) << depth) < nh) {
+        depth++;
+    }
+    if (nn * depth < nh) {
+        direct_search<Upper, IH, IN> s(haystack.begin(), nh,
+                                       needles.begin(), nn, out,
+                                       merge_blocks<Tag>(nn * depth));
+        tile_loop<Tag>::run(s.m_blocks, s);
+        return;
+    }
+
+    size_t check_blocks = merge_blocks<Tag>(nn);
+    std::vector<char> sorted(check_blocks);
+    sorted_check<IN> check(needles.begin(), nn, check_blocks, &sorted[0]);
+    tile_loop<Tag>::run(check_blocks, check);
+    bool needles_sorted = true;
+    for(size_t j = 0; j < check_blocks; j++) {
+        needles_sorted = needles_sorted && sorted[j];
+    }
+
+    if (needles_sorted) {
+        path_search<Upper, IH, IN> s(haystack.begin(), nh,
+                                     needles.begin(), nn, out,
+                                     merge_blocks<Tag>(nh + nn));
+        tile_loop<Tag>::run(s.m_blocks, s);
+    } else {
+        eytzinger_tree<T> tree(haystack.begin(), nh);
+        eytzinger_search<Upper, T, IN> s(tree, needles.begin(), nn, out,
+                                         merge_blocks<Tag>(nn));
+        tile_loop<Tag>::run(s.m_blocks, s);
+    }
+}
+
+template<bool Upper, typename Tag, typename SeqH, typename SeqN>
+typename thrust::detail::enable_if<!tile_loop<Tag>::value>::type
+search_sorted(SeqH& haystack, SeqN& needles, sequence<Tag, long>& result) {
+    if (Upper) {
+        thrust::upper_bound(haystack.begin(), haystack.end(),
+                            needles.begin(), needles.end(),
+                            result.begin());
+    } else {
+        thrust::lower_bound(haystack.begin(), haystack.end(),
+                            needles.begin(), needles.end(),
+                            result.begin());
+    }
+}
+
+template<bool Upper, typename SeqH, typename SeqN>
+sp_cuarray
+bound_search(SeqH& haystack, SeqN& needles) {
+    typedef typename SeqN::tag Tag;
+    sp_cuarray result_ary = make_cuarray<long>(needles.size());
+    sequence<Tag, long> result =
+        make_sequence<sequence<Tag, long> >(result_ary,
+                                            Tag(),
+                                            true);
+    search_sorted<Upper>(haystack, needles, result);
+    return result_ary;
+}
+
+}
+
+//For each needle, the first position in haystack, which is sorted in
+//ascending order, whose element is not less than the needle
+template<typename SeqH, typename SeqN>
+sp_cuarray
+lower_bound(SeqH& haystack, SeqN& needles) {
+    return detail::bound_search<false>(haystack, needles);
+}
+
+//For each needle, the first position in haystack, which is sorted in
+//ascending order, whose element is greater than the needle
+template<typename SeqH, typename SeqN>
+sp_cuarray
+upper_bound(SeqH& haystack, SeqN& needles) {
+    return detail::bound_search<true>(haystack, needles);
+}
+
+//numpy's searchsorted, which finds lower bounds
+template<typename SeqH, typename SeqN>
+sp_cuarray
+searchsorted(SeqH& haystack, SeqN& needles) {
+    return detail::bound_search<false>(haystack, needles);
+}
+
+}
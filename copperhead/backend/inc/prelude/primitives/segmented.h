@@ -0,0 +1,217 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+#include <thrust/reduce.h>
+#include <thrust/scan.h>
+#include <thrust/fill.h>
+#include <thrust/scatter.h>
+#include <thrust/transform.h>
+#include <thrust/functional.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <prelude/runtime/make_cuarray.hpp>
+#include <prelude/runtime/make_sequence.hpp>
+#include <prelude/runtime/tags.h>
+#include <prelude/sequences/sequence.h>
+#include <prelude/primitives/stored_sequence.h>
+
+//Segmented primitives operate directly on the descriptor and data of
+//a nested sequence.  Every element is tagged with the index of its
+//segment, and the keyed Thrust algorithms then parallelize over all
+//elements, so skewed segment lengths don't unbalance the work.
+
+namespace copperhead {
+
+namespace detail {
+
+//Maps an element index to the index of the segment holding it,
+//by binary search in the segment descriptor
+template<typename Tag>
+struct segment_of {
+    typedef long result_type;
+    sequence<Tag, size_t, 0> m_desc;
+    long m_n;
+    segment_of(const sequence<Tag, size_t, 0>& desc)
+        : m_desc(desc), m_n(desc.size() - 1) {}
+    __host__ __device__
+    long operator()(const size_t& i) const {
+        //Invariant: m_desc[lo] <= i < m_desc[hi]
+        long lo = 0;
+        long hi = m_n;
+        while (hi - lo > 1) {
+            long mid = (lo + hi) / 2;
+            if (m_desc[mid] <= i) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+};
+
+template<typename F, typename T>
+struct apply_prefix {
+    typedef T result_type;
+    F m_fn;
+    T m_p;
+    apply_prefix(const F& fn, const T& p)
+        : m_fn(fn), m_p(p) {}
+    __host__ __device__
+    T operator()(const T& x) const {
+        return m_fn(m_p, x);
+    }
+};
+
+struct rebase {
+    typedef size_t result_type;
+    size_t m_b;
+    rebase(const size_t& b) : m_b(b) {}
+    __host__ __device__
+    size_t operator()(const size_t& x) const {
+        return x - m_b;
+    }
+};
+
+template<typename Tag, typename T>
+struct segments {
+    typedef thrust::counting_iterator<size_t, Tag> index_iterator;
+    typedef thrust::transform_iterator<segment_of<Tag>, index_iterator> key_iterator;
+    typedef typename sequence<Tag, T, 0>::iterator_type value_iterator;
+
+    size_t m_begin;
+    size_t m_end;
+    key_iterator m_keys;
+    value_iterator m_values;
+
+    segments(const sequence<Tag, T, 1>& x)
+        : m_begin(dereference(x.m_d, 0)),
+          m_end(dereference(x.m_d, x.m_d.size() - 1)),
+          m_keys(index_iterator(m_begin), segment_of<Tag>(x.m_d)),
+          m_values(x.m_s.begin() + m_begin) {}
+    size_t size() const {
+        return m_end - m_begin;
+    }
+    key_iterator keys_end() const {
+        return m_keys + size();
+    }
+};
+
+//Allocates a nested result with the same segments as x
+template<typename Tag, typename T, typename R>
+sp_cuarray make_segmented_result(const sequence<Tag, T, 1>& x,
+                                 const segments<Tag, T>& segs,
+                                 sequence<Tag, R, 1>& result) {
+    sp_cuarray result_ary = make_cuarray<R>(x.size(), segs.size());
+    result = make_sequence<sequence<Tag, R, 1> >(result_ary,
+                                                 Tag(),
+                                                 true);
+    thrust::transform(x.m_d.begin(), x.m_d.end(),
+                      result.m_d.begin(),
+                      rebase(segs.m_begin));
+    return result_ary;
+}
+
+}
+
+template<typename F, typename Tag, typename T>
+sp_cuarray
+segmented_map(const F& fn, const sequence<Tag, T, 1>& x) {
+    detail::segments<Tag, T> segs(x);
+    sequence<Tag, typename F::result_type, 1> result;
+    sp_cuarray result_ary = detail::make_segmented_result(x, segs, result);
+    thrust::transform(segs.m_values, segs.m_values + segs.size(),
+                      result.m_s.begin(),
+                      fn);
+    return result_ary;
+}
+
+template<typename F, typename Tag, typename T>
+sp_cuarray
+segmented_reduce(const F& fn, const sequence<Tag, T, 1>& x,
+                 const typename F::result_type& p) {
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
+    typedef typename detail::stored_sequence<Tag, long>::type key_sequence;
+    detail::segments<Tag, T> segs(x);
+    size_t n = x.size();
+
+    sp_cuarray result_ary = make_cuarray<T>(n);
+    sequence_type result =
+        make_sequence<sequence_type>(result_ary,
+                                     Tag(),
+                                     true);
+    //Empty segments reduce to the prefix
+    thrust::fill(result.begin(), result.end(), p);
+
+    sp_cuarray keys_ary = make_cuarray<long>(n);
+    key_sequence keys =
+        make_sequence<key_sequence>(keys_ary,
+                                    Tag(),
+                                    true);
+    sp_cuarray values_ary = make_cuarray<T>(n);
+    sequence_type values =
+        make_sequence<sequence_type>(values_ary,
+                                     Tag(),
+                                     true);
+    typename sequence_type::iterator_type values_end =
+        thrust::reduce_by_key(segs.m_keys, segs.keys_end(),
+                              segs.m_values,
+                              keys.begin(),
+                              values.begin(),
+                              thrust::equal_to<long>(),
+                              fn).second;
+    thrust::transform(values.begin(), values_end,
+                      values.begin(),
+                      detail::apply_prefix<F, T>(fn, p));
+    thrust::scatter(values.begin(), values_end,
+                    keys.begin(),
+                    result.begin());
+    return result_ary;
+}
+
+template<typename F, typename Tag, typename T>
+sp_cuarray
+segmented_scan(const F& fn, const sequence<Tag, T, 1>& x) {
+    detail::segments<Tag, T> segs(x);
+    sequence<Tag, T, 1> result;
+    sp_cuarray result_ary = detail::make_segmented_result(x, segs, result);
+    thrust::inclusive_scan_by_key(segs.m_keys, segs.keys_end(),
+                                  segs.m_values,
+                                  result.m_s.begin(),
+                                  thrust::equal_to<long>(),
+                                  fn);
+    return result_ary;
+}
+
+template<typename F, typename Tag, typename T>
+sp_cuarray
+segmented_exclusive_scan(const F& fn, const typename F::result_type& p,
+                         const sequence<Tag, T, 1>& x) {
+    detail::segments<Tag, T> segs(x);
+    sequence<Tag, T, 1> result;
+    sp_cuarray result_ary = detail::make_segmented_result(x, segs, result);
+    thrust::exclusive_scan_by_key(segs.m_keys, segs.keys_end(),
+                                  segs.m_values,
+                                  result.m_s.begin(),
+                                  p,
+                                  thrust::equal_to<long>(),
+                                  fn);
+    return result_ary;
+}
+
+}
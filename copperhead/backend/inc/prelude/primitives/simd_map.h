@@ -0,0 +1,384 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//A vectorizable path for completing maps on host systems.
+//Completing a map through thrust::copy goes through a
+//transform_iterator over a zip_iterator of sequence iterators, which
+//compilers rarely vectorize.  When every input of the map is a flat
+//sequence of arithmetic values, and the result is stored in flat
+//sequences of arithmetic values, we instead run a plain indexed loop,
+//marked for vectorization.
+//Shifted and rotated inputs are peeled: the loop runs over the
+//interior of the range, where they read at a fixed offset, and
+//only the few boundary elements go through the checked accessors.
+//Defining COPPERHEAD_NO_SIMD disables this path.
+
+#include <cstddef>
+#include <thrust/copy.h>
+#include <thrust/tuple.h>
+#include <thrust/detail/type_traits.h>
+#include <thrust/detail/tuple_meta_transform.h>
+#include <thrust/detail/tuple_transform.h>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/pool_algorithms.h>
+#include <prelude/sequences/sequence.h>
+#include <prelude/sequences/zipped_sequence.h>
+#include <prelude/sequences/transformed_sequence.h>
+#include <prelude/sequences/shifted_sequence.h>
+#include <prelude/sequences/rotated_sequence.h>
+
+#if defined(OMP_SUPPORT) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#define COPPERHEAD_SIMD _Pragma("omp simd")
+#elif defined(__GNUC__) && !defined(__clang__) && !defined(__CUDACC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define COPPERHEAD_SIMD _Pragma("GCC ivdep")
+#else
+#define COPPERHEAD_SIMD
+#endif
+
+namespace copperhead {
+namespace detail {
+
+//How each host system runs the loop over [0, n)
+template<typename Tag>
+struct simd_loop {
+    static const bool value = false;
+};
+
+template<>
+struct simd_loop<cpp_tag> {
+    static const bool value = true;
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        body(0, n);
+    }
+};
+
+template<>
+struct simd_loop<pool_tag> {
+    static const bool value = true;
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        parallel_for(n, pool_grain, body);
+    }
+};
+
+#ifdef OMP_SUPPORT
+template<>
+struct simd_loop<omp_tag> {
+    static const bool value = true;
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+#ifdef _OPENMP
+        #pragma omp parallel
+        {
+            size_t t = omp_get_thread_num();
+            size_t p = omp_get_num_threads();
+            body((n * t) / p, (n * (t + 1)) / p);
+        }
+#else
+        body(0, n);
+#endif
+    }
+};
+#endif
+
+//Is every sequence in S flat, holding arithmetic values?
+template<typename S>
+struct flat_arithmetic {
+    static const bool value = false;
+};
+
+template<typename Tag, typename T>
+struct flat_arithmetic<sequence<Tag, T, 0> > {
+    static const bool value = thrust::detail::is_arithmetic<T>::value;
+};
+
+template<typename Tag, typename T>
+struct flat_arithmetic<shifted_sequence<sequence<Tag, T, 0> > > {
+    static const bool value = thrust::detail::is_arithmetic<T>::value;
+};
+
+template<typename Tag, typename T>
+struct flat_arithmetic<rotated_sequence<sequence<Tag, T, 0> > > {
+    static const bool value = thrust::detail::is_arithmetic<T>::value;
+};
+
+template<typename HT, typename TT>
+struct flat_arithmetic<thrust::detail::cons<HT, TT> > {
+    static const bool value =
+        flat_arithmetic<HT>::value && flat_arithmetic<TT>::value;
+};
+
+template<>
+struct flat_arithmetic<thrust::null_type> {
+    static const bool value = true;
+};
+
+template<typename T0, typename T1, typename T2, typename T3, typename T4,
+         typename T5, typename T6, typename T7, typename T8, typename T9>
+struct flat_arithmetic<
+    thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> > {
+    typedef thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> T;
+    static const bool value =
+        flat_arithmetic<
+            thrust::detail::cons<
+                typename T::head_type,
+                typename T::tail_type> >::value;
+};
+
+template<typename S>
+struct flat_arithmetic<zipped_sequence<S> > {
+    static const bool value = flat_arithmetic<S>::value;
+};
+
+//The interior of an input: a view reading the same elements as S
+//for indices in the bounds narrowed by interior_bound, without
+//boundary checks
+template<typename S>
+struct interior {
+    typedef S type;
+    static type view(const S& s) {
+        return s;
+    }
+    static void bound(const S&, size_t&, size_t&) {}
+};
+
+template<typename S>
+void interior_bound(const S& s, size_t& lo, size_t& hi) {
+    interior<S>::bound(s, lo, hi);
+}
+
+template<typename HT, typename TT>
+void interior_bound(const thrust::detail::cons<HT, TT>& s,
+                    size_t& lo, size_t& hi) {
+    interior_bound(s.get_head(), lo, hi);
+    interior_bound(s.get_tail(), lo, hi);
+}
+
+inline void interior_bound(const thrust::null_type&, size_t&, size_t&) {}
+
+//A flat sequence read at a fixed offset from its base pointer.
+//Indexing from the base, rather than advancing the pointer by the
+//offset, never forms an address outside the underlying array, even
+//when the offset is negative or wider than the array.
+//Only indexed, never iterated.
+template<typename Tag, typename T>
+struct offset_sequence
+    : sequence<Tag, T, 0> {
+    std::ptrdiff_t m_offset;
+    offset_sequence(const sequence<Tag, T, 0>& s, std::ptrdiff_t offset)
+        : sequence<Tag, T, 0>(s), m_offset(offset) {}
+    T& operator[](const size_t& i) const {
+        return this->m_d[(std::ptrdiff_t)i + m_offset];
+    }
+};
+
+//Shifted and rotated views of flat sequences have offset pointers as
+//their interiors
+template<typename S>
+struct shifted_interior {
+    typedef typename S::tag Tag;
+    typedef typename S::value_type T;
+    typedef offset_sequence<Tag, T> type;
+    static type view(const S& s) {
+        return type(s.m_s, (std::ptrdiff_t)s.m_amount);
+    }
+    static void bound(const S& s, size_t& lo, size_t& hi) {
+        size_t b = s.interior_begin();
+        size_t e = s.interior_end();
+        lo = (b > lo) ? b : lo;
+        hi = (e < hi) ? e : hi;
+    }
+};
+
+template<typename Tag, typename T>
+struct interior<shifted_sequence<sequence<Tag, T, 0> > >
+    : shifted_interior<shifted_sequence<sequence<Tag, T, 0> > > {};
+
+template<typename Tag, typename T>
+struct interior<rotated_sequence<sequence<Tag, T, 0> > >
+    : shifted_interior<rotated_sequence<sequence<Tag, T, 0> > > {};
+
+struct interior_viewer {
+    template<typename S>
+    typename interior<S>::type operator()(const S& s) const {
+        return interior<S>::view(s);
+    }
+};
+
+template<typename T0, typename T1, typename T2, typename T3, typename T4,
+         typename T5, typename T6, typename T7, typename T8, typename T9>
+struct interior<
+    thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> > {
+    typedef thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> S;
+    typedef typename thrust::detail::tuple_meta_transform<
+        S, interior>::type type;
+    static type view(const S& s) {
+        return thrust::detail::tuple_host_transform<interior>(
+            s, interior_viewer());
+    }
+    static void bound(const S& s, size_t& lo, size_t& hi) {
+        typedef thrust::detail::cons<
+            typename S::head_type,
+            typename S::tail_type> cons_type;
+        interior_bound(static_cast<const cons_type&>(s), lo, hi);
+    }
+};
+
+template<typename S>
+struct interior<zipped_sequence<S> > {
+    typedef zipped_sequence<typename interior<S>::type> type;
+    static type view(const zipped_sequence<S>& s) {
+        return type(interior<S>::view(s.m_seqs));
+    }
+    static void bound(const zipped_sequence<S>& s, size_t& lo, size_t& hi) {
+        interior<S>::bound(s.m_seqs, lo, hi);
+    }
+};
+
+//Writes element i of a map's result into flat storage
+template<typename S>
+struct flat_store {};
+
+template<typename Tag, typename T>
+struct flat_store<sequence<Tag, T, 0> > {
+    T* m_d;
+    flat_store(const sequence<Tag, T, 0>& s) : m_d(s.m_d) {}
+    template<typename V>
+    void operator()(size_t i, const V& v) const {
+        m_d[i] = v;
+    }
+};
+
+template<typename HT, typename TT>
+struct flat_store<thrust::detail::cons<HT, TT> > {
+    flat_store<HT> m_head;
+    flat_store<TT> m_tail;
+    flat_store(const thrust::detail::cons<HT, TT>& s)
+        : m_head(s.get_head()), m_tail(s.get_tail()) {}
+    template<typename V>
+    void operator()(size_t i, const V& v) const {
+        m_head(i, v.get_head());
+        m_tail(i, v.get_tail());
+    }
+};
+
+template<>
+struct flat_store<thrust::null_type> {
+    flat_store(const thrust::null_type&) {}
+    void operator()(size_t, const thrust::null_type&) const {}
+};
+
+template<typename T0, typename T1, typename T2, typename T3, typename T4,
+         typename T5, typename T6, typename T7, typename T8, typename T9>
+struct flat_store<
+    thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> >
+    : flat_store<
+    thrust::detail::cons<
+        typename thrust::tuple<T0, T1, T2, T3, T4,
+                               T5, T6, T7, T8, T9>::head_type,
+        typename thrust::tuple<T0, T1, T2, T3, T4,
+                               T5, T6, T7, T8, T9>::tail_type> > {
+    typedef thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> T;
+    typedef thrust::detail::cons<
+        typename T::head_type,
+        typename T::tail_type> cons_type;
+    flat_store(const T& s) : flat_store<cons_type>(s) {}
+};
+
+template<typename S>
+struct flat_store<zipped_sequence<S> > : flat_store<S> {
+    flat_store(const zipped_sequence<S>& s) : flat_store<S>(s.m_seqs) {}
+};
+
+template<typename Tag, typename S, typename Result>
+struct simd_map_ok {
+#ifdef COPPERHEAD_NO_SIMD
+    static const bool value = false;
+#else
+    static const bool value =
+        simd_loop<Tag>::value &&
+        flat_arithmetic<S>::value &&
+        flat_arithmetic<Result>::value;
+#endif
+};
+
+template<typename F, typename S, typename Result>
+struct simd_map_body {
+    typedef typename interior<zipped_sequence<S> >::type interior_type;
+    map_adapter<F> m_fn;
+    zipped_sequence<S> m_in;
+    interior_type m_interior;
+    flat_store<Result> m_out;
+    size_t m_lo;
+    size_t m_hi;
+    simd_map_body(const map_adapter<F>& fn,
+                  const zipped_sequence<S>& in,
+                  const Result& out)
+        : m_fn(fn), m_in(in),
+          m_interior(interior<zipped_sequence<S> >::view(in)),
+          m_out(out), m_lo(0), m_hi(in.size()) {
+        interior<zipped_sequence<S> >::bound(in, m_lo, m_hi);
+        if (m_hi < m_lo) {
+            m_hi = m_lo;
+        }
+    }
+    void operator()(size_t b, size_t e) const {
+        map_adapter<F> fn = m_fn;
+        zipped_sequence<S> in = m_in;
+        interior_type inner = m_interior;
+        flat_store<Result> out = m_out;
+        size_t lo = (m_lo > b) ? m_lo : b;
+        size_t hi = (m_hi < e) ? m_hi : e;
+        for(size_t i = b; i < lo && i < e; i++) {
+            out(i, fn(in[i]));
+        }
+        COPPERHEAD_SIMD
+        for(size_t i = lo; i < hi; i++) {
+            out(i, fn(inner[i]));
+        }
+        for(size_t i = (hi > lo) ? hi : lo; i < e; i++) {
+            out(i, fn(in[i]));
+        }
+    }
+};
+
+//Stores the elements of in into result
+template<typename Seq, typename Result>
+void materialize(const Seq& in, Result& result) {
+    thrust::copy(in.begin(),
+                 in.end(),
+                 result.begin());
+}
+
+template<typename F, typename S, typename Result>
+typename thrust::detail::enable_if<
+    simd_map_ok<typename zipped_sequence<S>::tag, S, Result>::value>::type
+materialize(const transformed_sequence<F, S>& in, Result& result) {
+    typedef typename zipped_sequence<S>::tag Tag;
+    simd_map_body<F, S, Result> body(in.m_fn, in.m_seq, result);
+    simd_loop<Tag>::run(in.size(), body);
+}
+
+}
+}
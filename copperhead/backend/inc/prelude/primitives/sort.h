@@ -17,76 +17,208 @@
 #pragma once
 
 #include <thrust/sort.h>
+#include <thrust/sequence.h>
+#include <thrust/copy.h>
+#include <thrust/functional.h>
+#include <thrust/iterator/permutation_iterator.h>
 
 #include <prelude/basic/functors.h>
 #include <prelude/runtime/make_cuarray.hpp>
 #include <prelude/runtime/make_sequence.hpp>
 #include <prelude/runtime/tags.h>
+#include <prelude/primitives/stored_sequence.h>
+#include <prelude/primitives/radix_sort.h>
 
 
 namespace copperhead {
 
+namespace detail {
+
+//Comparisons Thrust recognizes, and whether they radix sort
+//descending.  Other comparisons are passed to Thrust as they are.
+template<typename F>
+struct sort_order {
+    static const bool radix = false;
+    static const bool descending = false;
+    typedef F comparison_type;
+    static comparison_type comparison(const F& fn) {
+        return fn;
+    }
+};
+
+template<typename T>
+struct sort_order<fn_cmp_lt<T> > {
+    static const bool radix = true;
+    static const bool descending = false;
+    typedef thrust::less<T> comparison_type;
+    static comparison_type comparison(const fn_cmp_lt<T>&) {
+        return comparison_type();
+    }
+};
+
+template<typename T>
+struct sort_order<fn_cmp_gt<T> > {
+    static const bool radix = true;
+    static const bool descending = true;
+    typedef thrust::greater<T> comparison_type;
+    static comparison_type comparison(const fn_cmp_gt<T>&) {
+        return comparison_type();
+    }
+};
+
+template<typename F, typename Tag, typename T>
+struct use_radix_sort {
+    static const bool value =
+        sort_order<F>::radix && radix_sortable<Tag, T>::value;
+};
+
+//Sorts keys in place
+template<typename F, typename Tag, typename T>
+typename thrust::detail::enable_if<use_radix_sort<F, Tag, T>::value>::type
+sort_keys(const F& fn, sequence<Tag, T>& keys) {
+    radix_sort<Tag>(keys.m_d, keys.size(),
+                    sort_order<F>::descending, (long*)NULL);
+}
+
+template<typename F, typename Tag, typename T>
+typename thrust::detail::enable_if<!use_radix_sort<F, Tag, T>::value>::type
+sort_keys(const F& fn, sequence<Tag, T>& keys) {
+    thrust::sort(keys.begin(),
+                 keys.end(),
+                 sort_order<F>::comparison(fn));
+}
+
+//Sorts keys in place, and sets idx to the original positions of the
+//sorted keys.  Equal keys keep their order.
+template<typename F, typename Tag, typename T>
+typename thrust::detail::enable_if<use_radix_sort<F, Tag, T>::value>::type
+sort_indices(const F& fn, sequence<Tag, T>& keys, sequence<Tag, long>& idx) {
+    radix_sort<Tag>(keys.m_d, keys.size(),
+                    sort_order<F>::descending, idx.m_d);
+}
+
+template<typename F, typename Tag, typename T>
+typename thrust::detail::enable_if<!use_radix_sort<F, Tag, T>::value>::type
+sort_indices(const F& fn, sequence<Tag, T>& keys, sequence<Tag, long>& idx) {
+    thrust::sequence(idx.begin(), idx.end());
+    thrust::stable_sort_by_key(keys.begin(),
+                               keys.end(),
+                               idx.begin(),
+                               sort_order<F>::comparison(fn));
+}
+
+//Copies keys, for value semantics, then sorts them and returns the
+//original positions of the sorted keys
 template<typename F, typename Seq>
 sp_cuarray
-sort(const F& fn, Seq& x) {
+argsort_keys(const F& fn, Seq& x) {
     typedef typename Seq::value_type T;
     typedef typename Seq::tag Tag;
-    
-    //Copy for value semantics (since thrust sort is "in-place")
-    sp_cuarray result_ary = make_cuarray<T>(x.size());
-    sequence<Tag, T> result = make_sequence<sequence<Tag, T> >(result_ary,
-                                                               Tag(),
-                                                               true);
+
+    sp_cuarray keys_ary = make_cuarray<T>(x.size());
+    sequence<Tag, T> keys = make_sequence<sequence<Tag, T> >(keys_ary,
+                                                             Tag(),
+                                                             true);
     thrust::copy(x.begin(),
                  x.end(),
-                 result.begin());
+                 keys.begin());
+    sp_cuarray idx_ary = make_cuarray<long>(x.size());
+    sequence<Tag, long> idx = make_sequence<sequence<Tag, long> >(idx_ary,
+                                                                  Tag(),
+                                                                  true);
+    sort_indices(fn, keys, idx);
+    return idx_ary;
+}
 
-    thrust::sort(result.begin(),
-                 result.end(),
-                 fn);
-    return result_ary;
 }
 
+namespace detail {
+
+//Is x stored in the same place as result?  Only stored sequences may be.
+template<typename Tag, typename T, typename Seq>
+bool same_storage(const sequence<Tag, T>& result, const Seq& x) {
+    return false;
+}
+
+template<typename Tag, typename T>
+bool same_storage(const sequence<Tag, T>& result, const sequence<Tag, T>& x) {
+    return (result.m_d == x.m_d) && (result.size() == x.size());
+}
 
-template<typename Seq>
+template<typename F, typename Seq>
 sp_cuarray
-sort(const fn_cmp_lt<typename Seq::value_type>& fn, Seq& x) {
+sort_into(const F& fn, Seq& x, const sp_cuarray& result_ary) {
     typedef typename Seq::value_type T;
     typedef typename Seq::tag Tag;
     
-    //Copy for value semantics (since thrust sort is "in-place")
-    sp_cuarray result_ary = make_cuarray<T>(x.size());
+    //Copy for value semantics (since thrust sort is "in-place"),
+    //unless the result is stored over x
     sequence<Tag, T> result = make_sequence<sequence<Tag, T> >(result_ary,
                                                                Tag(),
                                                                true);
-    thrust::copy(x.begin(),
-                 x.end(),
-                 result.begin());
+    if (!same_storage(result, x)) {
+        thrust::copy(x.begin(),
+                     x.end(),
+                     result.begin());
+    }
 
-    thrust::sort(result.begin(),
-                 result.end(),
-                 thrust::less<T>());
+    sort_keys(fn, result);
     return result_ary;
 }
 
-template<typename Seq>
+}
+
+template<typename F, typename Seq>
 sp_cuarray
-sort(const fn_cmp_gt<typename Seq::value_type>& fn, Seq& x) {
+sort(const F& fn, Seq& x) {
     typedef typename Seq::value_type T;
-    typedef typename Seq::tag Tag;
-    
-    //Copy for value semantics (since thrust sort is "in-place")
-    sp_cuarray result_ary = make_cuarray<T>(x.size());
-    sequence<Tag, T> result = make_sequence<sequence<Tag, T> >(result_ary,
-                                                               Tag(),
-                                                               true);
-    thrust::copy(x.begin(),
-                 x.end(),
-                 result.begin());
+    return detail::sort_into(fn, x, make_cuarray<T>(x.size()));
+}
+
+//Sorts into donor, a container which is no longer needed, when it has
+//the right shape.  When donor is the storage of x, x is sorted where
+//it is, without a copy.
+template<typename F, typename Seq>
+sp_cuarray
+sort(const F& fn, Seq& x, const sp_cuarray& donor) {
+    typedef typename Seq::value_type T;
+    return detail::sort_into(fn, x,
+                             detail::donate_cuarray<T>(donor, x.size()));
+}
+
+//The positions which would sort x: x[argsort(fn, x)[i]] is the i-th
+//smallest element of x.  The sort is stable.
+template<typename F, typename Seq>
+sp_cuarray
+argsort(const F& fn, Seq& x) {
+    return detail::argsort_keys(fn, x);
+}
+
+//Permutes values into the order which sorts keys.  The sort is
+//stable, and values may be a zipped sequence.
+template<typename F, typename SeqK, typename SeqV>
+sp_cuarray
+sort_by_key(const F& fn, SeqK& keys, SeqV& values) {
+    typedef typename SeqV::tag Tag;
+    typedef typename SeqV::value_type T;
+    typedef typename detail::stored_sequence<Tag, T>::type sequence_type;
 
-    thrust::sort(result.begin(),
-                 result.end(),
-                 thrust::greater<T>());
+    sp_cuarray idx_ary = detail::argsort_keys(fn, keys);
+    sequence<Tag, long> idx = make_sequence<sequence<Tag, long> >(idx_ary,
+                                                                  Tag(),
+                                                                  false);
+    sp_cuarray result_ary = make_cuarray<T>(values.size());
+    sequence_type result =
+        make_sequence<sequence_type>(result_ary,
+                                     Tag(),
+                                     true);
+    typedef typename SeqV::iterator_type ElementIterator;
+    typedef typename sequence<Tag, long>::iterator_type IndexIterator;
+    thrust::permutation_iterator<ElementIterator,
+                                 IndexIterator> pi(
+                                     values.begin(),
+                                     idx.begin());
+    thrust::copy(pi, pi + idx.size(), result.begin());
     return result_ary;
 }
 
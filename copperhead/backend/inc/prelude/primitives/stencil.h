@@ -0,0 +1,348 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Cache blocked stencils.
+//A stencil computes each element of its result from a fixed
+//neighborhood of its input, given as offsets.  Evaluating a stencil
+//as a map over shifted sequences reads the input once per neighbor.
+//On host systems we instead process the result in tiles: each tile's
+//input, with a halo as wide as the neighborhood, is gathered into a
+//buffer which stays in cache, and the tiles run in parallel.
+//Neighbors which fall outside the input read the boundary value.
+
+#include <vector>
+#include <thrust/copy.h>
+#include <thrust/detail/type_traits.h>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/tile_loop.h>
+#include <prelude/sequences/sequence.h>
+#include <prelude/sequences/sequence_iterator.h>
+#include <prelude/primitives/simd_map.h>
+
+namespace copperhead {
+
+//Offsets of the neighbors of a stencil
+template<int N>
+struct stencil_offsets {
+    long m_o[N];
+};
+
+//Offsets of a one dimensional stencil
+inline stencil_offsets<1> make_stencil_offsets(long o0) {
+    stencil_offsets<1> result = {{o0}};
+    return result;
+}
+
+inline stencil_offsets<2> make_stencil_offsets(long o0, long o1) {
+    stencil_offsets<2> result = {{o0, o1}};
+    return result;
+}
+
+inline stencil_offsets<3> make_stencil_offsets(long o0, long o1, long o2) {
+    stencil_offsets<3> result = {{o0, o1, o2}};
+    return result;
+}
+
+inline stencil_offsets<4> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3) {
+    stencil_offsets<4> result = {{o0, o1, o2, o3}};
+    return result;
+}
+
+inline stencil_offsets<5> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3, long o4) {
+    stencil_offsets<5> result = {{o0, o1, o2, o3, o4}};
+    return result;
+}
+
+inline stencil_offsets<6> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3, long o4, long o5) {
+    stencil_offsets<6> result = {{o0, o1, o2, o3, o4, o5}};
+    return result;
+}
+
+inline stencil_offsets<7> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3, long o4, long o5,
+                                               long o6) {
+    stencil_offsets<7> result = {{o0, o1, o2, o3, o4, o5, o6}};
+    return result;
+}
+
+inline stencil_offsets<8> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3, long o4, long o5,
+                                               long o6, long o7) {
+    stencil_offsets<8> result = {{o0, o1, o2, o3, o4, o5, o6, o7}};
+    return result;
+}
+
+inline stencil_offsets<9> make_stencil_offsets(long o0, long o1, long o2,
+                                               long o3, long o4, long o5,
+                                               long o6, long o7, long o8) {
+    stencil_offsets<9> result = {{o0, o1, o2, o3, o4, o5, o6, o7, o8}};
+    return result;
+}
+
+inline stencil_offsets<10> make_stencil_offsets(long o0, long o1, long o2,
+                                                long o3, long o4, long o5,
+                                                long o6, long o7, long o8,
+                                                long o9) {
+    stencil_offsets<10> result = {{o0, o1, o2, o3, o4, o5, o6, o7, o8, o9}};
+    return result;
+}
+
+namespace detail {
+
+template<int N>
+struct stencil_arity {};
+
+//Calls f with the N neighbors in v
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<1>) {
+    return f(v[0]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<2>) {
+    return f(v[0], v[1]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<3>) {
+    return f(v[0], v[1], v[2]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<4>) {
+    return f(v[0], v[1], v[2], v[3]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<5>) {
+    return f(v[0], v[1], v[2], v[3], v[4]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<6>) {
+    return f(v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<7>) {
+    return f(v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<8>) {
+    return f(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<9>) {
+    return f(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+}
+
+template<typename F, typename T>
+__host__ __device__
+typename F::result_type stencil_apply(F& f, const T* v, stencil_arity<10>) {
+    return f(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9]);
+}
+
+//Tiles hold about this many input elements, halos included, so that
+//a tile's input and output stay in the L2 cache
+static const size_t stencil_tile_elements = 16384;
+
+template<typename F, typename T, typename Store, int N>
+struct stencil_tiles {
+    F m_fn;
+    const T* m_in;
+    size_t m_n;
+    Store m_out;
+    T m_boundary;
+    stencil_offsets<N> m_offsets;
+    long m_r;
+    size_t m_tile;
+
+    stencil_tiles(const F& fn,
+                  const T* in,
+                  size_t n,
+                  const Store& out,
+                  const T& boundary,
+                  const stencil_offsets<N>& offsets)
+        : m_fn(fn), m_in(in), m_n(n), m_out(out), m_boundary(boundary),
+          m_offsets(offsets), m_r(0) {
+        for(int k = 0; k < N; k++) {
+            long d = (offsets.m_o[k] < 0) ? -offsets.m_o[k] : offsets.m_o[k];
+            m_r = (d > m_r) ? d : m_r;
+        }
+        //A neighbor further away than the length of the input is
+        //always outside it, so the halo never needs to be wider
+        m_r = (m_r < (long)m_n) ? m_r : m_n;
+        m_tile = (stencil_tile_elements > (size_t)(2 * m_r + 1)) ?
+            stencil_tile_elements - 2 * m_r : 1;
+    }
+
+    size_t tiles() const {
+        return (m_n + m_tile - 1) / m_tile;
+    }
+
+    void operator()(size_t b, size_t e) const {
+        std::vector<T> buf(m_tile + 2 * m_r);
+        for(size_t t = b; t < e; t++) {
+            tile(t, &buf[0]);
+        }
+    }
+
+    void tile(size_t t, T* buf) const {
+        long i0 = t * m_tile;
+        long i1 = i0 + m_tile;
+        i1 = (i1 < (long)m_n) ? i1 : m_n;
+        long w = i1 - i0;
+
+        //Gather the tile and its halo
+        for(long j = 0; j < w + 2 * m_r; j++) {
+            long i = i0 + j - m_r;
+            buf[j] = ((i < 0) || (i >= (long)m_n)) ? m_boundary : m_in[i];
+        }
+
+        //Neighbors beyond the halo always read the boundary
+        long off[N];
+        bool outside[N];
+        for(int k = 0; k < N; k++) {
+            long d = m_offsets.m_o[k];
+            outside[k] = (d < -m_r) || (d > m_r);
+            off[k] = outside[k] ? 0 : d;
+        }
+        F fn = m_fn;
+        Store out = m_out;
+        const T* row = buf + m_r;
+        COPPERHEAD_SIMD
+        for(long c = 0; c < w; c++) {
+            T v[N];
+            for(int k = 0; k < N; k++) {
+                v[k] = outside[k] ? m_boundary : row[c + off[k]];
+            }
+            out(i0 + c, stencil_apply(fn, v, stencil_arity<N>()));
+        }
+    }
+};
+
+template<typename Tag, typename F, typename T, typename Store, int N>
+void run_stencil(const F& fn,
+                 const T* in,
+                 size_t n,
+                 const Store& out,
+                 const T& boundary,
+                 const stencil_offsets<N>& offsets) {
+    stencil_tiles<F, T, Store, N> body(fn, in, n, out, boundary, offsets);
+    tile_loop<Tag>::run(body.tiles(), body);
+}
+
+}
+
+//A one dimensional stencil over a flat sequence, as a lazy sequence.
+//Elements can be computed individually, as when the stencil feeds a
+//map, but completing the sequence on a host system runs the tiles.
+template<typename F, typename Seq, int N>
+struct stencil_sequence {
+    typedef typename Seq::tag tag;
+    typedef typename F::result_type value_type;
+    typedef value_type el_type;
+    typedef value_type T;
+    typedef value_type ref_type;
+    typedef typename Seq::value_type source_type;
+    typedef typename Seq::index_type index_type;
+    typedef typename sequence_iterator<stencil_sequence<F, Seq, N> >::type iterator_type;
+
+    F m_fn;
+    Seq m_s;
+    source_type m_boundary;
+    stencil_offsets<N> m_offsets;
+
+    __host__ __device__
+    stencil_sequence(const F& fn,
+                     const Seq& s,
+                     const source_type& boundary,
+                     const stencil_offsets<N>& offsets)
+        : m_fn(fn), m_s(s), m_boundary(boundary), m_offsets(offsets) {}
+
+    __host__ __device__
+    index_type size() const {
+        return m_s.size();
+    }
+
+    __host__ __device__
+    bool empty() const {
+        return size() <= 0;
+    }
+
+    __host__ __device__
+    value_type operator[](const index_type& i) const {
+        source_type v[N];
+        for(int k = 0; k < N; k++) {
+            long j = (long)i + m_offsets.m_o[k];
+            v[k] = ((j < 0) || (j >= (long)size())) ? m_boundary : m_s[j];
+        }
+        F fn = m_fn;
+        return detail::stencil_apply(fn, v, detail::stencil_arity<N>());
+    }
+
+    __host__
+    iterator_type begin() const {
+        return make_sequence_iterator(*this);
+    }
+
+    __host__
+    iterator_type end() const {
+        return make_sequence_iterator(*this) + size();
+    }
+};
+
+template<typename F, typename Seq, int N>
+stencil_sequence<F, Seq, N> stencil(const F& fn,
+                                    const Seq& in,
+                                    const typename Seq::value_type& boundary,
+                                    const stencil_offsets<N>& offsets) {
+    return stencil_sequence<F, Seq, N>(fn, in, boundary, offsets);
+}
+
+namespace detail {
+
+template<typename F, typename Tag, typename T, int N, typename Result>
+typename thrust::detail::enable_if<
+    tile_loop<Tag>::value &&
+    thrust::detail::is_arithmetic<T>::value &&
+    flat_arithmetic<Result>::value>::type
+materialize(const stencil_sequence<F, sequence<Tag, T, 0>, N>& in,
+            Result& result) {
+    run_stencil<Tag>(in.m_fn, (const T*)in.m_s.m_d, in.size(),
+                     flat_store<Result>(result),
+                     in.m_boundary, in.m_offsets);
+}
+
+}
+
+}
@@ -19,17 +19,40 @@
 
 #include <cstddef>
 #include <prelude/runtime/mempool.hpp>
+#include <prelude/runtime/event.hpp>
+
+#ifndef BOOST_SP_USE_SPINLOCK
+#define BOOST_SP_USE_SPINLOCK
+#endif
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace copperhead {
 
+//Forward declaration of PIMPL for hiding std::mutex from NVCC
+class chunk_lock;
+
 class chunk {
 private:
     system_variant m_s;
     void* m_d;
     size_t m_r;
+    boost::shared_ptr<void> m_owner;
+    //Completes when pending work using this chunk is done
+    sp_event m_e;
+    //Serializes lazy allocation and unsharing
+    boost::scoped_ptr<chunk_lock> m_lock;
 public:
     chunk(const system_variant &s,
           size_t r);
+    //Borrows existing host storage d, which is kept alive by owner.
+    //Borrowed storage is never written: the chunk makes a private
+    //copy before the first write access.  owner may be released on
+    //any thread, so its deleter must be safe to run there.
+    chunk(const system_variant &s,
+          size_t r,
+          void* d,
+          const boost::shared_ptr<void>& owner);
     ~chunk();
 private:
     //Not copyable
@@ -38,9 +61,17 @@ private:
     chunk& operator=(const chunk&);
 public:
     void copy_from(chunk& o);
+    bool borrowed() const;
+    //Replaces borrowed storage with private storage,
+    //copying the contents if preserve is true
+    void unshare(bool preserve);
     void* ptr();
     size_t size() const;
     const system_variant& tag() const;
+    //Records that pending work uses this chunk until e completes
+    void set_event(const sp_event& e);
+    //Waits for pending work using this chunk
+    void sync();
 };
 
 }
@@ -29,19 +29,41 @@
 
 namespace copperhead {
 
-typedef std::map<system_variant,
-                 std::pair<std::vector<boost::shared_ptr<chunk> >,
-                           bool> ,
-                 system_variant_less> data_map;
+//Holds the chunks of a cuarray in each memory space, and whether
+//they are valid.  Memory spaces are found by indexing with
+//memory_index(), rather than by searching.
+class data_map {
+public:
+    typedef std::pair<std::vector<boost::shared_ptr<chunk> >,
+                      bool> value_type;
+private:
+    value_type m_r[n_systems];
+    bool m_present[n_systems];
+public:
+    data_map();
+    //Gets the representation for a memory space, creating it if needed
+    value_type& operator[](const system_variant& t);
+    bool contains(const system_variant& t) const;
+    bool empty() const;
+    //Representations by index, for iterating over memory spaces
+    bool present(int i) const;
+    value_type& at(int i);
+    const value_type& at(int i) const;
+};
 
 //Forward declaration of PIMPL for hiding std::shared_ptr from NVCC
 class type_holder;
 
+//Forward declaration of PIMPL for hiding std::mutex from NVCC
+class coherence_lock;
+
 struct cuarray {
     data_map m_d;
     std::vector<size_t> m_l;
     boost::scoped_ptr<type_holder> m_t;
     size_t m_o;
+    //Serializes coherence updates from concurrent entry points
+    boost::scoped_ptr<coherence_lock> m_lock;
 
     //Assumes ownership of type_holder* t
     cuarray(type_holder* t,
@@ -55,9 +77,27 @@ struct cuarray {
                       const bool& v);
     std::vector<boost::shared_ptr<chunk> >& get_chunks(const system_variant& t, bool write);
     bool clean(const system_variant& t);
+    //Records that pending work uses every chunk until e completes
+    void set_event(const sp_event& e);
+    //Waits for pending work using any chunk
+    void sync();
     
 };
 
 typedef boost::shared_ptr<cuarray> sp_cuarray;
 
+//Places the result r of an entry point in the caller provided
+//container out, if there is one, and returns the container which
+//holds the result.  Throws std::invalid_argument if out has a
+//different shape than r.
+sp_cuarray deliver(const sp_cuarray& r,
+                   const sp_cuarray& out,
+                   const system_variant& t);
+
+//Drops a reference to a temporary once it is dead, so that its
+//storage returns to the memory pool for later allocations
+inline void release(sp_cuarray& x) {
+    x.reset();
+}
+
 }
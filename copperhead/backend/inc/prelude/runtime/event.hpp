@@ -0,0 +1,52 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+#ifndef BOOST_SP_USE_SPINLOCK
+#define BOOST_SP_USE_SPINLOCK
+#endif
+#include <boost/shared_ptr.hpp>
+
+namespace copperhead {
+
+//Forward declaration of PIMPL for hiding the threading library from NVCC
+class event;
+
+typedef boost::shared_ptr<event> sp_event;
+
+//Makes an event which has not completed
+sp_event make_event();
+
+//Marks e complete, and wakes every thread waiting on it
+void complete(event& e);
+
+bool ready(event& e);
+
+//Waits until e completes, using the installed wait hook
+void wait(event& e);
+
+//Blocks the calling thread until e completes
+void block(event& e);
+
+//A wait hook decides how to wait for an event.  Runtimes which are
+//embedded in an interpreter use it to release the interpreter's
+//lock while blocked, or to avoid waiting on their own work.
+typedef void (*wait_hook)(event&);
+
+void set_wait_hook(wait_hook h);
+
+}
@@ -89,5 +89,153 @@ sp_cuarray make_cuarray(size_t s) {
     return r;
 }
 
+//Makes a sequence of n sequences of T, holding e elements in total.
+//The caller fills in the n+1 entry descriptor.
+template<typename T>
+sp_cuarray make_cuarray(size_t n, size_t e) {
+    type_holder* th = detail::make_type_holder();
+    detail::begin(th);
+    detail::begin(th);
+    sp_cuarray r(new cuarray(th));
+    r->push_back_length(n + 1);
+    r->push_back_length(e);
+    r->add_chunk(boost::shared_ptr<chunk>(new chunk(cpp_tag(), (n + 1) * sizeof(size_t))), true);
+#ifdef CUDA_SUPPORT
+    r->add_chunk(boost::shared_ptr<chunk>(new chunk(cuda_tag(), (n + 1) * sizeof(size_t))), true);
+#endif
+    detail::make_cuarray_impl<T>::fun(r, e);
+    detail::end_sequence(th);
+    detail::end_sequence(th);
+    detail::finalize_type(th);
+    return r;
+}
+
+
+namespace detail {
+
+//Computes the size in bytes of each chunk in a flat container of s Ts
+template<typename T>
+struct chunk_sizes {
+    static void fun(std::vector<size_t>& r, size_t s) {
+        r.push_back(s * sizeof(T));
+    }
+};
+
+template<typename HT, typename TT>
+struct chunk_sizes<thrust::detail::cons<HT, TT> > {
+    static void fun(std::vector<size_t>& r, size_t s) {
+        chunk_sizes<HT>::fun(r, s);
+        chunk_sizes<TT>::fun(r, s);
+    }
+};
+
+template<typename T0, typename T1, typename T2, typename T3, typename T4,
+         typename T5, typename T6, typename T7, typename T8, typename T9>
+struct chunk_sizes<
+    thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> > {
+    typedef thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> T;
+    static void fun(std::vector<size_t>& r, size_t s) {
+        chunk_sizes<
+            thrust::detail::cons<
+                typename T::head_type,
+                typename T::tail_type> >::fun(r, s);
+    }
+};
+
+template<>
+struct chunk_sizes<thrust::null_type> {
+    static void fun(std::vector<size_t>&, size_t) {}
+};
+
+//Adds the type T to a type holder
+template<typename T>
+struct make_type_impl {
+    static void fun(type_holder* t) {
+        add_type(t, T());
+    }
+};
+
+template<typename HT, typename TT>
+struct make_type_impl<thrust::detail::cons<HT, TT> > {
+    static void fun(type_holder* t) {
+        make_type_impl<HT>::fun(t);
+        make_type_impl<TT>::fun(t);
+    }
+};
+
+template<typename T0, typename T1, typename T2, typename T3, typename T4,
+         typename T5, typename T6, typename T7, typename T8, typename T9>
+struct make_type_impl<
+    thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> > {
+    typedef thrust::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> T;
+    static void fun(type_holder* t) {
+        begin(t);
+        make_type_impl<
+            thrust::detail::cons<
+                typename T::head_type,
+                typename T::tail_type> >::fun(t);
+        end_tuple(t);
+    }
+};
+
+template<>
+struct make_type_impl<thrust::null_type> {
+    static void fun(type_holder*) {}
+};
+
+//The type of a flat sequence of Ts
+template<typename T>
+type_holder* make_sequence_type() {
+    type_holder* th = make_type_holder();
+    begin(th);
+    make_type_impl<T>::fun(th);
+    end_sequence(th);
+    finalize_type(th);
+    return th;
+}
+
+//Can a flat sequence of s Ts be stored directly in out?
+template<typename T>
+bool fits(const sp_cuarray& out, size_t s) {
+    if (!out || (out->m_l.size() != 1) || (out->m_l[0] != s) ||
+        (out->m_o != 0) || out->m_d.empty()) {
+        return false;
+    }
+    //Built once for each T, and kept for the life of the program
+    static const type_holder* t = make_sequence_type<T>();
+    if (!same_type(out->m_t.get(), t)) {
+        return false;
+    }
+    std::vector<size_t> sizes;
+    chunk_sizes<T>::fun(sizes, s);
+    int space = 0;
+    while(!out->m_d.present(space)) {
+        space++;
+    }
+    const std::vector<boost::shared_ptr<chunk> >& chunks =
+        out->m_d.at(space).first;
+    if (chunks.size() != sizes.size()) {
+        return false;
+    }
+    for(size_t i = 0; i < sizes.size(); i++) {
+        if (chunks[i]->size() != sizes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Reuses donor, a container which is no longer needed, to hold a flat
+//sequence of s Ts when it has the right shape.  Otherwise makes a new
+//container.
+template<typename T>
+sp_cuarray donate_cuarray(const sp_cuarray& donor, size_t s) {
+    if (fits<T>(donor, s)) {
+        return donor;
+    }
+    return make_cuarray<T>(s);
+}
+
+}
 
 }
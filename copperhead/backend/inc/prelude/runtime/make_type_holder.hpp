@@ -21,6 +21,9 @@ void end_sequence(type_holder*);
 void end_tuple(type_holder*);
 void finalize_type(type_holder*);
 
+//Do a and b hold the same type?
+bool same_type(const type_holder* a, const type_holder* b);
+
 }
 
 }
@@ -1,9 +1,35 @@
 #pragma once
+#include <cstddef>
 #include <prelude/runtime/tags.h>
 #include <prelude/runtime/tag_malloc_and_free.h>
 
 namespace copperhead {
 
+//Counters kept by the memory pool for each memory space.
+//Byte counts are in terms of size class bytes, not requested bytes.
+struct pool_stats {
+    size_t bytes_live;
+    size_t bytes_cached;
+    size_t high_water;
+    size_t hits;
+    size_t misses;
+    size_t mallocs;
+};
+
+pool_stats get_pool_stats(cpp_tag);
+
+#ifdef CUDA_SUPPORT
+pool_stats get_pool_stats(cuda_tag);
+#endif
+
+//Bound the bytes cached by each memory pool, releasing least recently
+//freed blocks until the pools satisfy the bound.  Blocks cached by
+//every thread are returned to the pools first, so bytes_cached
+//reflects the bound once this returns.  The bound persists for
+//subsequent deallocations, which may each leave a few blocks cached
+//by the freeing thread beyond it.
+void pool_trim(size_t max_cached_bytes);
+
 void take_down();
 
 }
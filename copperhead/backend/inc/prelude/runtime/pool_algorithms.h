@@ -0,0 +1,297 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//Parallel implementations of Thrust primitives for the pool_tag
+//system.  pool_tag derives from the sequential cpp system, so Thrust
+//finds these overloads by argument dependent lookup, and prefers them
+//since they match pool_tag exactly.  Primitives without an overload
+//here, and iterators without random access, run sequentially.
+
+#include <vector>
+#include <thrust/iterator/iterator_traits.h>
+#include <thrust/detail/type_traits.h>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/thread_pool.hpp>
+
+namespace copperhead {
+namespace detail {
+
+//Iterations per piece of an elementwise loop
+const size_t pool_grain = 1024;
+
+template<typename I>
+struct is_random_access
+    : thrust::detail::is_convertible<
+    typename thrust::iterator_traversal<I>::type,
+    thrust::random_access_traversal_tag> {};
+
+template<typename I0, typename I1, typename R>
+struct enable_if_random_access
+    : thrust::detail::enable_if<
+    is_random_access<I0>::value && is_random_access<I1>::value, R> {};
+
+template<typename I, typename F>
+struct for_each_range {
+    I m_first;
+    F m_f;
+    for_each_range(I first, F f) : m_first(first), m_f(f) {}
+    void operator()(size_t b, size_t e) {
+        I i = m_first + b;
+        for(size_t k = b; k < e; k++, ++i) {
+            m_f(*i);
+        }
+    }
+};
+
+template<typename I, typename O>
+struct copy_range {
+    I m_in;
+    O m_out;
+    copy_range(I in, O out) : m_in(in), m_out(out) {}
+    void operator()(size_t b, size_t e) {
+        I i = m_in + b;
+        O o = m_out + b;
+        for(size_t k = b; k < e; k++, ++i, ++o) {
+            *o = *i;
+        }
+    }
+};
+
+template<typename I, typename O, typename F>
+struct transform_range {
+    I m_in;
+    O m_out;
+    F m_f;
+    transform_range(I in, O out, F f) : m_in(in), m_out(out), m_f(f) {}
+    void operator()(size_t b, size_t e) {
+        I i = m_in + b;
+        O o = m_out + b;
+        for(size_t k = b; k < e; k++, ++i, ++o) {
+            *o = m_f(*i);
+        }
+    }
+};
+
+template<typename I0, typename I1, typename O, typename F>
+struct transform2_range {
+    I0 m_in0;
+    I1 m_in1;
+    O m_out;
+    F m_f;
+    transform2_range(I0 in0, I1 in1, O out, F f)
+        : m_in0(in0), m_in1(in1), m_out(out), m_f(f) {}
+    void operator()(size_t b, size_t e) {
+        I0 i0 = m_in0 + b;
+        I1 i1 = m_in1 + b;
+        O o = m_out + b;
+        for(size_t k = b; k < e; k++, ++i0, ++i1, ++o) {
+            *o = m_f(*i0, *i1);
+        }
+    }
+};
+
+//Reductions and scans work on a fixed number of blocks, so that
+//partial results combine in order, whichever thread computed them.
+//Short inputs make a single block, which runs on the caller.
+inline size_t pool_blocks(size_t n) {
+    size_t blocks = n / pool_grain;
+    size_t limit = 4 * pool_threads();
+    if (blocks > limit) {
+        return limit;
+    }
+    return (blocks > 0) ? blocks : 1;
+}
+
+inline size_t block_begin(size_t n, size_t blocks, size_t i) {
+    return (n * i) / blocks;
+}
+
+template<typename I, typename T, typename F>
+struct block_reduce {
+    I m_first;
+    size_t m_n;
+    size_t m_blocks;
+    F m_f;
+    T* m_partials;
+    block_reduce(I first, size_t n, size_t blocks, F f, T* partials)
+        : m_first(first), m_n(n), m_blocks(blocks), m_f(f),
+          m_partials(partials) {}
+    void operator()(size_t b, size_t e) {
+        for(size_t j = b; j < e; j++) {
+            size_t lo = block_begin(m_n, m_blocks, j);
+            size_t hi = block_begin(m_n, m_blocks, j + 1);
+            I i = m_first + lo;
+            T acc = *i;
+            ++i;
+            for(size_t k = lo + 1; k < hi; k++, ++i) {
+                acc = m_f(acc, *i);
+            }
+            m_partials[j] = acc;
+        }
+    }
+};
+
+//Scans each block, starting from the combined totals of the blocks
+//before it.  Block 0 of an inclusive scan has no carry.
+template<typename I, typename O, typename T, typename F>
+struct block_scan {
+    I m_first;
+    O m_result;
+    size_t m_n;
+    size_t m_blocks;
+    F m_f;
+    const T* m_carries;
+    bool m_inclusive;
+    block_scan(I first, O result, size_t n, size_t blocks, F f,
+               const T* carries, bool inclusive)
+        : m_first(first), m_result(result), m_n(n), m_blocks(blocks),
+          m_f(f), m_carries(carries), m_inclusive(inclusive) {}
+    void operator()(size_t b, size_t e) {
+        for(size_t j = b; j < e; j++) {
+            size_t lo = block_begin(m_n, m_blocks, j);
+            size_t hi = block_begin(m_n, m_blocks, j + 1);
+            I i = m_first + lo;
+            O o = m_result + lo;
+            if (m_inclusive) {
+                T acc = (j == 0) ? T(*i) : m_f(m_carries[j], *i);
+                *o = acc;
+                ++i;
+                ++o;
+                for(size_t k = lo + 1; k < hi; k++, ++i, ++o) {
+                    acc = m_f(acc, *i);
+                    *o = acc;
+                }
+            } else {
+                T acc = m_carries[j];
+                for(size_t k = lo; k < hi; k++, ++i, ++o) {
+                    T x = *i;
+                    *o = acc;
+                    acc = m_f(acc, x);
+                }
+            }
+        }
+    }
+};
+
+//Scans [first, last) into result.  The scan is exclusive, starting
+//from *init, if init is given, and inclusive otherwise.
+template<typename I, typename O, typename T, typename F>
+O pool_scan(I first, I last, O result, const T* init, F f) {
+    size_t n = last - first;
+    if (n == 0) {
+        return result;
+    }
+    size_t blocks = pool_blocks(n);
+    std::vector<T> partials(blocks);
+    if (blocks > 1) {
+        block_reduce<I, T, F> reducer(first, n, blocks, f, &partials[0]);
+        parallel_for(blocks, 1, reducer);
+    }
+    //carries[j] combines init, if any, and the totals of blocks
+    //[0, j).  An inclusive scan never uses carries[0].
+    std::vector<T> carries(blocks);
+    if (init != NULL) {
+        carries[0] = *init;
+    }
+    for(size_t j = 1; j < blocks; j++) {
+        carries[j] = ((j == 1) && (init == NULL)) ?
+            partials[0] : f(carries[j - 1], partials[j - 1]);
+    }
+    block_scan<I, O, T, F> scanner(first, result, n, blocks, f,
+                                   &carries[0], init == NULL);
+    parallel_for(blocks, 1, scanner);
+    return result + n;
+}
+
+}
+
+template<typename I, typename F>
+typename detail::enable_if_random_access<I, I, I>::type
+for_each(const pool_tag&, I first, I last, F f) {
+    detail::for_each_range<I, F> body(first, f);
+    parallel_for(last - first, detail::pool_grain, body);
+    return last;
+}
+
+template<typename I, typename Size, typename F>
+typename detail::enable_if_random_access<I, I, I>::type
+for_each_n(const pool_tag&, I first, Size n, F f) {
+    detail::for_each_range<I, F> body(first, f);
+    parallel_for(n, detail::pool_grain, body);
+    return first + n;
+}
+
+template<typename I, typename O>
+typename detail::enable_if_random_access<I, O, O>::type
+copy(const pool_tag&, I first, I last, O result) {
+    detail::copy_range<I, O> body(first, result);
+    size_t n = last - first;
+    parallel_for(n, detail::pool_grain, body);
+    return result + n;
+}
+
+template<typename I, typename O, typename F>
+typename detail::enable_if_random_access<I, O, O>::type
+transform(const pool_tag&, I first, I last, O result, F f) {
+    detail::transform_range<I, O, F> body(first, result, f);
+    size_t n = last - first;
+    parallel_for(n, detail::pool_grain, body);
+    return result + n;
+}
+
+template<typename I0, typename I1, typename O, typename F>
+typename detail::enable_if_random_access<I0, I1, O>::type
+transform(const pool_tag&, I0 first0, I0 last0, I1 first1, O result, F f) {
+    detail::transform2_range<I0, I1, O, F> body(first0, first1, result, f);
+    size_t n = last0 - first0;
+    parallel_for(n, detail::pool_grain, body);
+    return result + n;
+}
+
+template<typename I, typename T, typename F>
+typename detail::enable_if_random_access<I, I, T>::type
+reduce(const pool_tag&, I first, I last, T init, F f) {
+    size_t n = last - first;
+    if (n == 0) {
+        return init;
+    }
+    size_t blocks = detail::pool_blocks(n);
+    std::vector<T> partials(blocks);
+    detail::block_reduce<I, T, F> body(first, n, blocks, f, &partials[0]);
+    parallel_for(blocks, 1, body);
+    T result = init;
+    for(size_t j = 0; j < blocks; j++) {
+        result = f(result, partials[j]);
+    }
+    return result;
+}
+
+template<typename I, typename O, typename F>
+typename detail::enable_if_random_access<I, O, O>::type
+inclusive_scan(const pool_tag&, I first, I last, O result, F f) {
+    typedef typename thrust::iterator_value<I>::type T;
+    return detail::pool_scan(first, last, result, static_cast<const T*>(NULL), f);
+}
+
+template<typename I, typename O, typename T, typename F>
+typename detail::enable_if_random_access<I, O, O>::type
+exclusive_scan(const pool_tag&, I first, I last, O result, T init, F f) {
+    return detail::pool_scan(first, last, result, &init, f);
+}
+
+}
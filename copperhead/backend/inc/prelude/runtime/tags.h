@@ -21,6 +21,7 @@
 #pragma once
 
 #include <boost/variant.hpp>
+#include <boost/mpl/size.hpp>
 #include <functional>
 #include <string>
 
@@ -62,6 +63,10 @@ namespace copperhead {
     
 struct cpp_tag : thrust::system::cpp::detail::execution_policy<cpp_tag>{};
 
+//Runs on the runtime's thread pool.  Primitives without a parallel
+//implementation in pool_algorithms.h fall back to the cpp system.
+struct pool_tag : thrust::system::cpp::detail::execution_policy<pool_tag>{};
+
 #ifdef OMP_SUPPORT
 struct omp_tag : thrust::system::omp::detail::execution_policy<omp_tag>{};
 #endif
@@ -78,6 +83,8 @@ struct cuda_tag : thrust::system::cuda::detail::execution_policy<cuda_tag>{};
 
 struct cpp_tag : thrust::system::cpp::detail::tag{};
 
+struct pool_tag : thrust::system::cpp::detail::tag{};
+
 #ifdef OMP_SUPPORT
 struct omp_tag : thrust::system::omp::detail::tag{};
 #endif
@@ -93,6 +100,7 @@ struct cuda_tag : thrust::system::cuda::detail::tag{};
 #endif
 
 typedef boost::variant<cpp_tag
+    ,pool_tag
 #ifdef OMP_SUPPORT
     ,omp_tag
 #endif
@@ -104,6 +112,9 @@ typedef boost::variant<cpp_tag
 #endif
     > system_variant;
 
+//Number of systems a system_variant can hold
+const int n_systems = boost::mpl::size<system_variant::types>::value;
+
 namespace detail {
 //Computes the canonical memory space tag
 //This is normally an identity
@@ -115,6 +126,12 @@ struct canonical_memory_tag {
 //In which case we choose one of the tags
 //As the canonical tag
 
+//The pool tag's canonical memory space is CPP
+template<>
+struct canonical_memory_tag<pool_tag> {
+    typedef cpp_tag tag;
+};
+
 #ifdef OMP_SUPPORT
 //The OMP tag's canonical memory space is CPP
 template<>
@@ -166,6 +183,7 @@ namespace detail {
 struct system_variant_to_string
     : boost::static_visitor<std::string> {
     std::string operator()(const cpp_tag&) const;
+    std::string operator()(const pool_tag&) const;
     #ifdef OMP_SUPPORT
     std::string operator()(const omp_tag&) const;
     #endif
@@ -183,6 +201,9 @@ std::string to_string(const system_variant& x);
 
 system_variant canonical_memory_tag(const system_variant& x);
 
+//Index of the canonical memory space of a system, in [0, n_systems)
+int memory_index(const system_variant& x);
+
 void* malloc(cpp_tag, size_t);
 void free(cpp_tag, void* ptr);
 template<typename T>
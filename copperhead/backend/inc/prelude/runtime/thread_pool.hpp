@@ -0,0 +1,61 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace copperhead {
+
+//The runtime's persistent thread pool, which runs the primitives of
+//the pool_tag system.  Workers are started on first use and then
+//park between calls, so a call costs a wakeup rather than a fork and
+//join of a thread team.
+//The pool is hidden behind this interface, so that NVCC never sees
+//the threading library.
+
+//Body of a parallel loop: runs iterations [begin, end) given the
+//context pointer passed to parallel_for
+typedef void (*range_fn)(void* ctx, size_t begin, size_t end);
+
+//Runs iterations [0, n) of f, split into pieces of at least grain
+//iterations.  Each participant takes pieces from the front of its
+//own share of the range, and steals the back half of another
+//participant's share when its own runs out.
+//Runs sequentially on the calling thread when n fits in one piece,
+//when called from inside a parallel loop, or when another thread is
+//using the pool.  Rethrows the first exception thrown by f.
+void parallel_for(size_t n, size_t grain, range_fn f, void* ctx);
+
+//Number of threads which run parallel loops, including the caller
+size_t pool_threads();
+
+namespace detail {
+
+template<typename F>
+void invoke_range(void* ctx, size_t begin, size_t end) {
+    (*reinterpret_cast<F*>(ctx))(begin, end);
+}
+
+}
+
+//Runs f(begin, end) over pieces of [0, n)
+template<typename F>
+void parallel_for(size_t n, size_t grain, F& f) {
+    parallel_for(n, grain, &detail::invoke_range<F>, &f);
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+
+//How each host system runs a loop over a few coarse pieces of work,
+//such as the tiles of a stencil or the blocks of a radix sort.
+//Pieces are handed out one at a time, and a body is called as
+//body(begin, end) over piece indices.
+
+#include <cstddef>
+#include <thrust/detail/type_traits.h>
+#include <prelude/runtime/tags.h>
+#include <prelude/runtime/thread_pool.hpp>
+
+#if defined(OMP_SUPPORT) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#ifdef TBB_SUPPORT
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_scheduler_init.h>
+#endif
+
+namespace copperhead {
+namespace detail {
+
+template<typename Tag>
+struct tile_loop {
+    static const bool value = false;
+};
+
+template<>
+struct tile_loop<cpp_tag> {
+    static const bool value = true;
+    //Number of threads which run pieces
+    static size_t threads() {
+        return 1;
+    }
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        body(0, n);
+    }
+};
+
+template<>
+struct tile_loop<pool_tag> {
+    static const bool value = true;
+    static size_t threads() {
+        return pool_threads();
+    }
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        parallel_for(n, 1, body);
+    }
+};
+
+#ifdef OMP_SUPPORT
+template<>
+struct tile_loop<omp_tag> {
+    static const bool value = true;
+    static size_t threads() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        long pieces = n;
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(long t = 0; t < pieces; t++) {
+            body(t, t + 1);
+        }
+    }
+};
+#endif
+
+#ifdef TBB_SUPPORT
+template<typename Body>
+struct tbb_tile_body {
+    Body& m_body;
+    tbb_tile_body(Body& body) : m_body(body) {}
+    void operator()(const tbb::blocked_range<size_t>& r) const {
+        m_body(r.begin(), r.end());
+    }
+};
+
+template<>
+struct tile_loop<tbb_tag> {
+    static const bool value = true;
+    static size_t threads() {
+        return tbb::task_scheduler_init::default_num_threads();
+    }
+    template<typename Body>
+    static void run(size_t n, Body& body) {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 1),
+                          tbb_tile_body<Body>(body));
+    }
+};
+#endif
+
+//The host system which works on data of system Tag: Tag itself if it
+//runs tile loops.  Data of other systems is copied to the host, and
+//worked on there.
+template<typename Tag, typename Enable = void>
+struct tile_system {
+    typedef cpp_tag type;
+};
+
+template<typename Tag>
+struct tile_system<Tag,
+                   typename thrust::detail::enable_if<
+                       tile_loop<Tag>::value>::type> {
+    typedef Tag type;
+};
+
+}
+}
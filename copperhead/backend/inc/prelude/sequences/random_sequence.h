@@ -0,0 +1,131 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <prelude/sequences/iterator_sequence.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <cmath>
+
+namespace copperhead {
+
+namespace detail {
+
+//Philox4x32-10 counter based generator (Salmon et al., SC11).
+//Element i of a random sequence is a pure function of (seed, i), so
+//results don't depend on how the sequence is partitioned among
+//threads, and elements can be generated wherever they are consumed.
+struct philox {
+    unsigned int v[4];
+
+    __host__ __device__
+    static void mulhilo(unsigned int a, unsigned int b,
+                        unsigned int& hi, unsigned int& lo) {
+        unsigned long long p = (unsigned long long)a * b;
+        hi = (unsigned int)(p >> 32);
+        lo = (unsigned int)p;
+    }
+
+    __host__ __device__
+    philox(unsigned long long seed, unsigned long long counter) {
+        unsigned int k0 = (unsigned int)seed;
+        unsigned int k1 = (unsigned int)(seed >> 32);
+        v[0] = (unsigned int)counter;
+        v[1] = (unsigned int)(counter >> 32);
+        v[2] = 0;
+        v[3] = 0;
+        for(int r = 0; r < 10; r++) {
+            unsigned int hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, v[0], hi0, lo0);
+            mulhilo(0xCD9E8D57u, v[2], hi1, lo1);
+            v[0] = hi1 ^ v[1] ^ k0;
+            v[1] = lo1;
+            v[2] = hi0 ^ v[3] ^ k1;
+            v[3] = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+    }
+
+    //A double in [0, 1) from 53 bits of words i and i+1
+    __host__ __device__
+    double uniform(int i) const {
+        unsigned long long x =
+            ((unsigned long long)v[i] << 32) | v[i + 1];
+        return (double)(x >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+struct random_uniform_fn {
+    typedef double result_type;
+    unsigned long long m_seed;
+    __host__ __device__
+    random_uniform_fn(long seed) : m_seed(seed) {}
+    __host__ __device__
+    double operator()(long i) const {
+        return philox(m_seed, i).uniform(0);
+    }
+};
+
+//Box-Muller on the two uniforms of one counter.  Only the cosine
+//branch is used, so that each element depends on a single counter.
+struct random_normal_fn {
+    typedef double result_type;
+    unsigned long long m_seed;
+    __host__ __device__
+    random_normal_fn(long seed) : m_seed(seed) {}
+    __host__ __device__
+    double operator()(long i) const {
+        philox p(m_seed, i);
+        //Shift u0 to (0, 1] to keep the log finite
+        double u0 = 1.0 - p.uniform(0);
+        double u1 = p.uniform(2);
+        return sqrt(-2.0 * log(u0)) * cos(6.283185307179586 * u1);
+    }
+};
+
+}
+
+template<typename Tag, typename F>
+struct random_sequence
+    : public iterator_sequence<
+    Tag, thrust::transform_iterator<F, thrust::counting_iterator<long> > >
+{
+    typedef thrust::transform_iterator<F, thrust::counting_iterator<long> >
+    iterator;
+    __host__ __device__ random_sequence(long seed, long length) :
+        iterator_sequence<Tag, iterator>(
+            iterator(thrust::counting_iterator<long>(0), F(seed)),
+            length) {}
+};
+
+template<typename Tag>
+struct random_uniform_sequence
+    : public random_sequence<Tag, detail::random_uniform_fn>
+{
+    __host__ __device__ random_uniform_sequence(long seed, long length) :
+        random_sequence<Tag, detail::random_uniform_fn>(seed, length) {}
+};
+
+template<typename Tag>
+struct random_normal_sequence
+    : public random_sequence<Tag, detail::random_normal_fn>
+{
+    __host__ __device__ random_normal_sequence(long seed, long length) :
+        random_sequence<Tag, detail::random_normal_fn>(seed, length) {}
+};
+
+}
@@ -0,0 +1,92 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <prelude/sequences/sequence_iterator.h>
+#include <prelude/basic/detail/signed_index_type.h>
+
+namespace copperhead {
+
+//A lazy view of Seq rotated by amount elements: element i is
+//Seq[(i + amount) mod size].  The amount is normalized into
+//[0, size), so indices in [0, interior_end()) read Seq[i + amount]
+//and the remaining amount indices wrap around to the front.
+template<typename Seq>
+struct rotated_sequence {
+    typedef typename Seq::tag tag;
+    typedef typename Seq::value_type value_type;
+    typedef value_type el_type;
+    typedef value_type T;
+    typedef value_type ref_type;
+    typedef typename Seq::index_type index_type;
+    typedef typename detail::signed_index_type<index_type>::type offset_type;
+    typedef typename sequence_iterator<rotated_sequence<Seq> >::type iterator_type;
+
+    Seq m_s;
+    index_type m_amount;
+
+    __host__ __device__
+    rotated_sequence(const Seq& s,
+                     const offset_type& amount)
+        : m_s(s), m_amount(0) {
+        offset_type l = s.size();
+        if (l > 0) {
+            offset_type a = amount % l;
+            m_amount = (a < 0) ? a + l : a;
+        }
+    }
+
+    __host__ __device__
+    index_type size() const {
+        return m_s.size();
+    }
+
+    __host__ __device__
+    bool empty() const {
+        return size() <= 0;
+    }
+
+    __host__ __device__
+    index_type interior_begin() const {
+        return 0;
+    }
+
+    __host__ __device__
+    index_type interior_end() const {
+        return size() - m_amount;
+    }
+
+    __host__ __device__
+    value_type operator[](const index_type& i) const {
+        index_type j = i + m_amount;
+        if (j >= size()) {
+            j -= size();
+        }
+        return m_s[j];
+    }
+
+    __host__
+    iterator_type begin() const {
+        return make_sequence_iterator(*this);
+    }
+
+    __host__
+    iterator_type end() const {
+        return make_sequence_iterator(*this) + size();
+    }
+};
+
+}
@@ -0,0 +1,95 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <prelude/sequences/sequence_iterator.h>
+#include <prelude/basic/detail/signed_index_type.h>
+
+namespace copperhead {
+
+//A lazy view of Seq shifted by amount elements: element i is
+//Seq[i + amount], or boundary where i + amount falls outside Seq.
+//Indices in [interior_begin(), interior_end()) never touch the
+//boundary, so loops over them can skip the bounds checks.
+template<typename Seq>
+struct shifted_sequence {
+    typedef typename Seq::tag tag;
+    typedef typename Seq::value_type value_type;
+    typedef value_type el_type;
+    typedef value_type T;
+    typedef value_type ref_type;
+    typedef typename Seq::index_type index_type;
+    typedef typename detail::signed_index_type<index_type>::type offset_type;
+    typedef typename sequence_iterator<shifted_sequence<Seq> >::type iterator_type;
+
+    Seq m_s;
+    offset_type m_amount;
+    value_type m_boundary;
+
+    __host__ __device__
+    shifted_sequence(const Seq& s,
+                     const offset_type& amount,
+                     const value_type& boundary)
+        : m_s(s), m_amount(amount), m_boundary(boundary) {}
+
+    __host__ __device__
+    index_type size() const {
+        return m_s.size();
+    }
+
+    __host__ __device__
+    bool empty() const {
+        return size() <= 0;
+    }
+
+    __host__ __device__
+    index_type interior_begin() const {
+        if (m_amount >= 0) {
+            return 0;
+        }
+        offset_type b = -m_amount;
+        return (b < (offset_type)size()) ? b : size();
+    }
+
+    __host__ __device__
+    index_type interior_end() const {
+        if (m_amount <= 0) {
+            return size();
+        }
+        return (m_amount < (offset_type)size()) ? size() - m_amount : 0;
+    }
+
+    __host__ __device__
+    value_type operator[](const index_type& i) const {
+        offset_type j = (offset_type)i + m_amount;
+        if ((j < 0) || (j >= (offset_type)size())) {
+            return m_boundary;
+        }
+        return m_s[j];
+    }
+
+    __host__
+    iterator_type begin() const {
+        return make_sequence_iterator(*this);
+    }
+
+    __host__
+    iterator_type end() const {
+        return make_sequence_iterator(*this) + size();
+    }
+};
+
+}
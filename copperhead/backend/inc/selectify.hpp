@@ -0,0 +1,89 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include "node.hpp"
+#include "type.hpp"
+#include "ctype.hpp"
+#include "rewriter.hpp"
+#include "utility/name_supply.hpp"
+#include "utility/isinstance.hpp"
+#include <map>
+#include <set>
+#include <string>
+
+namespace backend {
+
+/*!
+  \addtogroup rewriters
+  @{
+*/
+
+//! A rewrite pass which lowers cheap conditionals to selects
+/*! Conditionals are printed as C++ branches, which keep compilers
+  from vectorizing functors, and which diverge on data dependent
+  predicates. When both branches of a conditional are straight line
+  code over scalars, built from side effect free operations, this
+  pass evaluates both branches and selects the result:
+  \verbatim if c:
+    e0 = op_sub(1.0, x)
+    return e0
+else:
+    return x \endverbatim
+  becomes
+  \verbatim e0 = op_sub(1.0, x)
+return op_select(c, e0, x) \endverbatim
+
+  Operations which may fault when evaluated speculatively, such as
+  integer division or subscripts, are never lowered.  Each operation
+  has a cost, and conditionals whose branches together cost more
+  than the threshold are left as branches, since the branch is then
+  cheaper than evaluating both sides.
+*/
+class selectify
+    : public rewriter<selectify>
+{
+private:
+    int m_threshold;
+    detail::name_supply m_names;
+    //Adds the cost of evaluating e to cost, returns false if e
+    //can't be evaluated speculatively
+    bool cost(const expression& e, int& cost) const;
+    //Collects the statements of a straight line branch, renaming
+    //names which are bound in the other branch
+    bool straight(const suite& s,
+                  const std::set<std::string>& taken,
+                  std::vector<std::shared_ptr<const statement> >& stmts,
+                  std::shared_ptr<const expression>& val,
+                  int& cost);
+public:
+    //! Default cost threshold, in units of a cheap scalar operation
+    static const int default_threshold = 8;
+    //! Constructor
+    /*! \param threshold Conditionals whose branches together cost
+      more than this remain branches.
+    */
+    selectify(int threshold = default_threshold);
+    using rewriter<selectify>::operator();
+    //! Rewrite rule for \p conditional nodes
+    result_type operator()(const conditional& n);
+};
+
+/*!
+  @}
+*/
+
+}
@@ -41,19 +41,48 @@ namespace backend {
 /*! This rewriter performs all rewrites specific to the Thrust library.
   For example, it makes mapn calls produce a transformed_sequence<>
   C++ implementation type, or indices produce a counting_sequence
-  C++ implementation type.
+  C++ implementation type. Maps over shifts of a single flat sequence
+  become a cache blocked stencil_sequence.
 */
 class thrust_rewriter
     : public rewriter<thrust_rewriter> {
 private:
     const copperhead::system_variant& m_target;
-    
+
+    //! A shift seen earlier, which a map may turn into a stencil
+    struct shift_info {
+        std::shared_ptr<const name> m_src;
+        std::shared_ptr<const expression> m_offset;
+        std::shared_ptr<const expression> m_boundary;
+        //! The literal the boundary holds, to compare boundaries
+        std::string m_boundary_value;
+    };
+    std::map<std::string, shift_info> m_shifts;
+
+    //! A literal cast to the element type of a sequence
+    struct literal_cast {
+        std::string m_value;
+        std::string m_seq;
+    };
+    //! Literal casts seen earlier, by the name they are bound to
+    std::map<std::string, literal_cast> m_literal_casts;
+
+    std::shared_ptr<const ctype::type_t> functor_ctype(const expression& fn);
+
     result_type map_rewrite(const bind& n);
+
+    bool is_stencil(const apply& rhs);
+
+    result_type stencil_rewrite(const bind& n);
     
     result_type indices_rewrite(const bind& n);
 
     result_type replicate_rewrite(const bind& n);
 
+    result_type random_rewrite(const bind& n);
+
+    result_type shift_rewrite(const bind& n);
+
     result_type zip_rewrite(const bind& n);
 
     result_type gather_rewrite(const bind& n);
@@ -66,6 +95,8 @@ public:
     
     using rewriter<thrust_rewriter>::operator();
     
+    result_type operator()(const procedure& n);
+
     result_type operator()(const bind& n);
     
 };
@@ -36,6 +36,8 @@ std::string wrap_proc_id(const std::string &in);
 std::string typify(const std::string &in);
 //! Creates a name for the completed identifier after a synchronization point.
 std::string complete(const std::string &in);
+//! Creates a name for the caller provided container for the result.
+std::string out_array_id();
 
 /*!
   @}
@@ -41,6 +41,10 @@ const std::string boost_python_module();
 const std::string boost_python_def();
 //! Gets string for phase_boundary
 const std::string phase_boundary();
+//! Gets string for release
+const std::string release();
+//! Gets string for deliver
+const std::string deliver();
 //! Gets string for thrust::get<x>
 const std::string snippet_get(int x=-1);
 //! Gets string for thrust::make_tuple
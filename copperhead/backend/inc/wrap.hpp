@@ -38,7 +38,9 @@ namespace backend {
   containers that are held by the broader context of the program,
   whereas the rest of the program operates solely on views.  This pass
   adds a wrapper which operates on containers, derives views, and then
-  calls the body of the entry point.
+  calls the body of the entry point.  Entry points which return a
+  sequence also accept a container from the caller, which receives
+  the result if it is not empty.
   
 */
 class wrap
@@ -48,6 +50,7 @@ private:
     const copperhead::system_variant& m_target;
     const std::string& m_entry_point;
     bool m_wrapping;
+    bool m_out;
     bool needs_container(const type_t&);
 public:
     //! Constructor
@@ -1,7 +1,13 @@
 #include "allocate.hpp"
 #include "utility/up_get.hpp"
+#include <map>
+#include <set>
+#include <sstream>
+#include <algorithm>
 
 using std::vector;
+using std::map;
+using std::set;
 using std::shared_ptr;
 using std::make_shared;
 using std::string;
@@ -13,6 +19,75 @@ using backend::utility::make_vector;
 namespace backend {
 
 
+namespace detail {
+
+//Collects the identifiers used in a statement
+class name_collector
+    : public rewriter<name_collector> {
+private:
+    set<string> m_names;
+public:
+    using rewriter<name_collector>::operator();
+    result_type operator()(const name& n) {
+        m_names.insert(n.id());
+        return n.ptr();
+    }
+    const set<string>& names() const {
+        return m_names;
+    }
+};
+
+//Counts how many times each identifier is bound, at any depth,
+//and collects the identifiers which are returned
+class bind_counter
+    : public rewriter<bind_counter> {
+private:
+    map<string, int> m_binds;
+    set<string> m_returns;
+public:
+    using rewriter<bind_counter>::operator();
+    result_type operator()(const bind& n) {
+        name_collector c;
+        boost::apply_visitor(c, n.lhs());
+        for(auto i = c.names().begin(); i != c.names().end(); i++) {
+            m_binds[*i]++;
+        }
+        return n.ptr();
+    }
+    result_type operator()(const ret& n) {
+        name_collector c;
+        boost::apply_visitor(c, n.val());
+        m_returns.insert(c.names().begin(), c.names().end());
+        return n.ptr();
+    }
+    int binds(const string& id) const {
+        auto i = m_binds.find(id);
+        return (i == m_binds.end()) ? 0 : i->second;
+    }
+    const set<string>& returns() const {
+        return m_returns;
+    }
+};
+
+//Prints an implementation type, so that types may be compared
+string ctype_string(const copperhead::system_variant& target,
+                    const ctype::type_t& t) {
+    std::ostringstream os;
+    ctype::ctype_printer ctp(target, os);
+    boost::apply_visitor(ctp, t);
+    return os.str();
+}
+
+//Primitives whose last argument may be overwritten by their result,
+//when given its container
+bool runs_in_place(const string& fn) {
+    return (fn == "scan") || (fn == "rscan") ||
+        (fn == "exclusive_scan") || (fn == "exclusive_rscan") ||
+        (fn == "sort") || (fn == "adjacent_difference");
+}
+
+}
+
 allocate::allocate(const copperhead::system_variant& target,
                    const string& entry_point) : m_target(target),
                                                 m_entry_point(entry_point),
@@ -22,14 +97,229 @@ allocate::allocate(const copperhead::system_variant& target,
 allocate::result_type allocate::operator()(const procedure &n) {
     if (n.id().id()  == m_entry_point) {
         m_in_entry = true;
-        auto result = this->rewriter::operator()(n);
+        //A sequence result which is bound exactly once may be completed
+        //directly into a container provided by the caller
+        m_out.clear();
+        const ctype::fn_t& n_ct = boost::get<const ctype::fn_t&>(n.ctype());
+        if (detail::isinstance<ctype::sequence_t>(n_ct.result())) {
+            detail::bind_counter counter;
+            boost::apply_visitor(counter, n.stmts());
+            if ((counter.returns().size() == 1) &&
+                (counter.binds(*counter.returns().begin()) == 1)) {
+                m_out = *counter.returns().begin();
+            }
+        }
+        map<size_t, string> donors;
+        map<size_t, vector<string> > releases = liveness(n.stmts(), donors);
+        vector<shared_ptr<const statement> > stmts;
+        size_t index = 0;
+        for(auto i = n.stmts().begin();
+            i != n.stmts().end();
+            i++, index++) {
+            auto donor = donors.find(index);
+            m_donor = (donor == donors.end()) ? string() : donor->second;
+            auto rewritten = boost::apply_visitor(*this, *i);
+            m_donor.clear();
+            if (detail::isinstance<suite>(*rewritten)) {
+                const suite& nested = boost::get<const suite&>(*rewritten);
+                for(auto j = nested.begin(); j != nested.end(); j++) {
+                    stmts.push_back(j->ptr());
+                }
+            } else {
+                stmts.push_back(
+                    static_pointer_cast<const statement>(rewritten));
+            }
+            auto dead = releases.find(index);
+            if (dead == releases.end()) {
+                continue;
+            }
+            for(auto j = dead->second.begin(); j != dead->second.end(); j++) {
+                stmts.push_back(
+                    make_shared<const call>(
+                        make_shared<const apply>(
+                            make_shared<const name>(detail::release()),
+                            make_shared<const tuple>(
+                                make_vector<shared_ptr<const expression> >(
+                                    make_shared<const name>(
+                                        detail::wrap_array_id(*j)))))));
+            }
+        }
         m_in_entry = false;
-        return result;
+        m_out.clear();
+        return make_shared<const procedure>(
+            n.id().ptr(),
+            n.args().ptr(),
+            make_shared<const suite>(std::move(stmts)),
+            n.type().ptr(),
+            n.ctype().ptr(),
+            n.place());
     } else {
         return this->rewriter::operator()(n);
     }
 }
 
+map<size_t, vector<string> > allocate::liveness(
+    const suite& n,
+    map<size_t, string>& donors) {
+    detail::bind_counter counter;
+    boost::apply_visitor(counter, n);
+
+    //A temporary may be released once neither it, nor any lazily
+    //formed sequence built from it, can be used again.  roots maps
+    //each sequence to the temporaries whose storage it may view.
+    map<string, set<string> > roots;
+    map<string, size_t> last_use;
+    set<string> pinned;
+    //The implementation type of each temporary, and the statements
+    //which may be given a dead temporary of that type
+    map<string, string> ctypes;
+    map<size_t, string> in_place;
+    map<size_t, string> boundaries;
+    size_t index = 0;
+    for(auto i = n.begin(); i != n.end(); i++, index++) {
+        detail::name_collector used;
+        boost::apply_visitor(used, *i);
+        set<string> used_roots;
+        for(auto j = used.names().begin(); j != used.names().end(); j++) {
+            auto r = roots.find(*j);
+            if (r != roots.end()) {
+                used_roots.insert(r->second.begin(), r->second.end());
+            }
+        }
+        for(auto j = used_roots.begin(); j != used_roots.end(); j++) {
+            last_use[*j] = index;
+        }
+        if (!detail::isinstance<bind>(*i)) {
+            //Storage used in loops or conditionals is kept until
+            //the end of the procedure
+            if (!detail::isinstance<ret>(*i)) {
+                pinned.insert(used_roots.begin(), used_roots.end());
+            }
+            continue;
+        }
+        const bind& b = boost::get<const bind&>(*i);
+        if (!detail::isinstance<name>(b.lhs())) {
+            continue;
+        }
+        const name& lhs = boost::get<const name&>(b.lhs());
+        if ((counter.binds(lhs.id()) == 1) &&
+            detail::isinstance<apply>(b.rhs()) &&
+            detail::isinstance<ctype::sequence_t>(lhs.ctype())) {
+            //A temporary, which will be given its own container
+            roots[lhs.id()].insert(lhs.id());
+            last_use[lhs.id()] = index;
+            ctypes[lhs.id()] = detail::ctype_string(m_target, lhs.ctype());
+            const apply& rhs = boost::get<const apply&>(b.rhs());
+            if (!detail::isinstance<name>(rhs.fn())) {
+                continue;
+            }
+            const string& fn = boost::get<const name&>(rhs.fn()).id();
+            if ((fn == detail::phase_boundary()) &&
+                (rhs.args().arity() == 1) &&
+                (lhs.id() != m_out)) {
+                boundaries[index] = ctypes[lhs.id()];
+            } else if (detail::runs_in_place(fn) &&
+                       detail::isinstance<name>(*(rhs.args().end() - 1))) {
+                //The input may be overwritten if it is a temporary
+                //which nothing else in this statement can view
+                const string& x =
+                    boost::get<const name&>(*(rhs.args().end() - 1)).id();
+                auto r = roots.find(x);
+                if ((r == roots.end()) || (r->second.size() != 1) ||
+                    (*r->second.begin() != x) ||
+                    (ctypes[x] != ctypes[lhs.id()])) {
+                    continue;
+                }
+                bool viewed = false;
+                for(auto j = rhs.args().begin();
+                    j != rhs.args().end() - 1;
+                    j++) {
+                    detail::name_collector others;
+                    boost::apply_visitor(others, *j);
+                    for(auto k = others.names().begin();
+                        k != others.names().end();
+                        k++) {
+                        auto o = roots.find(*k);
+                        if ((o != roots.end()) &&
+                            (o->second.find(x) != o->second.end())) {
+                            viewed = true;
+                        }
+                    }
+                }
+                if (!viewed) {
+                    in_place[index] = x;
+                }
+            }
+        } else if (detail::isinstance<sequence_t>(lhs.type()) ||
+                   detail::isinstance<tuple_t>(lhs.type())) {
+            //May be a view of the storage of the names it is built from
+            detail::name_collector sources;
+            boost::apply_visitor(sources, b.rhs());
+            for(auto j = sources.names().begin();
+                j != sources.names().end();
+                j++) {
+                auto r = roots.find(*j);
+                if (r != roots.end()) {
+                    roots[lhs.id()].insert(r->second.begin(), r->second.end());
+                }
+            }
+        }
+    }
+    for(auto i = counter.returns().begin(); i != counter.returns().end(); i++) {
+        auto r = roots.find(*i);
+        if (r != roots.end()) {
+            pinned.insert(r->second.begin(), r->second.end());
+        }
+    }
+    map<size_t, vector<string> > releases;
+    for(auto i = last_use.begin(); i != last_use.end(); i++) {
+        if (pinned.find(i->first) == pinned.end()) {
+            releases[i->second].push_back(i->first);
+        }
+    }
+
+    //Donate dead temporaries.  A donated container belongs to the
+    //result it was donated to, so it is never donated again.
+    vector<string> dead;
+    set<string> donated;
+    for(index = 0; index < static_cast<size_t>(n.size()); index++) {
+        auto x = in_place.find(index);
+        if ((x != in_place.end()) &&
+            (pinned.find(x->second) == pinned.end()) &&
+            (last_use[x->second] == index)) {
+            donors[index] = x->second;
+            donated.insert(x->second);
+        }
+        auto b = boundaries.find(index);
+        if (b != boundaries.end()) {
+            //Prefer the temporary which died most recently
+            for(auto d = dead.rbegin(); d != dead.rend(); d++) {
+                if (ctypes[*d] != b->second) {
+                    continue;
+                }
+                //Keep the donor until it is used
+                vector<string>& before = releases[last_use[*d]];
+                before.erase(std::find(before.begin(), before.end(), *d));
+                releases[index].push_back(*d);
+                donors[index] = *d;
+                donated.insert(*d);
+                dead.erase(std::next(d).base());
+                break;
+            }
+        }
+        auto r = releases.find(index);
+        if (r == releases.end()) {
+            continue;
+        }
+        for(auto d = r->second.begin(); d != r->second.end(); d++) {
+            if (donated.find(*d) == donated.end()) {
+                dead.push_back(*d);
+            }
+        }
+    }
+    return releases;
+}
+
 shared_ptr<const ctype::type_t> allocate::container_type(const ctype::type_t& t) {
     if (detail::isinstance<ctype::sequence_t>(t)) {
         const ctype::sequence_t& st = detail::up_get<const ctype::sequence_t&>(t);
@@ -90,6 +380,44 @@ allocate::result_type allocate::operator()(const bind &n) {
                 static_pointer_cast<const expression>(
                     boost::apply_visitor(*this, n.rhs()));
 
+        //If this is the completion of the result, complete it into
+        //the container provided by the caller, if there is one
+        if (pre_lhs.id() == m_out) {
+            const apply& rhs = boost::get<const apply&>(n.rhs());
+            if (detail::isinstance<name>(rhs.fn()) &&
+                (boost::get<const name&>(rhs.fn()).id() ==
+                 detail::phase_boundary()) &&
+                (rhs.args().arity() == 1)) {
+                const apply& new_apply = boost::get<const apply&>(*new_rhs);
+                new_rhs = make_shared<const apply>(
+                    new_apply.fn().ptr(),
+                    make_shared<const tuple>(
+                        make_vector<shared_ptr<const expression> >(
+                            new_apply.args().begin()->ptr())
+                        (make_shared<const name>(
+                            detail::out_array_id(),
+                            result_t,
+                            containerized))));
+            }
+        }
+
+        //Store the result in the container of a dead temporary
+        if (!m_donor.empty()) {
+            const apply& new_apply = boost::get<const apply&>(*new_rhs);
+            vector<shared_ptr<const expression> > donated_args;
+            for(auto i = new_apply.args().begin();
+                i != new_apply.args().end();
+                i++) {
+                donated_args.push_back(i->ptr());
+            }
+            donated_args.push_back(
+                make_shared<const name>(
+                    detail::wrap_array_id(m_donor)));
+            new_rhs = make_shared<const apply>(
+                new_apply.fn().ptr(),
+                make_shared<const tuple>(std::move(donated_args)));
+        }
+
         //At this point, we know the lhs of this bind must be containerized.
         //If the rhs is a tuple get operation, we're getting from a
         //container tuple, and so it needs to be containerized as well
@@ -103,7 +103,20 @@ vector<named_info> unary_math_operators =
     (named_info("sqrt", un_op_info))
     (named_info("abs", un_op_info))
     (named_info("exp", un_op_info))
-    (named_info("log", un_op_info));
+    (named_info("log", un_op_info))
+    (named_info("sin", un_op_info))
+    (named_info("cos", un_op_info))
+    (named_info("tan", un_op_info))
+    (named_info("erf", un_op_info))
+    (named_info("floor", un_op_info))
+    (named_info("ceil", un_op_info));
+
+vector<named_info> binary_math_operators =
+    make_vector<named_info>
+    (named_info("pow", bin_op_info))
+    (named_info("atan2", bin_op_info))
+    (named_info("minimum", bin_op_info))
+    (named_info("maximum", bin_op_info));
 
 vector<named_info> cpp_support_fns =
     make_vector<named_info>
@@ -137,6 +150,7 @@ void load_scalars(
 shared_ptr<library> get_builtins() {
     map<ident, fn_info> fns;
     builtins::load_scalars(fns, builtins::detail::unary_math_operators);
+    builtins::load_scalars(fns, builtins::detail::binary_math_operators);
     builtins::load_scalars(fns, builtins::detail::unary_scalar_operators);
     builtins::load_scalars(fns, builtins::detail::binary_scalar_operators);
     builtins::load_scalars(fns, builtins::detail::cpp_support_fns);
@@ -75,6 +75,7 @@ std::shared_ptr<const suite> compiler::operator()(const suite &n) {
         backend_translate(),
         tuple_break(),
         iterizer(),
+        flatten(m_entry_point),
         phase_analyze(m_entry_point, m_registry),
         type_convert(),
         functorize(m_entry_point, m_registry),
@@ -83,6 +84,7 @@ std::shared_ptr<const suite> compiler::operator()(const suite &n) {
         allocate(m_backend_tag, m_entry_point),
         wrap(m_backend_tag, m_entry_point),
         containerize(m_entry_point),
+        selectify(),
         typedefify(),
         find_includes(m_registry),
         prune());
@@ -0,0 +1,345 @@
+#include "flatten.hpp"
+#include "utility/isinstance.hpp"
+#include <iterator>
+
+using std::string;
+using std::shared_ptr;
+using std::make_shared;
+using std::static_pointer_cast;
+using std::vector;
+using std::map;
+
+namespace backend {
+
+namespace detail {
+
+//Substitutes the actual closed over arguments for the formal
+//parameters of a procedure.  Notes if the element parameter, which
+//has no counterpart outside the procedure, is used.
+class substitute_formals
+    : public rewriter<substitute_formals> {
+private:
+    const map<string, shared_ptr<const expression> >& m_subs;
+    const string& m_element;
+    bool m_escaped;
+public:
+    substitute_formals(const map<string, shared_ptr<const expression> >& subs,
+                       const string& element)
+        : m_subs(subs), m_element(element), m_escaped(false) {}
+    using rewriter<substitute_formals>::operator();
+    result_type operator()(const name& n) {
+        if (n.id() == m_element) {
+            m_escaped = true;
+            return n.ptr();
+        }
+        auto found = m_subs.find(n.id());
+        if (found == m_subs.end()) {
+            return n.ptr();
+        }
+        return found->second;
+    }
+    bool escaped() const {
+        return m_escaped;
+    }
+};
+
+//Nested operations we know how to flatten, the position of their
+//sequence argument, and the segmented primitive replacing them
+struct segmented_op {
+    const char* id;
+    int seq_arg;
+    const char* segmented_id;
+};
+
+const segmented_op* find_segmented_op(const string& id) {
+    static const segmented_op ops[] = {
+        {"map1", 1, "segmented_map"},
+        {"reduce", 1, "segmented_reduce"},
+        {"scan", 1, "segmented_scan"},
+        {"exclusive_scan", 2, "segmented_exclusive_scan"}
+    };
+    for(auto i = std::begin(ops); i != std::end(ops); i++) {
+        if (id == i->id) {
+            return i;
+        }
+    }
+    return NULL;
+}
+
+bool is_doubly_nested(const type_t& t) {
+    if (!detail::isinstance<sequence_t>(t)) {
+        return false;
+    }
+    const sequence_t& outer = boost::get<const sequence_t&>(t);
+    if (!detail::isinstance<sequence_t>(outer.sub())) {
+        return false;
+    }
+    const sequence_t& inner = boost::get<const sequence_t&>(outer.sub());
+    return !detail::isinstance<sequence_t>(inner.sub());
+}
+
+//The frontend casts literals passed to polymorphic functions, binding
+//each cast to its own name.  If b is such a cast, returns the literal
+//with the type of the cast.
+shared_ptr<const expression> literal_cast(const bind& b) {
+    if (!detail::isinstance<name>(b.lhs()) ||
+        !detail::isinstance<apply>(b.rhs())) {
+        return shared_ptr<const expression>();
+    }
+    const apply& a = boost::get<const apply&>(b.rhs());
+    const string& id = a.fn().id();
+    if ((id != "cast_to_el") && (id != "cast_to") &&
+        (id != "int32") && (id != "int64") &&
+        (id != "float32") && (id != "float64")) {
+        return shared_ptr<const expression>();
+    }
+    auto arg = a.args().begin();
+    //Names are literals too
+    if ((arg == a.args().end()) ||
+        !detail::isinstance<literal>(*arg) ||
+        detail::isinstance<name>(*arg)) {
+        return shared_ptr<const expression>();
+    }
+    return make_shared<const literal>(
+        boost::get<const literal&>(*arg).id(),
+        b.lhs().type().ptr());
+}
+
+//Finds the single application a procedure's result is bound to.
+//Literal casts preceding it are gathered into casts, by the name
+//they are bound to.
+const apply* sole_apply(const procedure& p,
+                        map<string, shared_ptr<const expression> >& casts) {
+    const suite& stmts = p.stmts();
+    auto i = stmts.begin();
+    for(; (i != stmts.end()) && detail::isinstance<bind>(*i); ++i) {
+        const bind& b = boost::get<const bind&>(*i);
+        shared_ptr<const expression> cast = literal_cast(b);
+        if (!cast) {
+            break;
+        }
+        casts[boost::get<const name&>(b.lhs()).id()] = cast;
+    }
+    if (i == stmts.end()) {
+        return NULL;
+    }
+    if (detail::isinstance<ret>(*i)) {
+        if (std::next(i) != stmts.end()) {
+            return NULL;
+        }
+        const ret& r = boost::get<const ret&>(*i);
+        if (detail::isinstance<apply>(r.val())) {
+            return &boost::get<const apply&>(r.val());
+        }
+        return NULL;
+    }
+    if (!detail::isinstance<bind>(*i)) {
+        return NULL;
+    }
+    const bind& b = boost::get<const bind&>(*i);
+    if (!detail::isinstance<name>(b.lhs()) ||
+        !detail::isinstance<apply>(b.rhs())) {
+        return NULL;
+    }
+    auto j = std::next(i);
+    if ((j == stmts.end()) ||
+        (std::next(j) != stmts.end()) ||
+        !detail::isinstance<ret>(*j)) {
+        return NULL;
+    }
+    const ret& r = boost::get<const ret&>(*j);
+    if (!detail::isinstance<name>(r.val()) ||
+        (boost::get<const name&>(r.val()).id() !=
+         boost::get<const name&>(b.lhs()).id())) {
+        return NULL;
+    }
+    return &boost::get<const apply&>(b.rhs());
+}
+
+//map(sum, x) over a nested x is segmented_reduce(op_add, x, 0)
+shared_ptr<const bind> segmented_sum(const bind& n,
+                                     const expression& seq_arg) {
+    const sequence_t& outer = boost::get<const sequence_t&>(seq_arg.type());
+    const sequence_t& inner = boost::get<const sequence_t&>(outer.sub());
+    shared_ptr<const type_t> el_t = inner.sub().ptr();
+    vector<shared_ptr<const type_t> > add_arg_types;
+    add_arg_types.push_back(el_t);
+    add_arg_types.push_back(el_t);
+    shared_ptr<const fn_t> add_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(std::move(add_arg_types)),
+            el_t);
+
+    vector<shared_ptr<const expression> > args;
+    args.push_back(make_shared<const name>("op_add", add_t));
+    args.push_back(seq_arg.ptr());
+    args.push_back(make_shared<const literal>("0", el_t));
+    vector<shared_ptr<const type_t> > arg_types;
+    arg_types.push_back(add_t);
+    arg_types.push_back(seq_arg.type().ptr());
+    arg_types.push_back(el_t);
+    shared_ptr<const fn_t> segmented_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(std::move(arg_types)),
+            n.lhs().type().ptr());
+    return make_shared<const bind>(
+        n.lhs().ptr(),
+        make_shared<const apply>(
+            make_shared<const name>("segmented_reduce", segmented_t),
+            make_shared<const tuple>(std::move(args))));
+}
+
+shared_ptr<const fn_t> monomorphic_fn_type(const name& fn) {
+    if (detail::isinstance<fn_t>(fn.type())) {
+        return static_pointer_cast<const fn_t>(fn.type().ptr());
+    }
+    if (detail::isinstance<polytype_t>(fn.type())) {
+        const polytype_t& pt = boost::get<const polytype_t&>(fn.type());
+        if (detail::isinstance<fn_t>(pt.monotype())) {
+            return static_pointer_cast<const fn_t>(pt.monotype().ptr());
+        }
+    }
+    return shared_ptr<const fn_t>();
+}
+
+}
+
+flatten::flatten(const string& entry_point)
+    : m_entry_point(entry_point), m_in_entry(false) {}
+
+flatten::result_type flatten::operator()(const suite& n) {
+    for(auto i = n.begin(); i != n.end(); i++) {
+        if (detail::isinstance<procedure>(*i)) {
+            const procedure& p = boost::get<const procedure&>(*i);
+            m_procs[p.id().id()] = p.ptr();
+        }
+    }
+    return rewriter<flatten>::operator()(n);
+}
+
+flatten::result_type flatten::operator()(const procedure& n) {
+    m_in_entry = (n.id().id() == m_entry_point);
+    result_type result = rewriter<flatten>::operator()(n);
+    m_in_entry = false;
+    return result;
+}
+
+flatten::result_type flatten::operator()(const bind& n) {
+    if (!m_in_entry ||
+        !detail::isinstance<name>(n.lhs()) ||
+        !detail::isinstance<apply>(n.rhs())) {
+        return n.ptr();
+    }
+    const apply& outer = boost::get<const apply&>(n.rhs());
+    if ((outer.fn().id() != "map1") || (outer.args().arity() != 2)) {
+        return n.ptr();
+    }
+    auto outer_arg = outer.args().begin();
+    const expression& fn_arg = *outer_arg;
+    const expression& seq_arg = *std::next(outer_arg);
+    if (!detail::isinstance<name>(seq_arg) ||
+        !detail::is_doubly_nested(seq_arg.type())) {
+        return n.ptr();
+    }
+
+    //The mapped function is either a procedure, or a closure over one
+    const name* fn_name;
+    const tuple* closed;
+    if (detail::isinstance<name>(fn_arg)) {
+        fn_name = &boost::get<const name&>(fn_arg);
+        closed = NULL;
+    } else if (detail::isinstance<closure>(fn_arg)) {
+        const closure& c = boost::get<const closure&>(fn_arg);
+        if (!detail::isinstance<name>(c.body())) {
+            return n.ptr();
+        }
+        fn_name = &boost::get<const name&>(c.body());
+        closed = &c.args();
+    } else {
+        return n.ptr();
+    }
+    if (!closed && (fn_name->id() == "sum")) {
+        return detail::segmented_sum(n, seq_arg);
+    }
+    auto found = m_procs.find(fn_name->id());
+    if (found == m_procs.end()) {
+        return n.ptr();
+    }
+    const procedure& p = *found->second;
+    int n_closed = closed ? closed->arity() : 0;
+    if (p.args().arity() != 1 + n_closed) {
+        return n.ptr();
+    }
+
+    //Closed over values are passed after the element parameter
+    auto formal = p.args().begin();
+    if (!detail::isinstance<name>(*formal)) {
+        return n.ptr();
+    }
+    const string& element = boost::get<const name&>(*formal).id();
+    map<string, shared_ptr<const expression> > subs;
+    if (closed) {
+        for(auto i = closed->begin(); i != closed->end(); i++) {
+            ++formal;
+            if (!detail::isinstance<name>(*formal)) {
+                return n.ptr();
+            }
+            subs[boost::get<const name&>(*formal).id()] = i->ptr();
+        }
+    }
+
+    const apply* inner = detail::sole_apply(p, subs);
+    if (!inner) {
+        return n.ptr();
+    }
+    const detail::segmented_op* op = detail::find_segmented_op(inner->fn().id());
+    shared_ptr<const fn_t> inner_t = detail::monomorphic_fn_type(inner->fn());
+    if (!op || !inner_t ||
+        (inner->args().arity() != inner_t->args().arity())) {
+        return n.ptr();
+    }
+
+    //Rebuild the arguments, with the nested sequence replacing
+    //the element parameter
+    vector<shared_ptr<const expression> > args;
+    vector<shared_ptr<const type_t> > arg_types;
+    int position = 0;
+    auto arg_t = inner_t->args().begin();
+    for(auto i = inner->args().begin();
+        i != inner->args().end();
+        i++, arg_t++, position++) {
+        if (position == op->seq_arg) {
+            if (!detail::isinstance<name>(*i) ||
+                (boost::get<const name&>(*i).id() != element)) {
+                return n.ptr();
+            }
+            args.push_back(seq_arg.ptr());
+            arg_types.push_back(seq_arg.type().ptr());
+        } else {
+            detail::substitute_formals s(subs, element);
+            shared_ptr<const expression> arg =
+                static_pointer_cast<const expression>(
+                    boost::apply_visitor(s, *i));
+            if (s.escaped()) {
+                return n.ptr();
+            }
+            args.push_back(arg);
+            arg_types.push_back(arg_t->ptr());
+        }
+    }
+
+    const name& lhs = boost::get<const name&>(n.lhs());
+    shared_ptr<const fn_t> segmented_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(std::move(arg_types)),
+            lhs.type().ptr());
+    return make_shared<const bind>(
+        n.lhs().ptr(),
+        make_shared<const apply>(
+            make_shared<const name>(
+                op->segmented_id,
+                segmented_t),
+            make_shared<const tuple>(std::move(args))));
+}
+
+}
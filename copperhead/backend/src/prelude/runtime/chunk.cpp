@@ -20,6 +20,8 @@
 #include <prelude/runtime/tags.h>
 #include <prelude/runtime/tag_malloc_and_free.h>
 #include <stdexcept>
+#include <cstring>
+#include <mutex>
 #include <thrust/copy.h>
 #include <boost/utility/enable_if.hpp>
 #include <boost/type_traits.hpp>
@@ -28,6 +30,11 @@
 
 namespace copperhead {
 
+class chunk_lock {
+public:
+    std::mutex m_mutex;
+};
+
 namespace detail {
 
 struct apply_malloc
@@ -87,10 +94,18 @@ struct apply_copy
 }
 
 chunk::chunk(const system_variant &s,
-             size_t r) : m_s(s), m_d(NULL), m_r(r) {}
+             size_t r) : m_s(s), m_d(NULL), m_r(r),
+                         m_lock(new chunk_lock()) {}
+
+chunk::chunk(const system_variant &s,
+             size_t r,
+             void* d,
+             const boost::shared_ptr<void>& owner)
+    : m_s(s), m_d(d), m_r(r), m_owner(owner),
+      m_lock(new chunk_lock()) {}
 
 chunk::~chunk() {
-    if (m_d != NULL) {
+    if ((m_d != NULL) && !m_owner) {
         boost::apply_visitor(
             detail::apply_free(m_d),
             m_s);
@@ -101,6 +116,9 @@ void chunk::copy_from(chunk& o) {
     if (m_r != o.m_r) {
         throw std::invalid_argument("Internal error: can't copy chunks of different size");
     }
+    //Contents are about to be overwritten, don't write through to
+    //borrowed storage
+    unshare(false);
     boost::apply_visitor(detail::apply_copy(ptr(),
                                             o.ptr(),
                                             m_r),
@@ -108,8 +126,32 @@ void chunk::copy_from(chunk& o) {
                          o.m_s);
 }
 
+bool chunk::borrowed() const {
+    std::lock_guard<std::mutex> guard(m_lock->m_mutex);
+    return bool(m_owner);
+}
+
+void chunk::unshare(bool preserve) {
+    //The owner is dropped after the lock is released, since its
+    //deleter may need to wait for the GIL
+    boost::shared_ptr<void> owner;
+    std::lock_guard<std::mutex> guard(m_lock->m_mutex);
+    if (!m_owner) {
+        return;
+    }
+    void* borrowed = m_d;
+    m_d = boost::apply_visitor(
+        detail::apply_malloc(m_r),
+        m_s);
+    if (preserve) {
+        //Borrowed storage is always host memory
+        std::memcpy(m_d, borrowed, m_r);
+    }
+    owner.swap(m_owner);
+}
 
 void* chunk::ptr() {
+    std::lock_guard<std::mutex> guard(m_lock->m_mutex);
     if (m_d == NULL) {
         //Lazy allocation - only allocate when pointer is requested
         m_d = boost::apply_visitor(
@@ -127,4 +169,15 @@ const system_variant& chunk::tag() const {
     return m_s;
 }
 
+void chunk::set_event(const sp_event& e) {
+    boost::atomic_store(&m_e, e);
+}
+
+void chunk::sync() {
+    sp_event e = boost::atomic_load(&m_e);
+    if (e) {
+        wait(*e);
+    }
+}
+
 }
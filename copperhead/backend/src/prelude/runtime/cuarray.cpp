@@ -1,11 +1,69 @@
 #include <prelude/runtime/cuarray.hpp>
 #include <prelude/runtime/type_holder.hpp>
+#include <prelude/runtime/make_type_holder.hpp>
+#include <stdexcept>
+#include <mutex>
 
 namespace copperhead {
 
+data_map::data_map() {
+    for(int i = 0; i < n_systems; i++) {
+        m_present[i] = false;
+        m_r[i].second = false;
+    }
+}
+
+data_map::value_type& data_map::operator[](const system_variant& t) {
+    int i = memory_index(t);
+    m_present[i] = true;
+    return m_r[i];
+}
+
+bool data_map::contains(const system_variant& t) const {
+    return m_present[memory_index(t)];
+}
+
+bool data_map::empty() const {
+    for(int i = 0; i < n_systems; i++) {
+        if (m_present[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool data_map::present(int i) const {
+    return m_present[i];
+}
+
+data_map::value_type& data_map::at(int i) {
+    return m_r[i];
+}
+
+const data_map::value_type& data_map::at(int i) const {
+    return m_r[i];
+}
+
+class coherence_lock {
+public:
+    std::mutex m_mutex;
+};
+
+namespace detail {
+
+void sync_chunks(std::vector<boost::shared_ptr<chunk> >& chunks) {
+    for(std::vector<boost::shared_ptr<chunk> >::iterator i = chunks.begin();
+        i != chunks.end();
+        i++) {
+        (*i)->sync();
+    }
+}
+
+}
+
 cuarray::cuarray(type_holder* t,
                  size_t o)
-    : m_t(t), m_o(o) {}
+    : m_t(t), m_o(o), m_lock(new coherence_lock()) {}
 
 cuarray::~cuarray() {
     //This is done just to move the destructor to somewhere nvcc can't see
@@ -19,18 +77,9 @@ void cuarray::push_back_length(size_t l) {
 
 void cuarray::add_chunk(boost::shared_ptr<chunk> c,
                         const bool& v) {
-    system_variant t = c->tag();
-    if (m_d.find(t) == m_d.end()) {
-        std::vector<boost::shared_ptr<chunk> > new_vector;
-        new_vector.push_back(c);
-        std::pair<std::vector<boost::shared_ptr<chunk> >, bool> new_pair =
-            std::make_pair(std::move(new_vector), v);
-        m_d[t] = std::move(new_pair);
-    } else {
-        std::pair<std::vector<boost::shared_ptr<chunk> >, bool>& e = m_d[t];
-        e.second = v;
-        e.first.push_back(c);
-    }
+    data_map::value_type& e = m_d[c->tag()];
+    e.second = v;
+    e.first.push_back(c);
 }
 
 size_t cuarray::size() const {
@@ -42,19 +91,39 @@ size_t cuarray::size() const {
 }
 
 std::vector<boost::shared_ptr<chunk> >& cuarray::get_chunks(const system_variant& t, bool write) {
-    system_variant canonical_tag = canonical_memory_tag(t);
-    std::pair<std::vector<boost::shared_ptr<chunk> >, bool>& s = m_d[canonical_tag];
+    int index = memory_index(t);
+    //Wait for pending work on the chunks we return, and on those we
+    //copy them from, before taking the lock, since that work may
+    //itself need the lock
+    std::vector<boost::shared_ptr<chunk> > touched;
+    {
+        std::lock_guard<std::mutex> guard(m_lock->m_mutex);
+        data_map::value_type& s = m_d[t];
+        touched = s.first;
+        if (!s.second) {
+            for(int i = 0; i < n_systems; i++) {
+                if (m_d.present(i) && m_d.at(i).second) {
+                    touched.insert(touched.end(),
+                                   m_d.at(i).first.begin(),
+                                   m_d.at(i).first.end());
+                    break;
+                }
+            }
+        }
+    }
+    detail::sync_chunks(touched);
+    std::lock_guard<std::mutex> guard(m_lock->m_mutex);
+    data_map::value_type& s = m_d[t];
     //Do we need to copy?
     if (!s.second) {
         //Find a valid representation
-        std::pair<std::vector<boost::shared_ptr<chunk> >, bool> x;
-        x.second = false;
-        for(typename data_map::iterator i = m_d.begin();
-            (x.second == false) && (i != m_d.end());
-            i++) {
-            x = i->second;
+        int valid = 0;
+        while((valid < n_systems) &&
+              !(m_d.present(valid) && m_d.at(valid).second)) {
+            valid++;
         }
-        assert(x.second == true);
+        assert(valid < n_systems);
+        data_map::value_type& x = m_d.at(valid);
         //Copy from valid representation
         for(std::vector<boost::shared_ptr<chunk> >::iterator i = s.first.begin(),
                 j = x.first.begin();
@@ -66,17 +135,69 @@ std::vector<boost::shared_ptr<chunk> >& cuarray::get_chunks(const system_variant
     }
     //Do we need to invalidate?
     if (write) {
-        for(typename data_map::iterator i = m_d.begin();
-            i != m_d.end();
+        //Copy on write for chunks borrowed from other owners
+        for(std::vector<boost::shared_ptr<chunk> >::iterator i = s.first.begin();
+            i != s.first.end();
             i++) {
-            i->second.second = system_variant_equal(i->first, canonical_tag);
+            if ((*i)->borrowed()) {
+                (*i)->unshare(true);
+            }
+        }
+        for(int i = 0; i < n_systems; i++) {
+            m_d.at(i).second = (i == index);
         }
     }
     return s.first;
 }
 
+void cuarray::set_event(const sp_event& e) {
+    for(int i = 0; i < n_systems; i++) {
+        std::vector<boost::shared_ptr<chunk> >& chunks = m_d.at(i).first;
+        for(std::vector<boost::shared_ptr<chunk> >::iterator j = chunks.begin();
+            j != chunks.end();
+            j++) {
+            (*j)->set_event(e);
+        }
+    }
+}
+
+void cuarray::sync() {
+    for(int i = 0; i < n_systems; i++) {
+        detail::sync_chunks(m_d.at(i).first);
+    }
+}
+
 bool cuarray::clean(const system_variant& t) {
+    std::lock_guard<std::mutex> guard(m_lock->m_mutex);
     return m_d[t].second;
 }
 
+sp_cuarray deliver(const sp_cuarray& r,
+                   const sp_cuarray& out,
+                   const system_variant& t) {
+    if (!out || (r == out)) {
+        return r;
+    }
+    if ((out->m_l != r->m_l) || (out->m_o != r->m_o)) {
+        throw std::invalid_argument("out does not have the shape of the result");
+    }
+    if (!detail::same_type(out->m_t.get(), r->m_t.get())) {
+        throw std::invalid_argument("out does not have the type of the result");
+    }
+    std::vector<boost::shared_ptr<chunk> >& src = r->get_chunks(t, false);
+    std::vector<boost::shared_ptr<chunk> >& dst = out->get_chunks(t, true);
+    if (src.size() != dst.size()) {
+        throw std::invalid_argument("out does not have the type of the result");
+    }
+    for(size_t i = 0; i < src.size(); i++) {
+        if (src[i]->size() != dst[i]->size()) {
+            throw std::invalid_argument("out does not have the type of the result");
+        }
+    }
+    for(size_t i = 0; i < src.size(); i++) {
+        dst[i]->copy_from(*src[i]);
+    }
+    return out;
+}
+
 }
@@ -0,0 +1,54 @@
+#include <prelude/runtime/event.hpp>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace copperhead {
+
+class event {
+public:
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    std::atomic<bool> m_ready;
+    event() : m_ready(false) {}
+};
+
+namespace detail {
+
+std::atomic<wait_hook> g_wait_hook(&block);
+
+}
+
+sp_event make_event() {
+    return sp_event(new event());
+}
+
+void complete(event& e) {
+    std::lock_guard<std::mutex> guard(e.m_mutex);
+    e.m_ready = true;
+    e.m_done.notify_all();
+}
+
+bool ready(event& e) {
+    return e.m_ready;
+}
+
+void wait(event& e) {
+    if (e.m_ready) {
+        return;
+    }
+    detail::g_wait_hook.load()(e);
+}
+
+void block(event& e) {
+    std::unique_lock<std::mutex> lock(e.m_mutex);
+    while(!e.m_ready) {
+        e.m_done.wait(lock);
+    }
+}
+
+void set_wait_hook(wait_hook h) {
+    detail::g_wait_hook = h;
+}
+
+}
@@ -1,6 +1,8 @@
 #include <prelude/runtime/make_type_holder.hpp>
 #include <prelude/runtime/type_holder.hpp>
 #include <monotype.hpp>
+#include <polytype.hpp>
+#include <utility/isinstance.hpp>
 
 using std::shared_ptr;
 using std::make_shared;
@@ -63,6 +65,33 @@ void finalize_type(type_holder* t) {
 
 }
 
+//Containers only hold monotypes, which are equal when their names
+//and subtypes are
+static bool same_type(const backend::type_t& a, const backend::type_t& b) {
+    if (&a == &b) {
+        return true;
+    }
+    if (!backend::detail::isinstance<backend::monotype_t>(a) ||
+        !backend::detail::isinstance<backend::monotype_t>(b)) {
+        return false;
+    }
+    const backend::monotype_t& ma = static_cast<const backend::monotype_t&>(a);
+    const backend::monotype_t& mb = static_cast<const backend::monotype_t&>(b);
+    if ((ma.name() != mb.name()) || (ma.size() != mb.size())) {
+        return false;
+    }
+    for(auto i = ma.begin(), j = mb.begin(); i != ma.end(); i++, j++) {
+        if (!same_type(*i, *j)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool same_type(const type_holder* a, const type_holder* b) {
+    return same_type(*a->m_t, *b->m_t);
+}
+
 }
 
 }
@@ -1,64 +1,307 @@
 #include <cstdlib>
-#include <map>
+#include <cstddef>
+#include <list>
+#include <deque>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <stdexcept>
 #include <cassert>
 #include <prelude/runtime/mempool.hpp>
 
 namespace copperhead {
 namespace detail {
 
-// cached_allocator: a simple allocator for caching allocation
-// requests.  Adapted from thrust's custom_temporary_allocator example
+//Size classes: blocks are binned into four classes per power of two
+//(64, 80, 96, 112, 128, 160, ...), so a request is rounded up by at
+//most 25%.  Requests of slightly different sizes therefore share
+//cached blocks, instead of each requiring an exact match.
+static const std::size_t min_class_shift = 6;
+static const std::size_t sub_class_bits = 2;
+static const std::size_t n_size_classes =
+    ((sizeof(std::size_t) * 8 - min_class_shift) << sub_class_bits) + 1;
+
+inline std::size_t size_class(std::size_t num_bytes) {
+    if (num_bytes <= (std::size_t(1) << min_class_shift)) {
+        return 0;
+    }
+    std::size_t m = num_bytes - 1;
+    std::size_t msb = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(m);
+    std::size_t shift = msb - sub_class_bits;
+    std::size_t sub = (m >> shift) - (std::size_t(1) << sub_class_bits);
+    return ((msb - min_class_shift) << sub_class_bits) + sub + 1;
+}
+
+inline std::size_t class_bytes(std::size_t c) {
+    if (c == 0) {
+        return std::size_t(1) << min_class_shift;
+    }
+    std::size_t msb = ((c - 1) >> sub_class_bits) + min_class_shift;
+    std::size_t sub = (c - 1) & ((std::size_t(1) << sub_class_bits) - 1);
+    return ((std::size_t(1) << sub_class_bits) + sub + 1) <<
+        (msb - sub_class_bits);
+}
+
+//block_index: records which size class a user pointer belongs to, so
+//that deallocate can find its bin.  Only live blocks are indexed.
+//By default we keep a side table, since device memory can't be
+//dereferenced on the host.
+template<typename Tag>
+struct block_index {
+    static const std::size_t overhead = 0;
+
+    std::mutex m_mutex;
+    std::unordered_map<void*, std::size_t> m_classes;
+
+    void* insert(void* raw, std::size_t c) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_classes[raw] = c;
+        return raw;
+    }
+    std::size_t remove(void* p, void*& raw) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::unordered_map<void*, std::size_t>::iterator i = m_classes.find(p);
+        assert(i != m_classes.end());
+        std::size_t c = i->second;
+        m_classes.erase(i);
+        raw = p;
+        return c;
+    }
+    template<typename F>
+    void for_each(F f) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for(typename std::unordered_map<void*, std::size_t>::iterator i =
+                m_classes.begin();
+            i != m_classes.end();
+            ++i) {
+            f(i->first);
+        }
+        m_classes.clear();
+    }
+};
+
+//Host memory carries its size class in a header in front of the
+//block, which keeps deallocate free of any shared lookup.
+//Live blocks are also linked into one of several lists through their
+//headers, so that they can be freed at teardown.  Each list has its
+//own lock, and blocks are spread over the lists by address, so that
+//threads rarely contend for a list.
+//The header is 32 bytes to preserve malloc's alignment.
+template<>
+struct block_index<cpp_tag> {
+    struct header {
+        std::size_t m_class;
+        std::size_t m_list;
+        header* m_prev;
+        header* m_next;
+    };
+    static const std::size_t overhead = sizeof(header);
+    static const std::size_t n_lists = 16;
+
+    struct live_list {
+        std::mutex m_mutex;
+        header m_head;
+        live_list() {
+            m_head.m_prev = &m_head;
+            m_head.m_next = &m_head;
+        }
+    };
+    live_list m_lists[n_lists];
+
+    void* insert(void* raw, std::size_t c) {
+        header* h = reinterpret_cast<header*>(raw);
+        h->m_class = c;
+        h->m_list = ((reinterpret_cast<std::size_t>(raw) >> 4) *
+                     0x9e3779b97f4a7c15UL) >> 60;
+        live_list& l = m_lists[h->m_list];
+        std::lock_guard<std::mutex> guard(l.m_mutex);
+        h->m_prev = &l.m_head;
+        h->m_next = l.m_head.m_next;
+        h->m_next->m_prev = h;
+        l.m_head.m_next = h;
+        return reinterpret_cast<char*>(raw) + overhead;
+    }
+    std::size_t remove(void* p, void*& raw) {
+        raw = reinterpret_cast<char*>(p) - overhead;
+        header* h = reinterpret_cast<header*>(raw);
+        live_list& l = m_lists[h->m_list];
+        std::lock_guard<std::mutex> guard(l.m_mutex);
+        h->m_prev->m_next = h->m_next;
+        h->m_next->m_prev = h->m_prev;
+        return h->m_class;
+    }
+    //Calls f on every live block, which may free it, and forgets them
+    template<typename F>
+    void for_each(F f) {
+        for(std::size_t i = 0; i < n_lists; i++) {
+            live_list& l = m_lists[i];
+            std::lock_guard<std::mutex> guard(l.m_mutex);
+            header* h = l.m_head.m_next;
+            while(h != &l.m_head) {
+                header* next = h->m_next;
+                f(h);
+                h = next;
+            }
+            l.m_head.m_prev = &l.m_head;
+            l.m_head.m_next = &l.m_head;
+        }
+    }
+};
+
+template<typename Tag>
+struct cached_allocator;
+
+//front_cache: a small per-thread stack of free blocks for each size
+//class.  Allocation and deallocation hit this first, instead of the
+//shared free lists and their lock.  Host blocks are still linked
+//into and out of a live list of block_index under that list's lock,
+//but blocks are spread over many lists, so threads rarely contend.
+//Only blocks up to max_class are cached here, larger blocks always
+//return to the shared back end.
+//Each cache enrolls with its allocator, so that trim can reclaim the
+//blocks cached by every thread.  Its lock is only contended while
+//that happens.
+template<typename Tag>
+struct front_cache {
+    static const std::size_t depth = 4;
+    static const std::size_t max_class = 56; // 1 MB
+
+    cached_allocator<Tag>* m_owner;
+    std::mutex m_mutex;
+    void* m_blocks[max_class + 1][depth];
+    unsigned char m_count[max_class + 1];
+
+    front_cache(cached_allocator<Tag>* owner) : m_owner(owner) {
+        for(std::size_t c = 0; c <= max_class; c++) {
+            m_count[c] = 0;
+        }
+        m_owner->enroll(this);
+    }
+
+    ~front_cache() {
+        flush();
+        m_owner->withdraw(this);
+    }
+
+    void* pop(std::size_t c) {
+        if (c > max_class) {
+            return NULL;
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_count[c] == 0) {
+            return NULL;
+        }
+        return m_blocks[c][--m_count[c]];
+    }
+
+    bool push(std::size_t c, void* raw) {
+        if (c > max_class) {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_count[c] == depth) {
+            return false;
+        }
+        m_blocks[c][m_count[c]++] = raw;
+        return true;
+    }
+
+    //Return all blocks to the shared back end
+    void flush() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for(std::size_t c = 0; c <= max_class; c++) {
+            while(m_count[c] > 0) {
+                m_owner->release(c, m_blocks[c][--m_count[c]]);
+            }
+        }
+    }
+};
+
+// cached_allocator: a binned caching allocator.  Requests are rounded
+// up to a size class, and satisfied from the calling thread's
+// front_cache, then from the shared, lock protected free lists, and
+// finally from the underlying Thrust allocator.
+// Blocks in the shared free lists are also kept in least recently
+// released order, so that when the cached bytes exceed m_max_cached
+// the oldest blocks are returned to the system first.
 template<typename Tag>
 struct cached_allocator
 {
     typedef typename thrust_memory_tag<Tag>::tag thrust_tag;
+    typedef std::list<std::pair<std::size_t, void*> > lru_type;
+    typedef std::deque<typename lru_type::iterator> free_list_type;
+
     bool m_live;
-    cached_allocator() : m_live(true) {}
+    std::mutex m_mutex;
+    //Every thread's front cache.  Locked before a front cache's lock,
+    //which is locked before m_mutex.
+    std::mutex m_caches_mutex;
+    std::set<front_cache<Tag>*> m_caches;
+    lru_type m_lru;
+    free_list_type m_free[n_size_classes];
+    block_index<Tag> m_index;
+    std::size_t m_max_cached;
+    //Bytes in the shared free lists, which evict can reach.  Guarded
+    //by m_mutex.
+    std::size_t m_bytes_lru;
+
+    std::atomic<std::size_t> m_bytes_live;
+    std::atomic<std::size_t> m_bytes_cached;
+    std::atomic<std::size_t> m_high_water;
+    std::atomic<std::size_t> m_hits;
+    std::atomic<std::size_t> m_misses;
+    std::atomic<std::size_t> m_mallocs;
+
+    cached_allocator() : m_live(true),
+                         m_max_cached(std::numeric_limits<std::size_t>::max()),
+                         m_bytes_lru(0),
+                         m_bytes_live(0), m_bytes_cached(0), m_high_water(0),
+                         m_hits(0), m_misses(0), m_mallocs(0) {}
+
+    front_cache<Tag>& local() {
+        static thread_local front_cache<Tag> cache(this);
+        return cache;
+    }
+
+    void enroll(front_cache<Tag>* cache) {
+        std::lock_guard<std::mutex> guard(m_caches_mutex);
+        m_caches.insert(cache);
+    }
+
+    void withdraw(front_cache<Tag>* cache) {
+        std::lock_guard<std::mutex> guard(m_caches_mutex);
+        m_caches.erase(cache);
+    }
+
+    //Return the blocks cached by every thread to the shared back end
+    void flush_all() {
+        std::lock_guard<std::mutex> guard(m_caches_mutex);
+        for(typename std::set<front_cache<Tag>*>::iterator i =
+                m_caches.begin();
+            i != m_caches.end();
+            ++i) {
+            (*i)->flush();
+        }
+    }
 
     void *allocate(std::ptrdiff_t num_bytes)
         {
-            void *result = 0;
-            
-            // search the cache for a free block
-            free_blocks_type::iterator free_block = free_blocks.find(num_bytes);
-
-            if(free_block != free_blocks.end())
-            {
-                // get the pointer
-                result = free_block->second;
-
-                // erase from the free_blocks map
-                free_blocks.erase(free_block);
+            std::size_t c = size_class(num_bytes + block_index<Tag>::overhead);
+            std::size_t b = class_bytes(c);
+            void* raw = local().pop(c);
+            if (raw != NULL) {
+                ++m_hits;
+                m_bytes_cached -= b;
+            } else {
+                raw = acquire(c);
             }
-            else
-            {
-                // no allocation of the right size exists
-                // create a new one with cuda::malloc
-                // throw if cuda::malloc can't satisfy the request
-                try
-                {
-                    result = thrust::detail::tag_malloc(thrust_tag(),
-                                                        num_bytes);
-                }
-                catch(std::runtime_error &e)
-                {
-                    //Allocation failed
-                    //Nuke the cache and try again
-                    free_free();
-                    
-                    try {
-                        result = thrust::detail::tag_malloc(thrust_tag(),
-                                                            num_bytes);
-                    } catch(std::runtime_error &e) {
-                        throw;
-                    }
-                }
-            }
-
-            // insert the allocated pointer into the allocated_blocks map
-            allocated_blocks.insert(std::make_pair(result, num_bytes));
-
-            return result;
+            std::size_t live = (m_bytes_live += b);
+            std::size_t high = m_high_water.load();
+            while((live > high) &&
+                  !m_high_water.compare_exchange_weak(high, live));
+            return m_index.insert(raw, c);
         }
 
     void deallocate(void *ptr)
@@ -67,54 +310,122 @@ struct cached_allocator
             if (!m_live) {
                 return;
             }
-            // erase the allocated block from the allocated blocks map
-            allocated_blocks_type::iterator iter = allocated_blocks.find(ptr);
-            std::ptrdiff_t num_bytes = iter->second;
-            allocated_blocks.erase(iter);
+            void* raw;
+            std::size_t c = m_index.remove(ptr, raw);
+            std::size_t b = class_bytes(c);
+            m_bytes_live -= b;
+            m_bytes_cached += b;
+            if (!local().push(c, raw)) {
+                release(c, raw);
+            }
+        }
+
+    //Find a block in the shared free list, or make a new one
+    void* acquire(std::size_t c) {
+        std::size_t num_bytes = class_bytes(c);
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            free_list_type& bin = m_free[c];
+            if (!bin.empty()) {
+                typename lru_type::iterator i = bin.back();
+                void* result = i->second;
+                m_lru.erase(i);
+                bin.pop_back();
+                ++m_hits;
+                m_bytes_lru -= num_bytes;
+                m_bytes_cached -= num_bytes;
+                return result;
+            }
+        }
+        ++m_misses;
+        ++m_mallocs;
+        try
+        {
+            return thrust::detail::tag_malloc(thrust_tag(), num_bytes);
+        }
+        catch(std::runtime_error &e)
+        {
+            //Allocation failed
+            //Nuke the cache and try again
+            free_free();
+            ++m_mallocs;
+            return thrust::detail::tag_malloc(thrust_tag(), num_bytes);
+        }
+    }
 
-            // insert the block into the free blocks map
-            free_blocks.insert(std::make_pair(num_bytes, ptr));
+    //Return a block to the shared free list
+    void release(std::size_t c, void* raw) {
+        if (!m_live) {
+            return;
         }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_free[c].push_back(m_lru.insert(m_lru.end(), std::make_pair(c, raw)));
+        m_bytes_lru += class_bytes(c);
+        evict(m_max_cached);
+    }
 
-    void free_free() {
-        for(free_blocks_type::iterator i = free_blocks.begin();
-            i != free_blocks.end();
-            ++i) {
-            // transform the pointer to cuda::pointer before calling cuda::free
-            thrust::detail::tag_free(thrust_tag(), i->second);
+    //Free least recently released blocks until at most max_cached
+    //bytes remain in the shared free lists.  Blocks held in
+    //per-thread front caches are not visible here, so they don't
+    //count against the bound.  Must be called with m_mutex held.
+    void evict(std::size_t max_cached) {
+        while((m_bytes_lru > max_cached) && !m_lru.empty()) {
+            std::size_t c = m_lru.front().first;
+            void* raw = m_lru.front().second;
+            assert(m_free[c].front() == m_lru.begin());
+            m_free[c].pop_front();
+            m_lru.pop_front();
+            m_bytes_lru -= class_bytes(c);
+            m_bytes_cached -= class_bytes(c);
+            thrust::detail::tag_free(thrust_tag(), raw);
         }
-        free_blocks.clear();
     }
-    
+
+    void trim(std::size_t max_cached) {
+        flush_all();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_max_cached = max_cached;
+        evict(max_cached);
+    }
+
+    void free_free() {
+        flush_all();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        evict(0);
+    }
+
+    struct free_block {
+        void operator()(void* raw) const {
+            thrust::detail::tag_free(thrust_tag(), raw);
+        }
+    };
 
     void free_all()
         {
             free_free();
-            for(allocated_blocks_type::iterator i = allocated_blocks.begin();
-                i != allocated_blocks.end();
-                ++i)
-            {
-                thrust::detail::tag_free(thrust_tag(), i->first);
-            }
-            allocated_blocks.clear();
+            m_index.for_each(free_block());
         }
 
     void close() {
         free_all();
         m_live = false;
     }
-    typedef std::multimap<std::ptrdiff_t, void*> free_blocks_type;
-    typedef std::map<void *, std::ptrdiff_t>     allocated_blocks_type;
 
-    free_blocks_type      free_blocks;
-    allocated_blocks_type allocated_blocks;
+    pool_stats stats() const {
+        pool_stats result;
+        result.bytes_live = m_bytes_live;
+        result.bytes_cached = m_bytes_cached;
+        result.high_water = m_high_water;
+        result.hits = m_hits;
+        result.misses = m_misses;
+        result.mallocs = m_mallocs;
+        return result;
+    }
 };
 
 
-//XXX Need to protect access to these with mutex
 cached_allocator<cpp_tag> g_cpp_allocator;
 
-//XXX Need to protect access to these with mutex
 #ifdef CUDA_SUPPORT
 cached_allocator<cuda_tag> g_cuda_allocator;
 #endif
@@ -139,6 +450,23 @@ void free(cuda_tag, void* ptr) {
 }
 #endif
 
+pool_stats get_pool_stats(cpp_tag) {
+    return detail::g_cpp_allocator.stats();
+}
+
+#ifdef CUDA_SUPPORT
+pool_stats get_pool_stats(cuda_tag) {
+    return detail::g_cuda_allocator.stats();
+}
+#endif
+
+void pool_trim(size_t max_cached_bytes) {
+    detail::g_cpp_allocator.trim(max_cached_bytes);
+    #ifdef CUDA_SUPPORT
+    detail::g_cuda_allocator.trim(max_cached_bytes);
+    #endif
+}
+
 void take_down() {
     detail::g_cpp_allocator.close();
     #ifdef CUDA_SUPPORT
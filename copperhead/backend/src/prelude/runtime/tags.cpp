@@ -70,6 +70,10 @@ std::string detail::system_variant_to_string::operator()(const cpp_tag&) const {
     return "cpp_tag";
 }
 
+std::string detail::system_variant_to_string::operator()(const pool_tag&) const {
+    return "pool_tag";
+}
+
 #ifdef OMP_SUPPORT
 std::string detail::system_variant_to_string::operator()(const omp_tag&) const {
     return "omp_tag";
@@ -101,4 +105,8 @@ system_variant canonical_memory_tag(const system_variant& x) {
     return boost::apply_visitor(detail::canonicalize_memory_tag(), x);
 }
 
+int memory_index(const system_variant& x) {
+    return canonical_memory_tag(x).which();
+}
+
 }
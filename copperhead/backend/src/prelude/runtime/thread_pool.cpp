@@ -0,0 +1,289 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#include <prelude/runtime/thread_pool.hpp>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstdlib>
+
+namespace copperhead {
+namespace detail {
+
+//Whether the current thread is running a piece of a parallel loop
+static thread_local bool t_in_loop = false;
+
+//A participant's share of the iteration space.  The owner takes
+//pieces from the front, thieves take the back half.  Each share sits
+//on its own cache line.
+struct alignas(64) share {
+    std::atomic<bool> m_lock;
+    size_t m_begin;
+    size_t m_end;
+
+    share() : m_lock(false), m_begin(0), m_end(0) {}
+
+    void lock() {
+        while(m_lock.exchange(true, std::memory_order_acquire)) {
+            while(m_lock.load(std::memory_order_relaxed));
+        }
+    }
+    void unlock() {
+        m_lock.store(false, std::memory_order_release);
+    }
+};
+
+class thread_pool {
+    std::vector<std::thread> m_threads;
+    std::vector<share> m_shares;
+
+    //Serializes parallel loops from different threads
+    std::mutex m_launch;
+
+    //Parks idle workers
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    size_t m_parked;
+    bool m_stop;
+    std::atomic<size_t> m_epoch;
+
+    //Workers only take part in a loop while it is open, and launch
+    //waits for every worker to leave a loop before it returns, so no
+    //worker still stealing from one loop can touch the shares of the
+    //next.
+    std::atomic<bool> m_open;
+    std::atomic<size_t> m_active;
+
+    //The current loop.  m_fn and m_ctx are written before the shares
+    //are filled, and only read by a thread which has taken a piece.
+    range_fn m_fn;
+    void* m_ctx;
+    size_t m_grain;
+    std::atomic<size_t> m_remaining;
+    std::mutex m_error_mutex;
+    std::exception_ptr m_error;
+
+    //Spins this many times looking for a new loop before parking
+    static const int spin_count = 1 << 14;
+
+    void run(size_t begin, size_t end) {
+        t_in_loop = true;
+        try {
+            m_fn(m_ctx, begin, end);
+        } catch(...) {
+            std::lock_guard<std::mutex> guard(m_error_mutex);
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+        }
+        t_in_loop = false;
+        m_remaining.fetch_sub(end - begin, std::memory_order_release);
+    }
+
+    bool take(size_t id, size_t& begin, size_t& end) {
+        share& s = m_shares[id];
+        s.lock();
+        if (s.m_begin == s.m_end) {
+            s.unlock();
+            return false;
+        }
+        begin = s.m_begin;
+        end = std::min(s.m_end, begin + m_grain);
+        s.m_begin = end;
+        s.unlock();
+        return true;
+    }
+
+    bool steal(size_t id, size_t& begin, size_t& end) {
+        size_t n = m_shares.size();
+        for(size_t i = 1; i < n; i++) {
+            share& s = m_shares[(id + i) % n];
+            s.lock();
+            size_t left = s.m_end - s.m_begin;
+            if (left == 0) {
+                s.unlock();
+                continue;
+            }
+            if (left < 2 * m_grain) {
+                //Too small to split, take the last piece
+                end = s.m_end;
+                begin = end - std::min(left, m_grain);
+                s.m_end = begin;
+                s.unlock();
+                return true;
+            }
+            //Take the back half, and keep working on it locally
+            size_t mid = s.m_begin + left / 2;
+            size_t stolen_end = s.m_end;
+            s.m_end = mid;
+            s.unlock();
+            share& mine = m_shares[id];
+            mine.lock();
+            mine.m_begin = mid;
+            mine.m_end = stolen_end;
+            mine.unlock();
+            return take(id, begin, end);
+        }
+        return false;
+    }
+
+    void participate(size_t id) {
+        size_t begin, end;
+        while(take(id, begin, end) || steal(id, begin, end)) {
+            run(begin, end);
+        }
+    }
+
+    void work(size_t id) {
+        size_t seen = 0;
+        while(true) {
+            for(int i = 0;
+                (i < spin_count) &&
+                    (m_epoch.load(std::memory_order_acquire) == seen);
+                i++);
+            if (m_epoch.load(std::memory_order_acquire) == seen) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_parked++;
+                while(!m_stop && (m_epoch.load() == seen)) {
+                    m_wake.wait(lock);
+                }
+                m_parked--;
+                if (m_stop) {
+                    return;
+                }
+            }
+            seen = m_epoch.load(std::memory_order_acquire);
+            m_active.fetch_add(1);
+            if (m_open.load()) {
+                participate(id);
+            }
+            m_active.fetch_sub(1);
+        }
+    }
+
+public:
+    thread_pool(size_t n)
+        : m_shares(n), m_parked(0), m_stop(false), m_epoch(0),
+          m_open(false), m_active(0), m_fn(NULL), m_ctx(NULL), m_grain(1), m_remaining(0) {
+        for(size_t i = 1; i < n; i++) {
+            m_threads.push_back(std::thread(&thread_pool::work, this, i));
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for(size_t i = 0; i < m_threads.size(); i++) {
+            m_threads[i].join();
+        }
+    }
+
+    size_t size() const {
+        return m_shares.size();
+    }
+
+    //Returns false if the pool is busy with another loop
+    bool launch(size_t n, size_t grain, range_fn f, void* ctx) {
+        std::unique_lock<std::mutex> launch(m_launch, std::try_to_lock);
+        if (!launch.owns_lock()) {
+            return false;
+        }
+        m_fn = f;
+        m_ctx = ctx;
+        m_grain = grain;
+        m_error = std::exception_ptr();
+        m_remaining.store(n, std::memory_order_relaxed);
+        size_t p = m_shares.size();
+        for(size_t i = 0; i < p; i++) {
+            share& s = m_shares[i];
+            s.lock();
+            s.m_begin = (n * i) / p;
+            s.m_end = (n * (i + 1)) / p;
+            s.unlock();
+        }
+        m_open.store(true);
+        bool parked;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_epoch.fetch_add(1, std::memory_order_release);
+            parked = m_parked > 0;
+        }
+        if (parked) {
+            m_wake.notify_all();
+        }
+        participate(0);
+        while(m_remaining.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        //A worker which joined before the loop closed may still be
+        //looking for work
+        m_open.store(false);
+        while(m_active.load() != 0) {
+            std::this_thread::yield();
+        }
+        if (m_error) {
+            std::exception_ptr e = m_error;
+            m_error = std::exception_ptr();
+            std::rethrow_exception(e);
+        }
+        return true;
+    }
+};
+
+static size_t default_threads() {
+    const char* e = std::getenv("COPPERHEAD_POOL_THREADS");
+    if (e != NULL) {
+        long n = std::atol(e);
+        if (n > 0) {
+            return n;
+        }
+    }
+    size_t n = std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+
+static thread_pool& get_pool() {
+    static thread_pool pool(default_threads());
+    return pool;
+}
+
+}
+
+void parallel_for(size_t n, size_t grain, range_fn f, void* ctx) {
+    if (grain == 0) {
+        grain = 1;
+    }
+    if ((n <= grain) || detail::t_in_loop ||
+        (detail::get_pool().size() == 1) ||
+        !detail::get_pool().launch(n, grain, f, ctx)) {
+        if (n > 0) {
+            f(ctx, 0, n);
+        }
+    }
+}
+
+size_t pool_threads() {
+    return detail::get_pool().size();
+}
+
+}
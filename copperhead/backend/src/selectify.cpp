@@ -0,0 +1,211 @@
+#include "selectify.hpp"
+#include "utility/up_get.hpp"
+#include "utility/initializers.hpp"
+
+using std::shared_ptr;
+using std::make_shared;
+using std::static_pointer_cast;
+using std::vector;
+using std::string;
+using std::set;
+using std::map;
+using backend::utility::make_vector;
+using backend::utility::make_map;
+
+namespace backend {
+
+namespace detail {
+namespace {
+
+//Renames names according to a map
+class renamer
+    : public rewriter<renamer> {
+private:
+    const map<string, shared_ptr<const name> >& m_names;
+public:
+    renamer(const map<string, shared_ptr<const name> >& names)
+        : m_names(names) {}
+    using rewriter<renamer>::operator();
+    result_type operator()(const name& n) {
+        auto i = m_names.find(n.id());
+        if (i == m_names.end()) {
+            return n.ptr();
+        }
+        return i->second;
+    }
+};
+
+bool is_scalar(const type_t& t) {
+    static const vector<string> scalar_names =
+        make_vector<string>("Int32")("Int64")("Uint32")("Uint64")
+        ("Float32")("Float64")("Bool");
+    static const set<string> scalars(scalar_names.begin(),
+                                     scalar_names.end());
+    if (!detail::isinstance<monotype_t>(t) ||
+        detail::isinstance<sequence_t>(t)) {
+        return false;
+    }
+    return scalars.count(detail::up_get<monotype_t>(t).name()) > 0;
+}
+
+bool is_floating(const type_t& t) {
+    if (!is_scalar(t)) {
+        return false;
+    }
+    const string& id = detail::up_get<monotype_t>(t).name();
+    return (id == "Float32") || (id == "Float64");
+}
+
+//Costs of operations which are safe to evaluate speculatively.
+//Division and the math functions are only safe on floating point.
+const map<string, int>& operation_costs() {
+    static const map<string, int> costs =
+        make_map<string, int>
+        ("op_add", 1)("op_sub", 1)("op_mul", 1)
+        ("op_lshift", 1)("op_rshift", 1)
+        ("op_or", 1)("op_xor", 1)("op_and", 1)
+        ("op_band", 1)("op_bor", 1)
+        ("op_invert", 1)("op_pos", 1)("op_neg", 1)("op_not", 1)
+        ("cmp_eq", 1)("cmp_ne", 1)("cmp_lt", 1)
+        ("cmp_le", 1)("cmp_gt", 1)("cmp_ge", 1)
+        ("abs", 1)("floor", 1)("ceil", 1)
+        ("minimum", 1)("maximum", 1)("op_select", 1);
+    return costs;
+}
+
+const map<string, int>& floating_costs() {
+    static const map<string, int> costs =
+        make_map<string, int>
+        ("op_div", 4)("sqrt", 8)("exp", 8)("log", 8)
+        ("sin", 8)("cos", 8)("tan", 8)("erf", 8)
+        ("pow", 8)("atan2", 8);
+    return costs;
+}
+
+}
+}
+
+selectify::selectify(int threshold)
+    : m_threshold(threshold), m_names("sel") {}
+
+bool selectify::cost(const expression& e, int& c) const {
+    if (detail::isinstance<literal>(e) && !detail::isinstance<name>(e)) {
+        return true;
+    }
+    if (detail::isinstance<name>(e)) {
+        return detail::is_scalar(boost::get<const name&>(e).type());
+    }
+    if (!detail::isinstance<apply>(e)) {
+        return false;
+    }
+    const apply& a = boost::get<const apply&>(e);
+    //Operands are atomic after flattening.  The operators are
+    //templated on a single type, so one floating point name makes
+    //the whole operation floating point.
+    bool floating = false;
+    for(auto i = a.args().begin();
+        i != a.args().end();
+        i++) {
+        if (!detail::isinstance<literal>(*i) || !cost(*i, c)) {
+            return false;
+        }
+        if (detail::isinstance<name>(*i)) {
+            floating = floating ||
+                detail::is_floating(boost::get<const name&>(*i).type());
+        }
+    }
+    const string& fn = a.fn().id();
+    auto op = detail::operation_costs().find(fn);
+    if (op != detail::operation_costs().end()) {
+        c += op->second;
+        return true;
+    }
+    auto fop = detail::floating_costs().find(fn);
+    if (floating && (fop != detail::floating_costs().end())) {
+        c += fop->second;
+        return true;
+    }
+    return false;
+}
+
+bool selectify::straight(const suite& s,
+                         const set<string>& taken,
+                         vector<shared_ptr<const statement> >& stmts,
+                         shared_ptr<const expression>& val,
+                         int& c) {
+    map<string, shared_ptr<const name> > renames;
+    detail::renamer r(renames);
+    for(auto i = s.begin(); i != s.end(); i++) {
+        if (detail::isinstance<ret>(*i)) {
+            //The return must end the branch
+            if ((i + 1) != s.end()) {
+                return false;
+            }
+            const ret& n = boost::get<const ret&>(*i);
+            //Both sides of a select must have the same type
+            if (!detail::isinstance<name>(n.val()) || !cost(n.val(), c)) {
+                return false;
+            }
+            val = static_pointer_cast<const expression>(
+                boost::apply_visitor(r, n.val()));
+            return true;
+        }
+        if (!detail::isinstance<bind>(*i)) {
+            return false;
+        }
+        const bind& n = boost::get<const bind&>(*i);
+        if (!detail::isinstance<name>(n.lhs()) ||
+            !cost(n.lhs(), c) ||
+            !cost(n.rhs(), c)) {
+            return false;
+        }
+        const name& lhs = boost::get<const name&>(n.lhs());
+        shared_ptr<const expression> rhs =
+            static_pointer_cast<const expression>(
+                boost::apply_visitor(r, n.rhs()));
+        shared_ptr<const name> new_lhs = lhs.ptr();
+        if (taken.count(lhs.id()) > 0) {
+            new_lhs = make_shared<const name>(
+                m_names.next(), lhs.type().ptr(), lhs.ctype().ptr());
+            renames[lhs.id()] = new_lhs;
+        }
+        stmts.push_back(make_shared<const bind>(new_lhs, rhs));
+    }
+    return false;
+}
+
+selectify::result_type selectify::operator()(const conditional& n) {
+    //Lower nested conditionals first
+    result_type rewritten = rewriter<selectify>::operator()(n);
+    const conditional& c = boost::get<const conditional&>(*rewritten);
+    int c_cost = 0;
+    if (!cost(c.cond(), c_cost)) {
+        return rewritten;
+    }
+    vector<shared_ptr<const statement> > stmts;
+    shared_ptr<const expression> then_val, orelse_val;
+    int branch_cost = 0;
+    if (!straight(c.then(), set<string>(), stmts, then_val, branch_cost)) {
+        return rewritten;
+    }
+    //Both branches are hoisted into the same scope
+    set<string> taken;
+    for(auto i = stmts.begin(); i != stmts.end(); i++) {
+        taken.insert(boost::get<const name&>(
+                         boost::get<const bind&>(**i).lhs()).id());
+    }
+    if (!straight(c.orelse(), taken, stmts, orelse_val, branch_cost) ||
+        (branch_cost > m_threshold)) {
+        return rewritten;
+    }
+    stmts.push_back(
+        make_shared<const ret>(
+            make_shared<const apply>(
+                make_shared<const name>(string("op_select")),
+                make_shared<const tuple>(
+                    make_vector<shared_ptr<const expression> >
+                    (c.cond().ptr())(then_val)(orelse_val)))));
+    return make_shared<const suite>(std::move(stmts));
+}
+
+}
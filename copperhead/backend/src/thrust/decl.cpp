@@ -302,9 +302,11 @@ void declare_permutes(map<ident, fn_info>& fns,
                 make_shared<const tuple_t>(
                     make_vector<shared_ptr<const type_t> >(seq_t_a)(seq_int)),
                 seq_t_a));
+    //Sources are only read in order, so a lazily formed producer
+    //can feed permute and scatter without a phase boundary
     shared_ptr<const phase_t> permute_phase_t =
         make_shared<const phase_t>(
-            make_vector<completion>(completion::total)(completion::local),
+            make_vector<completion>(completion::local)(completion::local),
             completion::total);
     fns.insert(make_pair(
                    make_pair("permute", iteration_structure::independent),
@@ -321,7 +323,7 @@ void declare_permutes(map<ident, fn_info>& fns,
                 seq_t_a));
     shared_ptr<const phase_t> scatter_phase_t =
         make_shared<const phase_t>(
-            make_vector<completion>(completion::total)(completion::local)(completion::local),
+            make_vector<completion>(completion::local)(completion::local)(completion::local),
             completion::total);
     fns.insert(make_pair(
                    make_pair("scatter", iteration_structure::independent),
@@ -366,6 +368,63 @@ void declare_special_sequences(map<ident, fn_info>& fns,
                    make_pair("replicate", iteration_structure::independent),
                    fn_info(replicate_t, replicate_phase_t)));
     fn_includes.insert(make_pair("replicate", "prelude/primitives/replicate.h"));
+
+    shared_ptr<const monotype_t> seq_float64 =
+        make_shared<const sequence_t>(float64_mt);
+    shared_ptr<const type_t> random_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(
+                make_vector<shared_ptr<const type_t> >(int64_mt)(int64_mt)),
+            seq_float64);
+    shared_ptr<const phase_t> random_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::local)(completion::local),
+            completion::local);
+    fns.insert(make_pair(
+                   make_pair("random_uniform", iteration_structure::independent),
+                   fn_info(random_t, random_phase_t)));
+    fn_includes.insert(make_pair("random_uniform", "prelude/primitives/random.h"));
+    fns.insert(make_pair(
+                   make_pair("random_normal", iteration_structure::independent),
+                   fn_info(random_t, random_phase_t)));
+    fn_includes.insert(make_pair("random_normal", "prelude/primitives/random.h"));
+
+    //shift and rotate produce lazy views, which index their source
+    //at an offset, so the source must be totally formed
+    shared_ptr<const polytype_t> shift_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(seq_t_a)(int64_mt)(t_a)),
+                seq_t_a));
+    shared_ptr<const phase_t> shift_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::total)(completion::local)(completion::local),
+            completion::local);
+    fns.insert(make_pair(
+                   make_pair("shift", iteration_structure::independent),
+                   fn_info(shift_t, shift_phase_t)));
+    fn_includes.insert(make_pair("shift", "prelude/primitives/shift.h"));
+
+    shared_ptr<const polytype_t> rotate_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(seq_t_a)(int64_mt)),
+                seq_t_a));
+    shared_ptr<const phase_t> rotate_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::total)(completion::local),
+            completion::local);
+    fns.insert(make_pair(
+                   make_pair("rotate", iteration_structure::independent),
+                   fn_info(rotate_t, rotate_phase_t)));
+    fn_includes.insert(make_pair("rotate", "prelude/primitives/rotate.h"));
+    //Maps over shifts are rewritten into stencils by thrust_rewriter
+    fn_includes.insert(make_pair("stencil", "prelude/primitives/stencil.h"));
+    fn_includes.insert(make_pair("make_stencil_offsets", "prelude/primitives/stencil.h"));
            
 }
 
@@ -436,6 +495,56 @@ void declare_reductions(map<ident, fn_info>& fns,
                    make_pair("sum", iteration_structure::independent),
                    fn_info(sum_t, sum_phase_t)));
     fn_includes.insert(make_pair("sum", "prelude/primitives/reduce.h"));
+
+    shared_ptr<const monotype_t> t_b = make_shared<const monotype_t>("b");
+    shared_ptr<const monotype_t> seq_t_b = make_shared<const sequence_t>(t_b);
+    shared_ptr<const monotype_t> bin_fn_t_b =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(
+                make_vector<shared_ptr<const type_t> >(t_b)(t_b)),
+            t_b);
+    shared_ptr<const polytype_t> reduce_by_key_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a)(t_b),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >
+                    (bin_fn_t_b)(seq_t_a)(seq_t_b)),
+                make_shared<const sequence_t>(
+                    make_shared<const tuple_t>(
+                        make_vector<shared_ptr<const type_t> >(t_a)(t_b)))));
+    shared_ptr<const phase_t> reduce_by_key_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>
+            (completion::invariant)(completion::local)(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("reduce_by_key", iteration_structure::independent),
+                   fn_info(reduce_by_key_t, reduce_by_key_phase_t)));
+    fn_includes.insert(make_pair("reduce_by_key", "prelude/primitives/reduce_by_key.h"));
+
+    shared_ptr<const polytype_t> group_aggregate_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a)(t_b),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >
+                    (seq_t_a)(seq_t_b)),
+                make_shared<const sequence_t>(
+                    make_shared<const tuple_t>(
+                        make_vector<shared_ptr<const type_t> >
+                        (t_a)(t_b)(t_b)(t_b)(int64_mt)))));
+    //Keys are copied to be sorted, values are read in key order, so
+    //they must be complete
+    shared_ptr<const phase_t> group_aggregate_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>
+            (completion::local)(completion::total),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("group_aggregate", iteration_structure::independent),
+                   fn_info(group_aggregate_t, group_aggregate_phase_t)));
+    fn_includes.insert(make_pair("group_aggregate", "prelude/primitives/reduce_by_key.h"));
 }
 
 void declare_sorts(map<ident, fn_info>& fns,
@@ -456,14 +565,189 @@ void declare_sorts(map<ident, fn_info>& fns,
                 make_shared<const tuple_t>(
                     make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)),
                 seq_t_a));
+    //sort copies its input before sorting in place, so that copy
+    //can complete a lazily formed input
     shared_ptr<const phase_t> sort_phase_t =
         make_shared<const phase_t>(
-            make_vector<completion>(completion::invariant)(completion::total),
+            make_vector<completion>(completion::invariant)(completion::local),
             completion::total);
     fns.insert(make_pair(
                    make_pair("sort", iteration_structure::independent),
                    fn_info(sort_t, sort_phase_t)));
     fn_includes.insert(make_pair("sort", "prelude/primitives/sort.h"));
+
+    shared_ptr<const monotype_t> t_b = make_shared<const monotype_t>("b");
+    shared_ptr<const monotype_t> seq_t_b = make_shared<const sequence_t>(t_b);
+    shared_ptr<const polytype_t> sort_by_key_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a)(t_b),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)(seq_t_b)),
+                seq_t_b));
+    //Keys are copied like sort's input, values are read in sorted
+    //order, so they must be complete
+    shared_ptr<const phase_t> sort_by_key_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::local)(completion::total),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("sort_by_key", iteration_structure::independent),
+                   fn_info(sort_by_key_t, sort_by_key_phase_t)));
+    fn_includes.insert(make_pair("sort_by_key", "prelude/primitives/sort.h"));
+
+    shared_ptr<const monotype_t> seq_int = make_shared<const sequence_t>(int64_mt);
+    shared_ptr<const polytype_t> argsort_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)),
+                seq_int));
+    fns.insert(make_pair(
+                   make_pair("argsort", iteration_structure::independent),
+                   fn_info(argsort_t, sort_phase_t)));
+    fn_includes.insert(make_pair("argsort", "prelude/primitives/sort.h"));
+}
+
+void declare_merges(map<ident, fn_info>& fns,
+                    map<string, string>& fn_includes) {
+    shared_ptr<const monotype_t> t_a = make_shared<const monotype_t>("a");
+    shared_ptr<const monotype_t> t_b = make_shared<const monotype_t>("b");
+    shared_ptr<const polytype_t> cmp_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(t_a)(t_a)),
+                bool_mt));
+    shared_ptr<const monotype_t> seq_t_a = make_shared<const sequence_t>(t_a);
+    shared_ptr<const monotype_t> seq_t_b = make_shared<const sequence_t>(t_b);
+    //Merges search their inputs along each cut of the output, so
+    //their inputs must be complete
+    shared_ptr<const phase_t> merge_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::total)(completion::total),
+            completion::total);
+    shared_ptr<const polytype_t> merge_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)(seq_t_a)),
+                seq_t_a));
+    fns.insert(make_pair(
+                   make_pair("merge", iteration_structure::independent),
+                   fn_info(merge_t, merge_phase_t)));
+    fn_includes.insert(make_pair("merge", "prelude/primitives/merge.h"));
+    fns.insert(make_pair(
+                   make_pair("set_intersection", iteration_structure::independent),
+                   fn_info(merge_t, merge_phase_t)));
+    fn_includes.insert(make_pair("set_intersection", "prelude/primitives/merge.h"));
+
+    shared_ptr<const polytype_t> merge_by_key_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a)(t_b),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)(seq_t_b)(seq_t_a)(seq_t_b)),
+                seq_t_b));
+    shared_ptr<const phase_t> merge_by_key_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::total)(completion::total)(completion::total)(completion::total),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("merge_by_key", iteration_structure::independent),
+                   fn_info(merge_by_key_t, merge_by_key_phase_t)));
+    fn_includes.insert(make_pair("merge_by_key", "prelude/primitives/merge.h"));
+
+    shared_ptr<const polytype_t> sorted_join_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(cmp_t)(seq_t_a)(seq_t_a)),
+                make_shared<const sequence_t>(
+                    make_shared<const tuple_t>(
+                        make_vector<shared_ptr<const type_t> >(int64_mt)(int64_mt)))));
+    fns.insert(make_pair(
+                   make_pair("sorted_join", iteration_structure::independent),
+                   fn_info(sorted_join_t, merge_phase_t)));
+    fn_includes.insert(make_pair("sorted_join", "prelude/primitives/merge.h"));
+}
+
+void declare_searches(map<ident, fn_info>& fns,
+                      map<string, string>& fn_includes) {
+    shared_ptr<const monotype_t> t_a = make_shared<const monotype_t>("a");
+    shared_ptr<const monotype_t> seq_t_a = make_shared<const sequence_t>(t_a);
+    shared_ptr<const monotype_t> seq_int = make_shared<const sequence_t>(int64_mt);
+    shared_ptr<const polytype_t> search_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(seq_t_a)(seq_t_a)),
+                seq_int));
+    //The haystack is searched at random, and needles are checked
+    //for order and walked along merge path cuts
+    shared_ptr<const phase_t> search_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::total)(completion::total),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("lower_bound", iteration_structure::independent),
+                   fn_info(search_t, search_phase_t)));
+    fn_includes.insert(make_pair("lower_bound", "prelude/primitives/search.h"));
+    fns.insert(make_pair(
+                   make_pair("upper_bound", iteration_structure::independent),
+                   fn_info(search_t, search_phase_t)));
+    fn_includes.insert(make_pair("upper_bound", "prelude/primitives/search.h"));
+    fns.insert(make_pair(
+                   make_pair("searchsorted", iteration_structure::independent),
+                   fn_info(search_t, search_phase_t)));
+    fn_includes.insert(make_pair("searchsorted", "prelude/primitives/search.h"));
+}
+
+void declare_hashes(map<ident, fn_info>& fns,
+                    map<string, string>& fn_includes) {
+    shared_ptr<const monotype_t> t_a = make_shared<const monotype_t>("a");
+    shared_ptr<const monotype_t> seq_t_a = make_shared<const sequence_t>(t_a);
+    shared_ptr<const monotype_t> seq_int = make_shared<const sequence_t>(int64_mt);
+    shared_ptr<const polytype_t> hash_group_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(seq_t_a)),
+                seq_int));
+    //Keys are copied into the hash table's key store, which completes
+    //a lazily formed input
+    shared_ptr<const phase_t> hash_group_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("hash_group", iteration_structure::independent),
+                   fn_info(hash_group_t, hash_group_phase_t)));
+    fn_includes.insert(make_pair("hash_group", "prelude/primitives/hash.h"));
+
+    shared_ptr<const polytype_t> hash_join_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(seq_t_a)(seq_t_a)),
+                make_shared<const sequence_t>(
+                    make_shared<const tuple_t>(
+                        make_vector<shared_ptr<const type_t> >(int64_mt)(int64_mt)))));
+    shared_ptr<const phase_t> hash_join_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::local)(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("hash_join", iteration_structure::independent),
+                   fn_info(hash_join_t, hash_join_phase_t)));
+    fn_includes.insert(make_pair("hash_join", "prelude/primitives/hash.h"));
 }
 
 void declare_filter(map<ident, fn_info>& fns,
@@ -494,6 +778,90 @@ void declare_filter(map<ident, fn_info>& fns,
     fn_includes.insert(make_pair("filter", "prelude/primitives/filter.h"));
 }
 
+void declare_segmented(map<ident, fn_info>& fns,
+                       map<string, string>& fn_includes) {
+    shared_ptr<const monotype_t> t_a = make_shared<const monotype_t>("a");
+    shared_ptr<const monotype_t> seq_t_a = make_shared<const sequence_t>(t_a);
+    shared_ptr<const monotype_t> seq_seq_t_a = make_shared<const sequence_t>(seq_t_a);
+    shared_ptr<const monotype_t> bin_fn_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(
+                make_vector<shared_ptr<const type_t> >(t_a)(t_a)),
+            t_a);
+    shared_ptr<const monotype_t> t_b = make_shared<const monotype_t>("b");
+    shared_ptr<const monotype_t> seq_seq_t_b =
+        make_shared<const sequence_t>(
+            make_shared<const sequence_t>(t_b));
+    shared_ptr<const monotype_t> un_fn_t =
+        make_shared<const fn_t>(
+            make_shared<const tuple_t>(
+                make_vector<shared_ptr<const type_t> >(t_a)),
+            t_b);
+    shared_ptr<const polytype_t> seg_map_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a)(t_b),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(un_fn_t)(seq_seq_t_a)),
+                seq_seq_t_b));
+    shared_ptr<const phase_t> seg_map_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("segmented_map", iteration_structure::independent),
+                   fn_info(seg_map_t, seg_map_phase_t)));
+    fn_includes.insert(make_pair("segmented_map", "prelude/primitives/segmented.h"));
+
+    shared_ptr<const polytype_t> seg_reduce_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(bin_fn_t)(seq_seq_t_a)(t_a)),
+                seq_t_a));
+    shared_ptr<const phase_t> seg_reduce_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::local)(completion::invariant),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("segmented_reduce", iteration_structure::independent),
+                   fn_info(seg_reduce_t, seg_reduce_phase_t)));
+    fn_includes.insert(make_pair("segmented_reduce", "prelude/primitives/segmented.h"));
+
+    shared_ptr<const polytype_t> seg_scan_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(bin_fn_t)(seq_seq_t_a)),
+                seq_seq_t_a));
+    shared_ptr<const phase_t> seg_scan_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("segmented_scan", iteration_structure::independent),
+                   fn_info(seg_scan_t, seg_scan_phase_t)));
+    fn_includes.insert(make_pair("segmented_scan", "prelude/primitives/segmented.h"));
+
+    shared_ptr<const polytype_t> seg_exscan_t =
+        make_shared<const polytype_t>(
+            make_vector<shared_ptr<const monotype_t> >(t_a),
+            make_shared<const fn_t>(
+                make_shared<const tuple_t>(
+                    make_vector<shared_ptr<const type_t> >(bin_fn_t)(t_a)(seq_seq_t_a)),
+                seq_seq_t_a));
+    shared_ptr<const phase_t> seg_exscan_phase_t =
+        make_shared<const phase_t>(
+            make_vector<completion>(completion::invariant)(completion::invariant)(completion::local),
+            completion::total);
+    fns.insert(make_pair(
+                   make_pair("segmented_exclusive_scan", iteration_structure::independent),
+                   fn_info(seg_exscan_t, seg_exscan_phase_t)));
+    fn_includes.insert(make_pair("segmented_exclusive_scan", "prelude/primitives/segmented.h"));
+}
+
 }
 
 }
@@ -510,9 +878,13 @@ shared_ptr<library> get_thrust() {
     thrust::detail::declare_transforms(exported_fns, fn_includes);
     thrust::detail::declare_reductions(exported_fns, fn_includes);
     thrust::detail::declare_sorts(exported_fns, fn_includes);
+    thrust::detail::declare_hashes(exported_fns, fn_includes);
+    thrust::detail::declare_merges(exported_fns, fn_includes);
+    thrust::detail::declare_searches(exported_fns, fn_includes);
     thrust::detail::declare_zips(max_arity, exported_fns, fn_includes);
     thrust::detail::declare_unzips(max_arity, exported_fns, fn_includes);
     thrust::detail::declare_filter(exported_fns, fn_includes);
+    thrust::detail::declare_segmented(exported_fns, fn_includes);
     //XXX HACK.  NEED boost::filesystem path manipulation
     string library_path(string(detail::get_path(PRELUDE_PATH)) +
                              "/../thrust");
@@ -17,23 +17,14 @@ thrust_rewriter::thrust_rewriter(const copperhead::system_variant& target)
     : m_target(target) {}
 
 
-thrust_rewriter::result_type thrust_rewriter::map_rewrite(
-    const bind& n) {
-    //The rhs must be an apply
-    assert(detail::isinstance<apply>(n.rhs()));
-    const apply& rhs = boost::get<const apply&>(n.rhs());
-    //The rhs must apply a "map"
-    assert(rhs.fn().id().substr(0, 3) == string("map"));
-    const tuple& ap_args = rhs.args();
-    //Map must have arguments
-    assert(ap_args.begin() != ap_args.end());
-    auto init = ap_args.begin();
+shared_ptr<const ctype::type_t> thrust_rewriter::functor_ctype(
+    const expression& fn) {
     shared_ptr<const ctype::type_t> fn_t;
 
-    if (detail::isinstance<apply>(*init)) {
+    if (detail::isinstance<apply>(fn)) {
         //Function instantiation
         const apply& fn_inst = boost::get<const apply&>(
-            *init);
+            fn);
         if (detail::isinstance<templated_name>(fn_inst.fn())) {
             const templated_name& tn =
                 boost::get<const templated_name&>(fn_inst.fn());
@@ -56,10 +47,10 @@ thrust_rewriter::result_type thrust_rewriter::map_rewrite(
         }
     } else {
         //We must be dealing with a closure
-        assert(detail::isinstance<closure>(*init));
+        assert(detail::isinstance<closure>(fn));
 
         const closure& close = boost::get<const closure&>(
-            *init);
+            fn);
         stringstream ss;
         ss << "closure";
         string closure_t_name = ss.str();
@@ -119,6 +110,22 @@ thrust_rewriter::result_type thrust_rewriter::map_rewrite(
             std::move(cts),
             closure_mt);
     }
+    return fn_t;
+}
+
+thrust_rewriter::result_type thrust_rewriter::map_rewrite(
+    const bind& n) {
+    //The rhs must be an apply
+    assert(detail::isinstance<apply>(n.rhs()));
+    const apply& rhs = boost::get<const apply&>(n.rhs());
+    //The rhs must apply a "map"
+    assert(rhs.fn().id().substr(0, 3) == string("map"));
+    const tuple& ap_args = rhs.args();
+    //Map must have arguments
+    assert(ap_args.begin() != ap_args.end());
+    auto init = ap_args.begin();
+    shared_ptr<const ctype::type_t> fn_t = functor_ctype(*init);
+
     vector<shared_ptr<const ctype::type_t> > arg_types;
     for(auto i = init+1; i != ap_args.end(); i++) {
         //Assert we're looking at a name
@@ -148,6 +155,97 @@ thrust_rewriter::result_type thrust_rewriter::map_rewrite(
         
 }
 
+//A map whose sequence arguments are all the same flat sequence of
+//scalars, either directly or shifted with one common boundary value,
+//reads a fixed neighborhood of that sequence: it is a stencil.
+bool thrust_rewriter::is_stencil(const apply& rhs) {
+    const tuple& ap_args = rhs.args();
+    const name* src = NULL;
+    const string* boundary = NULL;
+    bool shifted = false;
+    for(auto i = ap_args.begin() + 1; i != ap_args.end(); i++) {
+        if (!detail::isinstance<name>(*i)) {
+            return false;
+        }
+        const name* arg_src = &boost::get<const name&>(*i);
+        auto s = m_shifts.find(arg_src->id());
+        if (s != m_shifts.end()) {
+            const shift_info& info = s->second;
+            if ((boundary != NULL) &&
+                (*boundary != info.m_boundary_value)) {
+                return false;
+            }
+            boundary = &info.m_boundary_value;
+            arg_src = info.m_src.get();
+            shifted = true;
+        }
+        if ((src != NULL) && (src->id() != arg_src->id())) {
+            return false;
+        }
+        src = arg_src;
+    }
+    if (!shifted || !detail::isinstance<sequence_t>(src->type())) {
+        return false;
+    }
+    const sequence_t& src_t = boost::get<const sequence_t&>(src->type());
+    return !detail::isinstance<sequence_t>(src_t.sub()) &&
+        !detail::isinstance<tuple_t>(src_t.sub());
+}
+
+thrust_rewriter::result_type thrust_rewriter::stencil_rewrite(
+    const bind& n) {
+    const apply& rhs = boost::get<const apply&>(n.rhs());
+    const tuple& ap_args = rhs.args();
+    auto init = ap_args.begin();
+
+    //Gather the offset of each argument
+    shared_ptr<const name> src;
+    shared_ptr<const expression> boundary;
+    vector<shared_ptr<const expression> > offsets;
+    for(auto i = init + 1; i != ap_args.end(); i++) {
+        const name& arg = boost::get<const name&>(*i);
+        auto s = m_shifts.find(arg.id());
+        if (s != m_shifts.end()) {
+            src = s->second.m_src;
+            boundary = s->second.m_boundary;
+            offsets.push_back(s->second.m_offset);
+        } else {
+            src = arg.ptr();
+            offsets.push_back(make_shared<const literal>("0", int64_mt));
+        }
+    }
+    std::size_t arity = offsets.size();
+    shared_ptr<const apply> stencil_offsets =
+        make_shared<const apply>(
+            make_shared<const name>("make_stencil_offsets"),
+            make_shared<const tuple>(std::move(offsets)));
+    shared_ptr<const apply> n_rhs =
+        make_shared<const apply>(
+            make_shared<const name>("stencil"),
+            make_shared<const tuple>(
+                make_vector<shared_ptr<const expression> >
+                (init->ptr())(src)(boundary)(stencil_offsets)));
+
+    shared_ptr<const ctype::polytype_t> stencil_t =
+        make_shared<const ctype::polytype_t>(
+            make_vector<shared_ptr<const ctype::type_t> >
+            (functor_ctype(*init))
+            (make_shared<const ctype::monotype_t>(
+                detail::typify(src->id())))
+            (make_shared<const ctype::monotype_t>(
+                std::to_string(arity))),
+            make_shared<const ctype::monotype_t>("stencil_sequence"));
+
+    //Can only handle names on the LHS
+    assert(detail::isinstance<name>(n.lhs()));
+    const name& lhs = boost::get<const name&>(n.lhs());
+    shared_ptr<const name> n_lhs =
+        make_shared<const name>(lhs.id(),
+                                lhs.type().ptr(),
+                                stencil_t);
+    return make_shared<const bind>(n_lhs, n_rhs);
+}
+
 thrust_rewriter::result_type thrust_rewriter::indices_rewrite(const bind& n) {
     //The rhs must be an apply
     assert(detail::isinstance<apply>(n.rhs()));
@@ -233,6 +331,110 @@ thrust_rewriter::result_type thrust_rewriter::replicate_rewrite(const bind& n) {
     return result;
 }
 
+thrust_rewriter::result_type thrust_rewriter::random_rewrite(const bind& n) {
+    //The rhs must be an apply
+    assert(detail::isinstance<apply>(n.rhs()));
+    const apply& rhs = boost::get<const apply&>(n.rhs());
+    const string& fn_id = rhs.fn().id();
+    const tuple& ap_args = rhs.args();
+    //random_uniform and random_normal take a seed and a length
+    assert(ap_args.end() - ap_args.begin() == 2);
+
+    //As with replicate, the sequence needs the target tag
+    auto ap_arg_iterator = ap_args.begin();
+    shared_ptr<const expression> tag_arg =
+        make_shared<const apply>(
+            make_shared<const name>(
+                copperhead::to_string(m_target)),
+            make_shared<const tuple>(
+                make_vector<shared_ptr<const expression> >()));
+    shared_ptr<const expression> arg1 = ap_arg_iterator->ptr();
+    shared_ptr<const expression> arg2 = (ap_arg_iterator+1)->ptr();
+    shared_ptr<const tuple> targeted_arguments =
+        make_shared<const tuple>(
+            make_vector<shared_ptr<const expression> >(tag_arg)(arg1)(arg2));
+
+    shared_ptr<const ctype::polytype_t> random_t =
+        make_shared<const ctype::polytype_t>(
+            make_vector<shared_ptr<const ctype::type_t> >
+            (make_shared<const ctype::monotype_t>(copperhead::to_string(m_target))),
+            make_shared<const ctype::monotype_t>(fn_id + "_sequence"));
+
+    shared_ptr<const apply> n_rhs =
+        make_shared<const apply>(rhs.fn().ptr(),
+                                 targeted_arguments);
+
+    //Can only handle names on the LHS
+    assert(detail::isinstance<name>(n.lhs()));
+    const name& lhs = boost::get<const name&>(n.lhs());
+    shared_ptr<const name> n_lhs =
+        make_shared<const name>(lhs.id(),
+                                lhs.type().ptr(),
+                                random_t);
+    auto result = make_shared<const bind>(n_lhs, n_rhs);
+    return result;
+}
+
+thrust_rewriter::result_type thrust_rewriter::shift_rewrite(const bind& n) {
+    //The rhs must be an apply
+    assert(detail::isinstance<apply>(n.rhs()));
+    const apply& rhs = boost::get<const apply&>(n.rhs());
+    const tuple& ap_args = rhs.args();
+    //shift and rotate must have a source
+    assert(ap_args.begin() != ap_args.end());
+    //The source must be a name
+    assert(detail::isinstance<name>(*ap_args.begin()));
+    const name& src = boost::get<const name&>(*ap_args.begin());
+
+    //Remember shifts with a literal boundary, for is_stencil.
+    //The frontend casts literal boundaries to the element type of the
+    //source, binding each cast to its own name, so look through those.
+    if ((rhs.fn().id() == "shift") &&
+        (ap_args.end() - ap_args.begin() == 3)) {
+        const expression& boundary = *(ap_args.begin() + 2);
+        const string* value = NULL;
+        //Names are literals too, so check for them first
+        if (detail::isinstance<name>(boundary)) {
+            auto c = m_literal_casts.find(
+                boost::get<const name&>(boundary).id());
+            if ((c != m_literal_casts.end()) &&
+                (c->second.m_seq == src.id())) {
+                value = &c->second.m_value;
+            }
+        } else if (detail::isinstance<literal>(boundary)) {
+            value = &boost::get<const literal&>(boundary).id();
+        }
+        if (value != NULL) {
+            assert(detail::isinstance<name>(n.lhs()));
+            shift_info info;
+            info.m_src = src.ptr();
+            info.m_offset = (ap_args.begin() + 1)->ptr();
+            info.m_boundary = boundary.ptr();
+            info.m_boundary_value = *value;
+            m_shifts[boost::get<const name&>(n.lhs()).id()] = info;
+        }
+    }
+
+    //shift produces a shifted_sequence, rotate a rotated_sequence
+    string seq_id =
+        (rhs.fn().id() == "shift") ? "shifted_sequence" : "rotated_sequence";
+    shared_ptr<const ctype::polytype_t> view_t =
+        make_shared<const ctype::polytype_t>(
+            make_vector<shared_ptr<const ctype::type_t> >
+            (make_shared<const ctype::monotype_t>(
+                detail::typify(src.id()))),
+            make_shared<const ctype::monotype_t>(seq_id));
+
+    //Can only handle names on the LHS
+    assert(detail::isinstance<name>(n.lhs()));
+    const name& lhs = boost::get<const name&>(n.lhs());
+    shared_ptr<const name> n_lhs =
+        make_shared<const name>(lhs.id(),
+                                lhs.type().ptr(),
+                                view_t);
+    return make_shared<const bind>(n_lhs, rhs.ptr());
+}
+
 thrust_rewriter::result_type thrust_rewriter::zip_rewrite(const bind& n) {
     //The rhs must be an apply
     assert(detail::isinstance<apply>(n.rhs()));
@@ -303,6 +505,18 @@ thrust_rewriter::result_type thrust_rewriter::make_tuple_rewrite(const bind& n)
 }
 
 
+thrust_rewriter::result_type thrust_rewriter::operator()(const procedure& n) {
+    //Shifts are only visible within their own procedure
+    std::map<string, shift_info> outer_shifts;
+    std::map<string, literal_cast> outer_casts;
+    std::swap(m_shifts, outer_shifts);
+    std::swap(m_literal_casts, outer_casts);
+    result_type result = rewriter<thrust_rewriter>::operator()(n);
+    std::swap(m_shifts, outer_shifts);
+    std::swap(m_literal_casts, outer_casts);
+    return result;
+}
+
 thrust_rewriter::result_type thrust_rewriter::operator()(const bind& n) {
     const expression& rhs = n.rhs();
     if (!detail::isinstance<apply>(rhs)) {
@@ -312,6 +526,9 @@ thrust_rewriter::result_type thrust_rewriter::operator()(const bind& n) {
     const name& fn_name = rhs_apply.fn();
     const string& fn_id = fn_name.id();
     if (fn_id.substr(0, 3) == "map") {
+        if (is_stencil(rhs_apply)) {
+            return stencil_rewrite(n);
+        }
         return map_rewrite(n);
     } else if(fn_id.substr(0, 3) == "zip") {
         return zip_rewrite(n);
@@ -319,8 +536,26 @@ thrust_rewriter::result_type thrust_rewriter::operator()(const bind& n) {
         return indices_rewrite(n);
     } else if (fn_id == "replicate") {
         return replicate_rewrite(n);
+    } else if ((fn_id == "random_uniform") || (fn_id == "random_normal")) {
+        return random_rewrite(n);
+    } else if ((fn_id == "shift") || (fn_id == "rotate")) {
+        return shift_rewrite(n);
     } else if (fn_id == detail::snippet_make_tuple()) {
         return make_tuple_rewrite(n);
+    } else if (fn_id == "cast_to_el") {
+        //Remember literals cast for a shift boundary
+        const tuple& ap_args = rhs_apply.args();
+        if ((ap_args.end() - ap_args.begin() == 2) &&
+            detail::isinstance<literal>(*ap_args.begin()) &&
+            !detail::isinstance<name>(*ap_args.begin()) &&
+            detail::isinstance<name>(*(ap_args.begin() + 1)) &&
+            detail::isinstance<name>(n.lhs())) {
+            literal_cast c;
+            c.m_value = boost::get<const literal&>(*ap_args.begin()).id();
+            c.m_seq = boost::get<const name&>(*(ap_args.begin() + 1)).id();
+            m_literal_casts[boost::get<const name&>(n.lhs()).id()] = c;
+        }
+        return n.ptr();
     } else {
         return n.ptr();
     }
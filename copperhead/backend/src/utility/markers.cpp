@@ -27,5 +27,9 @@ std::string complete(const std::string &in) {
     return "comp" + in;
 }
 
+std::string out_array_id() {
+    return "ary_out";
+}
+
 }
 }
@@ -31,6 +31,14 @@ const std::string phase_boundary() {
     return "phase_boundary";
 }
 
+const std::string release() {
+    return "release";
+}
+
+const std::string deliver() {
+    return "deliver";
+}
+
 const std::string snippet_get(int x) {
     std::ostringstream os;
     os << "thrust::get";
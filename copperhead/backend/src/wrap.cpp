@@ -19,7 +19,8 @@ wrap::wrap(const copperhead::system_variant& target,
            const string& entry_point)
     : m_target(target),
       m_entry_point(entry_point),
-      m_wrapping(false) {}
+      m_wrapping(false),
+      m_out(false) {}
 
 
 wrap::result_type wrap::operator()(const procedure &n) {
@@ -127,6 +128,15 @@ wrap::result_type wrap::operator()(const procedure &n) {
                 
             p_c_res_t = make_shared<const ctype::cuarray_t>(
                 sub_res_t);
+            //Accept a container from the caller for the result
+            const fn_t& previous_t = boost::get<const fn_t&>(n.type());
+            new_args.push_back(
+                make_shared<const name>(
+                    detail::out_array_id(),
+                    previous_t.result().ptr(),
+                    p_c_res_t));
+            new_arg_p_cts.push_back(p_c_res_t);
+            m_out = true;
         } else {
             p_c_res_t = previous_c_res_t.ptr();
         }
@@ -146,6 +156,7 @@ wrap::result_type wrap::operator()(const procedure &n) {
                     boost::apply_visitor(*this, *i)));
         }
         m_wrapping = false;
+        m_out = false;
         
         return make_shared<const procedure>(
             n.id().ptr(),
@@ -171,7 +182,24 @@ wrap::result_type wrap::operator()(const ret& n) {
                     detail::wrap_array_id(val.id()),
                     val.type().ptr(),
                     val.ctype().ptr());
-            return result_type(new ret(array_wrapped));
+            if (!m_out) {
+                return result_type(new ret(array_wrapped));
+            }
+            //Hand the result to the caller's container, if any
+            shared_ptr<const apply> target =
+                make_shared<const apply>(
+                    make_shared<const name>(copperhead::to_string(m_target)),
+                    make_shared<const tuple>(
+                        make_vector<shared_ptr<const expression> >()));
+            shared_ptr<const apply> delivered =
+                make_shared<const apply>(
+                    make_shared<const name>(detail::deliver()),
+                    make_shared<const tuple>(
+                        make_vector<shared_ptr<const expression> >
+                        (array_wrapped)
+                        (make_shared<const name>(detail::out_array_id()))
+                        (target)));
+            return result_type(new ret(delivered));
         }
     }
     shared_ptr<const ret> rewritten =
@@ -41,13 +41,26 @@ def prepare_compilation(M):
             return prepare_cuda_compilation(M)
     return prepare_host_compilation(M)
 
+def python_def(procedure_name, wrap_name, wrap_args):
+    """Export the wrapper to Python.
+
+    Wrappers whose last argument is the container for the result
+    accept it as the optional keyword argument out."""
+    if not wrap_args or wrap_args[-1][1] != 'ary_out':
+        return 'boost::python::def("%s", &%s)' % (procedure_name, wrap_name)
+    keywords = ['boost::python::arg("arg%s")' % i
+                for i in range(len(wrap_args) - 1)]
+    keywords.append('boost::python::arg("out") = boost::python::object()')
+    return 'boost::python::def("%s", &%s, (%s))' % (
+        procedure_name, wrap_name, ', '.join(keywords))
+
 def prepare_cuda_compilation(M):
     assert(len(M.entry_points) == 1)
     procedure_name = M.entry_points[0]
     hash, (wrap_type, wrap_name), wrap_args = M.wrap_info
     wrap_decl = CG.FunctionDeclaration(CG.Value(wrap_type, wrap_name),
                                        [CG.Value(x, y) for x, y in wrap_args])
-    host_module = codepy.bpl.BoostPythonModule(max_arity=max(10,M.arity),
+    host_module = codepy.bpl.BoostPythonModule(max_arity=max(10,M.arity+1),
                                                use_private_namespace=False)
     host_module.add_to_preamble([
         CG.Include("prelude/runtime/cunp.hpp"),
@@ -61,8 +74,7 @@ def prepare_cuda_compilation(M):
                                  hash_namespace_close, using_declaration])
 
     host_module.add_to_init([CG.Statement(
-                "boost::python::def(\"%s\", &%s)" % (
-                    procedure_name, wrap_name))])
+                python_def(procedure_name, wrap_name, wrap_args))])
 
     device_module.add_to_preamble(
         [CG.Include("prelude/prelude.h"),
@@ -91,7 +103,7 @@ def prepare_host_compilation(M):
     assert(len(M.entry_points) == 1)
     procedure_name = M.entry_points[0]
     hash, (wrap_type, wrap_name), wrap_args = M.wrap_info
-    host_module = codepy.bpl.BoostPythonModule(max_arity=max(10,M.arity),
+    host_module = codepy.bpl.BoostPythonModule(max_arity=max(10,M.arity+1),
                                                use_private_namespace=False)
     host_module.add_to_preamble([CG.Include("prelude/prelude.h"),
                                  CG.Include("prelude/runtime/cunp.hpp"),
@@ -101,8 +113,7 @@ def prepare_host_compilation(M):
                                  CG.Line('using namespace copperhead;')])
 
     host_module.add_to_init([CG.Statement(
-                "boost::python::def(\"%s\", &%s)" % (
-                    procedure_name, wrap_name))])
+                python_def(procedure_name, wrap_name, wrap_args))])
     wrapped_code = [CG.Line(M.compiler_output),
                     CG.Line('using namespace %s;' % hash)]
     host_module.add_to_module(wrapped_code)
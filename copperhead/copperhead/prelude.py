@@ -44,6 +44,7 @@ import __builtin__
 from decorators import cutype
 import copperhead.runtime.places as PL
 
+import bisect
 import math
 import numpy as np
 
@@ -142,6 +143,42 @@ def sum(sequence):
     """
     return __builtin__.sum(sequence)
 
+@cutype("((b,b)->b, [a], [b]) -> [(a, b)]")
+def reduce_by_key(fn, keys, values):
+    """
+    Reduces the values of each run of consecutive equal keys with fn.
+    Returns a (key, reduction) pair for each run.
+
+        >>> reduce_by_key(op_add, [1, 1, 2, 1], [1, 2, 3, 4])
+        [(1, 3), (2, 3), (1, 4)]
+    """
+    result = []
+    for k, v in __builtin__.zip(keys, values):
+        if result and result[-1][0] == k:
+            result[-1] = (k, fn(result[-1][1], v))
+        else:
+            result.append((k, v))
+    return result
+
+@cutype("([a], [b]) -> [(a, b, b, b, Long)]")
+def group_aggregate(keys, values):
+    """
+    Groups values by key.  Returns a (key, sum, minimum, maximum,
+    count) tuple for each distinct key, in ascending order of keys.
+
+        >>> group_aggregate([2, 1, 2], [1.0, 5.0, 3.0])
+        [(1, 5.0, 5.0, 5.0, 1), (2, 4.0, 1.0, 3.0, 2)]
+    """
+    groups = {}
+    for k, v in __builtin__.zip(keys, values):
+        if k in groups:
+            s, lo, hi, n = groups[k]
+            groups[k] = (s + v, __builtin__.min(lo, v),
+                         __builtin__.max(hi, v), n + 1)
+        else:
+            groups[k] = (v, v, v, 1)
+    return [(k,) + groups[k] for k in sorted(groups.keys())]
+
 @cutype("[a] -> a")
 @_wraps(__builtin__.min)
 def min(sequence):
@@ -387,6 +424,51 @@ def exclusive_rscan(f, suffix, A):
     """
     return rscan(f, A[1:]+[suffix])
 
+@cutype("((a)->b, [[a]]) -> [[b]]")
+def segmented_map(f, A):
+    """
+    Apply f to every element of each subsequence of A.
+    Equivalent to map(lambda a: map(f, a), A), but parallel over all
+    elements of A.
+
+    >>> segmented_map(lambda x: x+1, [[1, 2], [], [3]])
+    [[2, 3], [], [4]]
+    """
+    return [map(f, a) for a in A]
+
+@cutype("((a,a)->a, [[a]], a) -> [a]")
+def segmented_reduce(f, A, prefix):
+    """
+    Reduce each subsequence of A with f, starting from prefix.
+    The work is spread over all elements of A, rather than over its
+    subsequences, so uneven subsequence lengths are handled well.
+
+    >>> segmented_reduce(lambda x,y: x+y, [[1, 2], [], [3, 4, 5]], 0)
+    [3, 0, 12]
+    """
+    return [reduce(f, a, prefix) for a in A]
+
+@cutype("((a,a)->a, [[a]]) -> [[a]]")
+def segmented_scan(f, A):
+    """
+    Inclusive prefix scan of f over each subsequence of A.
+
+    >>> segmented_scan(lambda x,y: x+y, [[1, 1, 1], [], [2, 2]])
+    [[1, 2, 3], [], [2, 4]]
+    """
+    return [scan(f, a) for a in A]
+
+@cutype("((a,a)->a, a, [[a]]) -> [[a]]")
+def segmented_exclusive_scan(f, prefix, A):
+    """
+    Exclusive prefix scan of f over each subsequence of A.
+
+    >>> segmented_exclusive_scan(lambda x,y: x+y, 0, [[1, 1, 1], [], [2, 2]])
+    [[0, 1, 2], [], [0, 2]]
+    """
+    return [exclusive_scan(f, prefix, list(a)) if len(a) else []
+            for a in A]
+
 
 
 @cutype("[a] -> [Long]")
@@ -433,6 +515,54 @@ def bounded_range(a, b):
 
     return range(a, b)
 
+def _philox(seed, counter):
+    """
+    Philox4x32-10 counter based generator, returning four arrays of
+    32 bit words.  This mirrors prelude/sequences/random_sequence.h.
+    """
+    mask = np.uint64(0xFFFFFFFF)
+    k0 = np.uint64(seed & 0xFFFFFFFF)
+    k1 = np.uint64((seed >> 32) & 0xFFFFFFFF)
+    v0 = counter & mask
+    v1 = counter >> np.uint64(32)
+    v2 = np.zeros_like(counter)
+    v3 = np.zeros_like(counter)
+    for r in __builtin__.range(10):
+        p0 = np.uint64(0xD2511F53) * v0
+        p1 = np.uint64(0xCD9E8D57) * v2
+        v0, v1, v2, v3 = ((p1 >> np.uint64(32)) ^ v1 ^ k0, p1 & mask,
+                          (p0 >> np.uint64(32)) ^ v3 ^ k1, p0 & mask)
+        k0 = (k0 + np.uint64(0x9E3779B9)) & mask
+        k1 = (k1 + np.uint64(0xBB67AE85)) & mask
+    return v0, v1, v2, v3
+
+def _philox_uniform(hi, lo):
+    x = (hi << np.uint64(32)) | lo
+    return (x >> np.uint64(11)).astype(np.float64) * (1.0 / 2**53)
+
+@cutype("(Long, Long) -> [Double]")
+def random_uniform(seed, n):
+    """
+    Returns a sequence of n pseudorandom numbers, uniformly
+    distributed in [0, 1).  Element i depends only on seed and i, so
+    the sequence is the same on every platform, however it is
+    partitioned.
+    """
+    v = _philox(seed, np.arange(n, dtype=np.uint64))
+    return list(_philox_uniform(v[0], v[1]))
+
+@cutype("(Long, Long) -> [Double]")
+def random_normal(seed, n):
+    """
+    Returns a sequence of n pseudorandom numbers, normally distributed
+    with mean 0 and variance 1.  As with random_uniform, element i
+    depends only on seed and i.
+    """
+    v = _philox(seed, np.arange(n, dtype=np.uint64))
+    u0 = 1.0 - _philox_uniform(v[0], v[1])
+    u1 = _philox_uniform(v[2], v[3])
+    return list(np.sqrt(-2.0 * np.log(u0)) * np.cos(6.283185307179586 * u1))
+
 def unzip(seq):
     """
     Inverse of zip.  Converts a list of tuples into a tuple of lists.
@@ -449,11 +579,14 @@ def shift(src, offset, default):
     It is shifted by offset elements, and default will be
     shifted in to fill the empty spaces.
     """
-    u, v = split_at(src, offset)
-    if offset < 0:
-        return join([replicate(default, -offset), u])
-    else:
-        return join([v, replicate(default, offset)])
+    n = len(src)
+    def el(i):
+        j = i + offset
+        if j < 0 or j >= n:
+            return default
+        else:
+            return src[j]
+    return [el(i) for i in __builtin__.range(n)]
 
 @cutype("([a], b) -> [a]")
 def rotate(src, offset):
@@ -461,8 +594,10 @@ def rotate(src, offset):
     Returns a sequence which is a rotated version of src.
     It is rotated by offset elements.
     """
-    u, v = split_at(src, offset)
-    return join([v, u])
+    n = len(src)
+    if n == 0:
+        return []
+    return [src[(i + offset) % n] for i in __builtin__.range(n)]
     
 
 @cutype("((a, a)->Bool, [a]) -> [a]")
@@ -478,6 +613,170 @@ def sort(fn, x):
             return 0
     return sorted(x, cmp=my_cmp)
 
+@cutype("((a, a)->Bool, [a]) -> [Long]")
+def argsort(fn, x):
+    """
+    Returns the indices which sort `x` by `fn`, so that
+    gather(x, argsort(fn, x)) equals sort(fn, x).  Elements which
+    compare equal keep their order.
+    """
+    def my_cmp(i, j):
+        if fn(x[i], x[j]):
+            return -1
+        elif fn(x[j], x[i]):
+            return 1
+        else:
+            return 0
+    return sorted(__builtin__.range(len(x)), cmp=my_cmp)
+
+@cutype("((a, a)->Bool, [a], [b]) -> [b]")
+def sort_by_key(fn, keys, values):
+    """
+    Returns `values`, permuted into the order which sorts `keys` by
+    `fn`.  Values with keys which compare equal keep their order.
+    """
+    return [values[i] for i in argsort(fn, keys)]
+
+@cutype("[a] -> [Long]")
+def hash_group(x):
+    """
+    Numbers the distinct elements of `x` densely, in order of their
+    first occurrence, and returns the number of each element.
+
+        >>> hash_group([7, 3, 7, 9, 3])
+        [0, 1, 0, 2, 1]
+    """
+    groups = {}
+    result = []
+    for xi in x:
+        if xi not in groups:
+            groups[xi] = len(groups)
+        result.append(groups[xi])
+    return result
+
+@cutype("([a], [a]) -> [(Long, Long)]")
+def hash_join(left, right):
+    """
+    Returns the index pairs (i, j) for which left[i] equals right[j],
+    ordered by i and then by j.
+
+        >>> hash_join([1, 2, 3], [3, 1, 1])
+        [(0, 1), (0, 2), (2, 0)]
+    """
+    rows = {}
+    for j, rj in enumerate(right):
+        rows.setdefault(rj, []).append(j)
+    return [(i, j) for i, li in enumerate(left) for j in rows.get(li, [])]
+
+@cutype("((a, a) -> Bool, [a], [b], [a], [b]) -> [b]")
+def merge_by_key(fn, keys_a, values_a, keys_b, values_b):
+    """
+    Merges `keys_a` and `keys_b`, which are sorted by `fn`, and returns
+    `values_a` and `values_b` in merged order.  Values of `keys_a` go
+    before values of equal keys of `keys_b`.
+
+        >>> merge_by_key(cmp_lt, [1, 3], ['a', 'c'], [1, 2], ['x', 'y'])
+        ['a', 'x', 'y', 'c']
+    """
+    result = []
+    i = j = 0
+    while i < len(keys_a) and j < len(keys_b):
+        if fn(keys_b[j], keys_a[i]):
+            result.append(values_b[j])
+            j += 1
+        else:
+            result.append(values_a[i])
+            i += 1
+    return result + list(values_a[i:]) + list(values_b[j:])
+
+@cutype("((a, a) -> Bool, [a], [a]) -> [a]")
+def merge(fn, a, b):
+    """
+    Merges `a` and `b`, which are sorted by `fn`.  Elements of `a` go
+    before equal elements of `b`.
+
+        >>> merge(cmp_lt, [1, 4, 6], [2, 4, 5])
+        [1, 2, 4, 4, 5, 6]
+    """
+    return merge_by_key(fn, a, a, b, b)
+
+@cutype("((a, a) -> Bool, [a], [a]) -> [a]")
+def set_intersection(fn, a, b):
+    """
+    Returns the elements of `a` matched by equal elements of `b`, where
+    `a` and `b` are sorted by `fn`.  An element occurring m times in
+    `a` and n times in `b` is kept min(m, n) times.
+
+        >>> set_intersection(cmp_lt, [1, 2, 2, 2, 5], [2, 2, 3, 5])
+        [2, 2, 5]
+    """
+    result = []
+    i = j = 0
+    while i < len(a) and j < len(b):
+        if fn(a[i], b[j]):
+            i += 1
+        elif fn(b[j], a[i]):
+            j += 1
+        else:
+            result.append(a[i])
+            i += 1
+            j += 1
+    return result
+
+@cutype("((a, a) -> Bool, [a], [a]) -> [(Long, Long)]")
+def sorted_join(fn, left, right):
+    """
+    Returns the index pairs (i, j) for which left[i] equals right[j],
+    where `left` and `right` are sorted by `fn`, ordered by i and then
+    by j.
+
+        >>> sorted_join(cmp_lt, [1, 2, 2], [2, 2, 3])
+        [(1, 0), (1, 1), (2, 0), (2, 1)]
+    """
+    result = []
+    lo = 0
+    for i, li in enumerate(left):
+        while lo < len(right) and fn(right[lo], li):
+            lo += 1
+        hi = lo
+        while hi < len(right) and not fn(li, right[hi]):
+            hi += 1
+        result.extend((i, j) for j in __builtin__.range(lo, hi))
+    return result
+
+@cutype("([a], [a]) -> [Long]")
+def lower_bound(haystack, needles):
+    """
+    Returns, for each needle, the first position in `haystack`, which
+    is sorted in ascending order, whose element is not less than the
+    needle.
+
+        >>> lower_bound([1, 3, 3, 7], [0, 3, 4, 9])
+        [0, 1, 3, 4]
+    """
+    return [bisect.bisect_left(haystack, x) for x in needles]
+
+@cutype("([a], [a]) -> [Long]")
+def upper_bound(haystack, needles):
+    """
+    Returns, for each needle, the first position in `haystack`, which
+    is sorted in ascending order, whose element is greater than the
+    needle.
+
+        >>> upper_bound([1, 3, 3, 7], [0, 3, 4, 9])
+        [0, 3, 3, 4]
+    """
+    return [bisect.bisect_right(haystack, x) for x in needles]
+
+@cutype("([a], [a]) -> [Long]")
+def searchsorted(haystack, needles):
+    """
+    Returns the positions at which `needles` would be inserted into
+    `haystack` to keep it sorted, as numpy's searchsorted does.
+    Needles equal to elements of `haystack` go before them.
+    """
+    return lower_bound(haystack, needles)
+
 
 ########################################################################
 #
@@ -503,6 +802,56 @@ def exp(x):
 @_wraps(np.log)
 def log(x):
     return np.log(x)
+
+@cutype("a -> a")
+@_wraps(np.sin)
+def sin(x):
+    return np.sin(x)
+
+@cutype("a -> a")
+@_wraps(np.cos)
+def cos(x):
+    return np.cos(x)
+
+@cutype("a -> a")
+@_wraps(np.tan)
+def tan(x):
+    return np.tan(x)
+
+@cutype("a -> a")
+@_wraps(math.erf)
+def erf(x):
+    return type(x)(math.erf(x))
+
+@cutype("a -> a")
+@_wraps(np.floor)
+def floor(x):
+    return np.floor(x)
+
+@cutype("a -> a")
+@_wraps(np.ceil)
+def ceil(x):
+    return np.ceil(x)
+
+@cutype("(a, a) -> a")
+@_wraps(np.power)
+def pow(x, y):
+    return np.power(x, y)
+
+@cutype("(a, a) -> a")
+@_wraps(np.arctan2)
+def atan2(x, y):
+    return np.arctan2(x, y)
+
+@cutype("(a, a) -> a")
+@_wraps(np.minimum)
+def minimum(x, y):
+    return np.minimum(x, y)
+
+@cutype("(a, a) -> a")
+@_wraps(np.maximum)
+def maximum(x, y):
+    return np.maximum(x, y)
     
 ########################################################################
 #
@@ -75,26 +75,6 @@ def max(x):
             return b
     return reduce(max_el, x, x[0])
 
-@cu
-def shift(x, a, d):
-    def shift_el(i):
-        i = i + a
-        if i < 0 or i >= len(x):
-            return d
-        else:
-            return x[i]
-    return map(shift_el, indices(x))
-
-@cu
-def rotate(x, a):
-    def torus_index(i, a, b):
-        return (i + a) % b
-        
-    def rotate_el(i):
-        return x[torus_index(i, a, len(x))]
-
-    return map(rotate_el, indices(x))
-
 @cu
 def bounded_range(a, b):
     length = b - a
@@ -53,6 +53,9 @@ cudata = find_module(cur_dir, 'cudata')
 #Register libcopperhead destructor
 import atexit
 atexit.register(cudata.take_down)
+#Finish queued asynchronous calls and join the worker thread first
+#(atexit runs in reverse order)
+atexit.register(cudata.shutdown)
 
 try:
     cuda_utils = find_module(cur_dir, 'cuda_utils')
@@ -71,6 +74,9 @@ import null_toolchain
 
 import driver
 places.sequential = driver.Sequential()
+places.pool = driver.Pool()
+places.pool_async = driver.Async(places.pool)
+pool_tag = tags.pool
 
 if cuda_support:
     places.gpu0 = driver.DefaultCuda()
@@ -84,12 +90,14 @@ if omp_support:
     omp_tag = tags.omp
     if places.default_place == places.sequential:
         places.default_place = places.openmp
+    places.openmp_async = driver.Async(places.openmp)
     
 if tbb_support:
     places.tbb = driver.TBB()
     tbb_tag = tags.tbb
     if places.default_place == places.sequential:
         places.default_place = places.tbb
+    places.tbb_async = driver.Async(places.tbb)
 
 import codepy.toolchain
 host_toolchain = codepy.toolchain.guess_toolchain()
@@ -101,6 +109,9 @@ def add_defines(toolchain):
         toolchain.defines.append('OMP_SUPPORT')
     if tbb_support:
         toolchain.defines.append('TBB_SUPPORT')
+    #Compare against the thrust::copy path for maps
+    if os.environ.get('COPPERHEAD_NO_SIMD'):
+        toolchain.defines.append('COPPERHEAD_NO_SIMD')
 
 add_defines(host_toolchain)
 
@@ -213,7 +224,7 @@ if tbb_support:
 #This is used to detect whether a binary has already been compiled
 null_host_toolchain = null_toolchain.make_null_toolchain(host_toolchain)
 
-backends = [places.sequential]
+backends = [places.sequential, places.pool]
 if cuda_support:
     backends.append(places.gpu0)
 if omp_support:
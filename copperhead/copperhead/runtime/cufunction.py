@@ -50,8 +50,12 @@ class CuFunction:
         self.syntax_tree = stmts
         # Establish code directory
         self.code_dir = self.get_code_dir()
-        self.cache = self.get_cache()
+        # Generated source for each compiled signature
         self.code = {}
+        self.cache = self.get_cache()
+        # Native dispatcher over compiled entry points, created by the
+        # driver on first use
+        self.dispatcher = None
         
     def __call__(self, *args, **kwargs):
         P = kwargs.pop('target_place', places.default_place)
@@ -163,6 +167,7 @@ class CuFunction:
                                                 compile=False)
                     signature = ','.join([str(tag)]+[str(x) for x in input_type])
                     cache[signature] = compiled_fn
+                    self.code[signature] = code
 
                 except:
                     # We don't process exceptions at this point
@@ -56,6 +56,36 @@ if omp_support:
         def execute(self, cufn, args, kwargs):
             return execute(self.tag(), cufn, *args, **kwargs)
 
+class Pool(places.Place):
+    """Runs on the runtime's persistent thread pool.  Workers park
+    between primitives, so launching one is cheaper than forking an
+    OpenMP team, which matters most for short sequences."""
+    def __str__(self):
+        return "Pool"
+    def __repr__(self):
+        return str(self)
+    def tag(self):
+        return tags.pool
+    def execute(self, cufn, args, kwargs):
+        return execute(self.tag(), cufn, *args, **kwargs)
+
+class Async(places.Place):
+    """Runs calls asynchronously on the runtime's worker thread, at
+    another place.  Calls return a future at once.  Inputs which
+    borrow the storage of numpy arrays are copied when the call is
+    queued, so the caller may change those arrays afterwards."""
+    def __init__(self, place):
+        places.Place.__init__(self)
+        self.place = place
+    def __str__(self):
+        return "Async(%s)" % self.place
+    def __repr__(self):
+        return str(self)
+    def tag(self):
+        return self.place.tag()
+    def execute(self, cufn, args, kwargs):
+        return submit(self.tag(), cufn, *args, **kwargs)
+
 if tbb_support:
     class TBB(places.Place):
         def __str__(self):
@@ -102,9 +132,47 @@ def induct(x):
     #Can't digest this input
     raise ValueError("This input is not convertible to a Copperhead data structure: %r" % x)
     
+def invoke(fn, inputs, out):
+    """Call a compiled function, passing along the result container"""
+    if out is None:
+        return fn(*inputs)
+    return fn(*inputs, out=out)
+
+def check_out(out, v):
+    """Validate the container provided for the result of a call"""
+    from . import cudata
+    if out is not None:
+        if not isinstance(out, cudata.cuarray):
+            raise TypeError("out must be a cuarray")
+        if any(out is x for x in v):
+            raise ValueError("out must not be an input of the function")
+
+def get_dispatcher(cufn):
+    from . import cudata
+    if cufn.dispatcher is None:
+        cufn.dispatcher = cudata.dispatcher()
+    return cufn.dispatcher
+
 def execute(tag, cufn, *v, **k):
-    """Call Copperhead function. Invokes compilation if necessary"""
+    """Call Copperhead function. Invokes compilation if necessary
+
+    If the keyword argument out is a cuarray, a sequence result is
+    written into it and out is returned, rather than a new cuarray.
+    """
+    out = k.pop('out', None)
+    check_out(out, v)
+    #Fast path: the dispatcher classifies the inputs and calls the
+    #compiled function for their signature without leaving C++
+    result = get_dispatcher(cufn)(tag, v, out)
+    if result is not None:
+        return result
+    compiled_fn, cu_inputs = prepare(tag, cufn, v, k)
+    return invoke(compiled_fn, cu_inputs, out)
 
+def prepare(tag, cufn, v, k):
+    """Find the compiled function for these inputs, compiling it if
+    necessary.  Returns the function and the converted inputs."""
+    dispatcher = get_dispatcher(cufn)
     if len(v) == 0:
         #Functions which take no arguments
         cu_types, cu_inputs = ((),())
@@ -114,7 +182,8 @@ def execute(tag, cufn, *v, **k):
     signature = ','.join([str(tag)]+[str(x) for x in cu_types])
     #Have we executed this function before, in which case it is loaded in cache?
     if signature in cufn.cache:
-        return cufn.cache[signature](*cu_inputs)
+        dispatcher.insert(tag, v, cufn.cache[signature])
+        return cufn.cache[signature], cu_inputs
 
     #XXX can't we get rid of this circular dependency?
     from . import toolchains
@@ -131,5 +200,21 @@ def execute(tag, cufn, *v, **k):
                                 **k)
     #Store the binary and the compilation result
     cufn.cache[signature] = compiled_fn
-    #Call the function
-    return compiled_fn(*cu_inputs)
+    cufn.code[signature] = code
+    dispatcher.insert(tag, v, compiled_fn)
+    return compiled_fn, cu_inputs
+
+def submit(tag, cufn, *v, **k):
+    """Queue a call of a Copperhead function on the runtime's worker
+    thread, compiling it first if necessary.  Returns a future.
+
+    The cuarrays the call uses, including out, may be passed on at
+    once: anything which reads them waits for the call to finish."""
+    from . import cudata
+    out = k.pop('out', None)
+    check_out(out, v)
+    found = get_dispatcher(cufn).lookup(tag, v)
+    if found is None:
+        found = prepare(tag, cufn, v, k)
+    compiled_fn, cu_inputs = found
+    return cudata.submit(compiled_fn, tuple(cu_inputs), out)
@@ -4,21 +4,28 @@ import copperhead.compiler.coretypes as T
 from copperhead.compiler.conversions import back_to_front_type
 
 
-def to_numpy(ary):
+def to_numpy(ary, copy=True):
+    """Convert a cuarray to numpy.
+
+    A flat sequence of scalars becomes a single array.  A sequence of
+    sequences of scalars becomes a pair (offsets, values), where
+    element i is values[offsets[i]:offsets[i+1]].  With copy=False,
+    the results are read-only views of the cuarray's host data.  A
+    cuarray still borrowing the storage of the array it was made from
+    is copied anyway, since writing to it releases that storage."""
+    from . import cudata
     front_type = back_to_front_type(ary.type)
     if not isinstance(front_type, T.Seq):
         raise ValueError("Not convertible to numpy")
+    if not copy and cudata.borrowed(ary):
+        copy = True
     sub = front_type.unbox()
-    if str(sub) == str(T.Int):
-        return np.fromiter(ary, dtype=np.int32, count=-1)
-    elif str(sub) == str(T.Long):
-        return np.fromiter(ary, dtype=np.int64, count=-1)
-    elif str(sub) == str(T.Float):
-        return np.fromiter(ary, dtype=np.float32, count=-1)
-    elif str(sub) == str(T.Double):
-        return np.fromiter(ary, dtype=np.float64, count=-1)
-    elif str(sub) == str(T.Bool):
-        return np.fromiter(ary, dtype=np.bool, count=-1)
-    else:
+    if isinstance(sub, T.Seq):
+        offsets, values = cudata.nested_views(ary)
+        if copy:
+            return (np.array(offsets), np.array(values))
+        return (offsets, values)
+    if str(sub) not in (str(T.Int), str(T.Long), str(T.Float),
+                        str(T.Double), str(T.Bool)):
         raise ValueError("Not convertible to numpy")
-    
+    return np.array(ary, copy=copy)
@@ -45,6 +45,9 @@ class PythonInterpreter(Place):
 
     def execute(self, cufn, args, kwargs):
         fn = cufn.python_function()
+        #The interpreter always builds a new result
+        kwargs = dict(kwargs)
+        kwargs.pop('out', None)
         return fn(*args, **kwargs)
 
 here = PythonInterpreter()
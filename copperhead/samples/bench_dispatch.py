@@ -0,0 +1,37 @@
+from copperhead import *
+import numpy as np
+import timeit
+
+@cu
+def axpy(a, x, y):
+    return map(lambda xi, yi: a * xi + yi, x, y)
+
+iters = 100000
+s = 16
+t = np.float32
+a = t(2.0)
+x = cuarray(np.arange(s, dtype=t))
+y = cuarray(np.ones(s, dtype=t))
+p = runtime.places.sequential
+
+with p:
+    #Compile, and warm up the memory pool
+    r = axpy(a, x, y, out=axpy(a, x, y))
+
+compiled = axpy.cache.values()[0]
+
+def test_call():
+    for i in xrange(iters):
+        axpy(a, x, y, out=r, target_place=p)
+
+def test_compiled():
+    for i in xrange(iters):
+        compiled(a, x, y, out=r)
+
+call = timeit.timeit('test_call()', setup='from __main__ import test_call', number=1)
+body = timeit.timeit('test_compiled()', setup='from __main__ import test_compiled', number=1)
+
+print('Per call latency: %.2f us' % (call / iters * 1.0e6))
+print('Compiled function alone: %.2f us' % (body / iters * 1.0e6))
+print('Dispatch overhead: %.2f us' % ((call - body) / iters * 1.0e6))
+print('Dispatcher hits: %s, misses: %s' % (axpy.dispatcher.hits, axpy.dispatcher.misses))
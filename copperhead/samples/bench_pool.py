@@ -0,0 +1,37 @@
+from copperhead import *
+import numpy as np
+import timeit
+
+@cu
+def axpy(a, x, y):
+    return map(lambda xi, yi: a * xi + yi, x, y)
+
+@cu
+def dot(x, y):
+    return sum(map(lambda xi, yi: xi * yi, x, y))
+
+t = np.float32
+a = t(2.0)
+places = [runtime.places.sequential, runtime.places.pool]
+if runtime.omp_support:
+    places.append(runtime.places.openmp)
+
+print('%8s %12s %12s %12s' % ('size', 'place', 'axpy (us)', 'dot (us)'))
+for s in [1000, 10000, 100000, 1000000]:
+    iters = max(10, 10000000 / s)
+    x = cuarray(np.arange(s, dtype=t))
+    y = cuarray(np.ones(s, dtype=t))
+    for p in places:
+        #Compile, and warm up the memory pool
+        r = axpy(a, x, y, target_place=p)
+        dot(x, y, target_place=p)
+        def test_axpy():
+            for i in xrange(iters):
+                axpy(a, x, y, out=r, target_place=p)
+        def test_dot():
+            for i in xrange(iters):
+                dot(x, y, target_place=p)
+        m = timeit.timeit(test_axpy, number=1)
+        d = timeit.timeit(test_dot, number=1)
+        print('%8d %12s %12.2f %12.2f' % (s, p, m / iters * 1.0e6,
+                                          d / iters * 1.0e6))
@@ -0,0 +1,52 @@
+#Compares the vectorized path for completing maps on host places with
+#the thrust::copy path, which is selected by setting COPPERHEAD_NO_SIMD.
+#Run without arguments to benchmark both paths.
+import os
+import subprocess
+import sys
+
+if len(sys.argv) < 2:
+    for path, env in [('simd', {}), ('copy', {'COPPERHEAD_NO_SIMD' : '1'})]:
+        env.update(os.environ)
+        print('*** %s path' % path)
+        sys.stdout.flush()
+        subprocess.check_call([sys.executable, __file__, path], env=env)
+    sys.exit(0)
+
+from copperhead import *
+import numpy as np
+import timeit
+
+from axpy import axpy
+from black_scholes import black_scholes, rand_floats
+
+places = [runtime.places.sequential, runtime.places.pool]
+if runtime.omp_support:
+    places.append(runtime.places.openmp)
+
+def bandwidth(fn, args, n_bytes, p):
+    #Compile, and warm up the memory pool
+    fn(*args, target_place=p)
+    iters = 20
+    t = timeit.timeit(lambda: fn(*args, target_place=p), number=iters)
+    return n_bytes * iters / t / 1.0e9
+
+print('%10s %12s %14s %20s' % ('size', 'place', 'axpy (GB/s)',
+                               'black_scholes (GB/s)'))
+for n in [100000, 1000000, 10000000]:
+    t = np.float32
+    a = t(0.5)
+    x = cuarray(np.arange(n, dtype=t))
+    y = cuarray(np.ones(n, dtype=t))
+    S = rand_floats(n, 5, 30)
+    X = rand_floats(n, 1, 100)
+    T = rand_floats(n, .25, 10)
+    R = t(.02)
+    V = t(.3)
+    item = np.dtype(t).itemsize
+    for p in places:
+        #axpy reads two sequences and writes one, black_scholes reads
+        #three and writes two
+        axpy_bw = bandwidth(axpy, (a, x, y), 3 * n * item, p)
+        bs_bw = bandwidth(black_scholes, (S, X, T, R, V), 5 * n * item, p)
+        print('%10d %12s %14.2f %20.2f' % (n, p, axpy_bw, bs_bw))
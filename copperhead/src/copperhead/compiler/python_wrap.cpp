@@ -79,6 +79,21 @@ python_wrap::result_type python_wrap::operator()(const procedure &n) {
 
         }
 
+        //Release the GIL while the body runs.  Python objects are not
+        //touched again until the result is packed.  The containers of
+        //sequence arguments are pinned by the wrapper's parameters,
+        //so no Python object can be freed without the GIL.
+        stmts.push_back(
+            make_shared<const bind>(
+                make_shared<const name>(
+                    string("gil_guard"),
+                    void_mt,
+                    make_shared<const ctype::monotype_t>("gil_release")),
+                make_shared<const apply>(
+                    make_shared<const name>(string("release_gil")),
+                    make_shared<const tuple>(
+                        make_vector<shared_ptr<const expression> >()))));
+
         //Type must be a fn type
         assert(detail::isinstance<fn_t>(n.type()));
         const fn_t &proc_t = boost::get<const fn_t &>(n.type());
@@ -129,12 +144,22 @@ python_wrap::result_type python_wrap::operator()(const ret& n) {
             pack_function = make_shared<const name>("make_scalar");
         }
         
-        return make_shared<const ret>(
+        //Retake the GIL before building Python objects
+        shared_ptr<const call> acquire =
+            make_shared<const call>(
+                make_shared<const apply>(
+                    make_shared<const name>(string("acquire_gil")),
+                    make_shared<const tuple>(
+                        make_vector<shared_ptr<const expression> >(
+                            make_shared<const name>(string("gil_guard"))))));
+        shared_ptr<const ret> packed = make_shared<const ret>(
             make_shared<const apply>(
                 pack_function,
                 make_shared<const tuple>(
                     make_vector<shared_ptr<const expression> >(
                         n.val().ptr()))));
+        return make_shared<const suite>(
+            make_vector<shared_ptr<const statement> >(acquire)(packed));
     } else {
         return this->rewriter::operator()(n);
     }
@@ -42,7 +42,8 @@ namespace backend {
   containers that are held by the broader context of the program,
   whereas the rest of the program operates solely on views.  This pass
   adds a wrapper which operates on containers, derives views, and then
-  calls the body of the entry point.
+  calls the body of the entry point.  The GIL is released while the
+  body runs, and retaken before the result is packed.
   
 */
 class python_wrap
@@ -6,6 +6,8 @@
 #include <prelude/runtime/mempool.hpp>
 #include "cunp.hpp"
 #include "np_inspect.hpp"
+#include "dispatch.hpp"
+#include "worker.hpp"
 #include "type.hpp"
 #include "monotype.hpp"
 #include "type_printer.hpp"
@@ -40,6 +42,16 @@ bool isinstance(PyObject* in) {
         return false;
     }
 }
+
+//Releases a Python object which keeps borrowed storage alive.
+//Chunks may drop their owner on any thread, with or without the GIL.
+struct release_with_gil {
+    void operator()(boost::python::object* o) const {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        delete o;
+        PyGILState_Release(gil);
+    }
+};
 }
 
 void desc_lens(PyObject* in, vector<size_t>& lens,
@@ -201,6 +213,23 @@ sp_cuarray make_cuarray_PyObject(PyObject* in) {
 
     sp_cuarray result(
         new cuarray(th));
+
+    //Flat arrays borrow the numpy data, which inspect_array has already
+    //made contiguous and aligned, instead of copying it.
+    //The chunk keeps the numpy array alive and copies it on write.
+    if ((depth == 0) && (lens[0] > 0)) {
+        const np_array_info& leaf = leaves[0];
+        boost::shared_ptr<void> owner(
+            new boost::python::object(std::get<3>(leaf)),
+            detail::release_with_gil());
+        result->add_chunk(boost::shared_ptr<chunk>(new chunk(cpp_tag(), el_size * lens[0], std::get<0>(leaf), owner)), true);
+#ifdef CUDA_SUPPORT
+        result->add_chunk(boost::shared_ptr<chunk>(new chunk(cuda_tag(), el_size * lens[0])), false);
+#endif
+        result->m_l = lens;
+        return result;
+    }
+    
     //Allocate descriptors
     for(int i = 0; i < depth; i++) {
         result->add_chunk(boost::shared_ptr<chunk>(new chunk(cpp_tag(), sizeof(size_t) * lens[i])), true);
@@ -538,6 +567,85 @@ string str_cuarray(sp_cuarray& in) {
     return os.str();
 }
 
+const char* typestr(shared_ptr<const backend::type_t> t) {
+    static const int probe = 1;
+    const bool little = *reinterpret_cast<const char*>(&probe) == 1;
+    if (t == backend::int32_mt) {
+        return little ? "<i4" : ">i4";
+    } else if (t == backend::int64_mt) {
+        return little ? "<i8" : ">i8";
+    } else if (t == backend::float32_mt) {
+        return little ? "<f4" : ">f4";
+    } else if (t == backend::float64_mt) {
+        return little ? "<f8" : ">f8";
+    } else if (t == backend::bool_mt) {
+        return "|b1";
+    }
+    return NULL;
+}
+
+//Exposes the host copy of a flat sequence of scalars to numpy
+//without copying. Other sequences don't provide the interface, so
+//numpy falls back to iterating over them.
+boost::python::dict array_interface(sp_cuarray& in) {
+    shared_ptr<const backend::sequence_t> seq_t = static_pointer_cast<const backend::sequence_t>(in->m_t->m_t);
+    shared_ptr<const backend::type_t> sub_t = seq_t->sub().ptr();
+    const char* ts = typestr(sub_t);
+    if (ts == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "__array_interface__");
+        boost::python::throw_error_already_set();
+    }
+    size_t el_size = get_el_size(sub_t);
+    //Make the host copy coherent
+    std::vector<boost::shared_ptr<chunk> >& local_chunks = in->get_chunks(cpp_tag(), false);
+    char* data = (char*)local_chunks[0]->ptr() + in->m_o * el_size;
+    
+    boost::python::dict result;
+    result["version"] = 3;
+    result["shape"] = boost::python::make_tuple(in->size());
+    result["typestr"] = ts;
+    result["data"] = boost::python::make_tuple((size_t)data, true);
+    return result;
+}
+
+//Returns read-only numpy views (offsets, values) of a sequence of
+//sequences of scalars. Element i is values[offsets[i]:offsets[i+1]].
+boost::python::tuple nested_views(sp_cuarray& in) {
+    shared_ptr<const backend::sequence_t> seq_t = static_pointer_cast<const backend::sequence_t>(in->m_t->m_t);
+    shared_ptr<const backend::type_t> sub_t = seq_t->sub().ptr();
+    if ((in->m_l.size() != 2) ||
+        !backend::detail::isinstance<backend::sequence_t>(*sub_t)) {
+        throw std::invalid_argument("Not convertible to numpy");
+    }
+    shared_ptr<const backend::type_t> el_t =
+        static_pointer_cast<const backend::sequence_t>(sub_t)->sub().ptr();
+    if (typestr(el_t) == NULL) {
+        throw std::invalid_argument("Not convertible to numpy");
+    }
+    std::vector<boost::shared_ptr<chunk> >& local_chunks = in->get_chunks(cpp_tag(), false);
+    size_t* desc = (size_t*)local_chunks[0]->ptr() + in->m_o;
+    boost::python::object base(in);
+    boost::python::object offsets(boost::python::handle<>(
+        make_array_view(desc, in->m_l[0], backend::int64_mt, base.ptr())));
+    boost::python::object values(boost::python::handle<>(
+        make_array_view(local_chunks[1]->ptr(), in->m_l[1], el_t, base.ptr())));
+    return boost::python::make_tuple(offsets, values);
+}
+
+//Does the host copy of in borrow storage from another owner, which
+//a later write would release?
+bool borrowed(sp_cuarray& in) {
+    std::vector<boost::shared_ptr<chunk> >& local_chunks = in->get_chunks(cpp_tag(), false);
+    for(std::vector<boost::shared_ptr<chunk> >::iterator i = local_chunks.begin();
+        i != local_chunks.end();
+        i++) {
+        if ((*i)->borrowed()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool clean(cuarray& in, boost::python::object place) {
     boost::python::object bpo_tag = place.attr("tag")();
     //Extra parentheses here are for C++11/boost::variant WAR needed
@@ -556,15 +664,43 @@ void cuarray_copy(cuarray& in, boost::python::object place, bool invalidate) {
 }
 
 sp_cuarray force(sp_cuarray &in, boost::python::object place) {
+    //Waits for pending calls using this array, then makes it valid
+    //at place
+    in->sync();
     cuarray_copy(*in, place, false);
-    //XXX What we really need here is an event system
-    //This is much too big a hammer
 #ifdef CUDA_SUPPORT
-    cudaThreadSynchronize();
+    //XXX Kernels are tracked by the device, not by our events,
+    //so a device wide barrier is still needed for GPU places
+    boost::python::object bpo_tag = place.attr("tag")();
+    copperhead::system_variant tag =
+        boost::python::extract<copperhead::system_variant>(bpo_tag)();
+    if (memory_index(tag) == memory_index(cuda_tag())) {
+        cudaThreadSynchronize();
+    }
 #endif
     return in;
 }
 
+boost::python::dict pool_stats_dict(const pool_stats& s) {
+    boost::python::dict result;
+    result["bytes_live"] = s.bytes_live;
+    result["bytes_cached"] = s.bytes_cached;
+    result["high_water"] = s.high_water;
+    result["hits"] = s.hits;
+    result["misses"] = s.misses;
+    result["mallocs"] = s.mallocs;
+    return result;
+}
+
+boost::python::dict pool_stats() {
+    boost::python::dict result;
+    result[to_string(cpp_tag())] = pool_stats_dict(get_pool_stats(cpp_tag()));
+#ifdef CUDA_SUPPORT
+    result[to_string(cuda_tag())] = pool_stats_dict(get_pool_stats(cuda_tag()));
+#endif
+    return result;
+}
+
 }
 
 BOOST_PYTHON_MODULE(cudata) {
@@ -577,6 +713,7 @@ BOOST_PYTHON_MODULE(cudata) {
         .def("__getitem__", &getitem_idx)
         //.def("__setitem__", &setitem_idx)
         .add_property("type", type_derive)
+        .add_property("__array_interface__", array_interface)
         .def("__iter__", make_iterator);
     
     class_<cuarray_iterator, shared_ptr<cuarray_iterator> >
@@ -584,5 +721,11 @@ BOOST_PYTHON_MODULE(cudata) {
         .def("next", &cuarray_iterator::next)
         ;
     def("take_down", &take_down);
+    def("pool_stats", &pool_stats);
+    def("pool_trim", &pool_trim);
     def("force", &force);
+    def("nested_views", &nested_views);
+    def("borrowed", &borrowed);
+    export_dispatcher();
+    export_worker();
 }
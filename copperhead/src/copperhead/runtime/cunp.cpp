@@ -38,6 +38,21 @@ shared_ptr<const type_t> np_to_cu(NPY_TYPES n) {
     }
 }
 
+NPY_TYPES cu_to_np(const shared_ptr<const type_t>& t) {
+    if (t == bool_mt) {
+        return NPY_BOOL;
+    } else if (t == int32_mt) {
+        return NPY_INT;
+    } else if (t == int64_mt) {
+        return NPY_LONG;
+    } else if (t == float32_mt) {
+        return NPY_FLOAT;
+    } else if (t == float64_mt) {
+        return NPY_DOUBLE;
+    }
+    throw std::invalid_argument("Not convertible to numpy");
+}
+
 bool isnumpyarray(PyObject* in) {
     return PyArray_Check(in);
 }
@@ -71,6 +86,46 @@ np_array_info inspect_array(PyObject* in) {
     return make_tuple(d, n, make_shared<const sequence_t>(t), bp_object);
 }
 
+PyObject* make_array_view(void* d, size_t n,
+                          const shared_ptr<const type_t>& t,
+                          PyObject* base) {
+    npy_intp dims[1] = {npy_intp(n)};
+    PyObject* result = PyArray_New(&PyArray_Type, 1, dims, cu_to_np(t),
+                                   NULL, d, 0, NPY_CARRAY_RO, NULL);
+    if (result == NULL) {
+        boost::python::throw_error_already_set();
+    }
+    //The view keeps base alive. PyArray_SetBaseObject steals a reference
+    Py_INCREF(base);
+    PyArray_SetBaseObject((PyArrayObject*)result, base);
+    return result;
+}
+
+PyObject* pack_scalar(PyObject* in, shared_ptr<const type_t>& t) {
+    if (PyArray_IsScalar(in, Bool)) {
+        t = bool_mt;
+    } else if (PyArray_IsScalar(in, Int)) {
+        t = int32_mt;
+    } else if (PyArray_IsScalar(in, Long)) {
+        t = int64_mt;
+    } else if (PyArray_IsScalar(in, Float)) {
+        t = float32_mt;
+    } else if (PyArray_IsScalar(in, Double)) {
+        t = float64_mt;
+    } else if (PyFloat_Check(in)) {
+        //Python floats are double precision
+        t = float64_mt;
+        return make_scalar(double(PyFloat_AS_DOUBLE(in)));
+    } else if (PyInt_Check(in)) {
+        //Python ints and bools are 64-bit ints, following numpy
+        t = int64_mt;
+        return make_scalar(long(PyInt_AS_LONG(in)));
+    } else {
+        return NULL;
+    }
+    Py_INCREF(in);
+    return in;
+}
 
 //Instantiate scalar packings
 PyObject* make_scalar(const float& s) {
@@ -133,3 +188,25 @@ copperhead::sp_cuarray unpack_array(PyObject* a) {
 PyObject* objectify(const copperhead::sp_cuarray& s) {
     return boost::python::converter::shared_ptr_to_python(s);
 }
+
+namespace {
+struct restore_thread {
+    void operator()(void* s) const {
+        PyEval_RestoreThread(reinterpret_cast<PyThreadState*>(s));
+    }
+};
+}
+
+gil_release::gil_release(PyThreadState* s) : m_state(s, restore_thread()) {}
+
+void gil_release::acquire() {
+    m_state.reset();
+}
+
+gil_release release_gil() {
+    return gil_release(PyEval_SaveThread());
+}
+
+void acquire_gil(gil_release& g) {
+    g.acquire();
+}
@@ -27,6 +27,7 @@
 
 #include <Python.h>
 #include <prelude/runtime/cuarray.hpp>
+#include <boost/shared_ptr.hpp>
 
 extern "C" {
 void initialize_cunp();
@@ -46,3 +47,16 @@ long unpack_scalar_long(PyObject* s);
 float unpack_scalar_float(PyObject* s);
 double unpack_scalar_double(PyObject* s);
 copperhead::sp_cuarray unpack_array(PyObject* s);
+
+//Holds the GIL released while a compiled function body runs, so
+//other Python threads make progress.  The GIL is retaken when the
+//last copy is destroyed, or earlier by acquire_gil.
+class gil_release {
+    boost::shared_ptr<void> m_state;
+public:
+    explicit gil_release(PyThreadState* s);
+    void acquire();
+};
+
+gil_release release_gil();
+void acquire_gil(gil_release& g);
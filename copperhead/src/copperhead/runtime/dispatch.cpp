@@ -0,0 +1,130 @@
+#include "dispatch.hpp"
+#include "np_inspect.hpp"
+#include "type_printer.hpp"
+#include <prelude/runtime/type_holder.hpp>
+#include <sstream>
+#include <stdexcept>
+
+using std::shared_ptr;
+using std::string;
+using std::ostringstream;
+
+namespace copperhead {
+
+dispatcher::dispatcher() : m_hits(0), m_misses(0) {}
+
+bool dispatcher::classify(const system_variant& t,
+                          const boost::python::tuple& args,
+                          string& signature,
+                          boost::python::list& inputs) const {
+    ostringstream os;
+    backend::repr_type_printer tp(os);
+    os << t.which();
+    Py_ssize_t n = PyTuple_GET_SIZE(args.ptr());
+    for(Py_ssize_t i = 0; i < n; i++) {
+        PyObject* arg = PyTuple_GET_ITEM(args.ptr(), i);
+        os << ",";
+        boost::python::extract<sp_cuarray> as_cuarray(arg);
+        if (as_cuarray.check()) {
+            sp_cuarray c = as_cuarray();
+            boost::apply_visitor(tp, *(c->m_t->m_t));
+            inputs.append(boost::python::object(boost::python::borrowed(arg)));
+            continue;
+        }
+        if (isnumpyarray(arg)) {
+            sp_cuarray c;
+            try {
+                c = make_cuarray_PyObject(arg);
+            } catch(std::invalid_argument&) {
+                return false;
+            }
+            boost::apply_visitor(tp, *(c->m_t->m_t));
+            inputs.append(c);
+            continue;
+        }
+        shared_ptr<const backend::type_t> scalar_t;
+        PyObject* scalar = pack_scalar(arg, scalar_t);
+        if (scalar == NULL) {
+            return false;
+        }
+        boost::apply_visitor(tp, *scalar_t);
+        inputs.append(boost::python::object(boost::python::handle<>(scalar)));
+    }
+    signature = os.str();
+    return true;
+}
+
+boost::python::object dispatcher::lookup(const system_variant& t,
+                                         const boost::python::tuple& args) {
+    string signature;
+    boost::python::list inputs;
+    cache_type::iterator i = m_cache.end();
+    if (classify(t, args, signature, inputs)) {
+        i = m_cache.find(signature);
+    }
+    if (i == m_cache.end()) {
+        m_misses++;
+        return boost::python::object();
+    }
+    m_hits++;
+    return boost::python::make_tuple(i->second,
+                                     boost::python::tuple(inputs));
+}
+
+boost::python::object dispatcher::call(const system_variant& t,
+                                       const boost::python::tuple& args,
+                                       const boost::python::object& out) {
+    boost::python::object found = lookup(t, args);
+    if (found.ptr() == Py_None) {
+        return found;
+    }
+    boost::python::dict keywords;
+    if (out.ptr() != Py_None) {
+        keywords["out"] = out;
+    }
+    PyObject* result = PyObject_Call(
+        PyTuple_GET_ITEM(found.ptr(), 0),
+        PyTuple_GET_ITEM(found.ptr(), 1),
+        keywords.ptr());
+    if (result == NULL) {
+        boost::python::throw_error_already_set();
+    }
+    return boost::python::object(boost::python::handle<>(result));
+}
+
+void dispatcher::insert(const system_variant& t,
+                        const boost::python::tuple& args,
+                        const boost::python::object& fn) {
+    string signature;
+    boost::python::list inputs;
+    if (classify(t, args, signature, inputs)) {
+        m_cache[signature] = fn;
+    }
+}
+
+size_t dispatcher::hits() const {
+    return m_hits;
+}
+
+size_t dispatcher::misses() const {
+    return m_misses;
+}
+
+size_t dispatcher::size() const {
+    return m_cache.size();
+}
+
+void export_dispatcher() {
+    using namespace boost::python;
+    class_<dispatcher, boost::shared_ptr<dispatcher>, boost::noncopyable>
+        ("dispatcher")
+        .def("__call__", &dispatcher::call)
+        .def("lookup", &dispatcher::lookup)
+        .def("insert", &dispatcher::insert)
+        .def("__len__", &dispatcher::size)
+        .add_property("hits", &dispatcher::hits)
+        .add_property("misses", &dispatcher::misses)
+        ;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <boost/python.hpp>
+#include <prelude/runtime/cuarray.hpp>
+#include <prelude/runtime/tags.h>
+#include <string>
+#include <unordered_map>
+
+namespace copperhead {
+
+//Defined in cudata.cpp
+sp_cuarray make_cuarray_PyObject(PyObject* in);
+
+//! Finds and calls compiled entry points without leaving C++
+/*! Each entry point compiled for a Copperhead function is cached
+  under its signature: the target system, and the types of the
+  arguments it was compiled for.  Calling the dispatcher classifies
+  the arguments, converting numpy arrays and Python scalars as the
+  driver would, and calls the entry point for their signature, if
+  there is one.  Arguments which aren't classified here, such as
+  lists and tuples, always miss, and are left to the driver.
+*/
+class dispatcher {
+private:
+    typedef std::unordered_map<std::string, boost::python::object> cache_type;
+    cache_type m_cache;
+    size_t m_hits;
+    size_t m_misses;
+    //Computes the signature of args, and the inputs to pass to an
+    //entry point.  Returns false if an argument can't be classified.
+    bool classify(const system_variant& t,
+                  const boost::python::tuple& args,
+                  std::string& signature,
+                  boost::python::list& inputs) const;
+public:
+    dispatcher();
+    //Finds the entry point for args, and the inputs to pass it.
+    //Returns (fn, inputs), or None if there is no entry point.
+    boost::python::object lookup(const system_variant& t,
+                                 const boost::python::tuple& args);
+    //Calls the entry point for args, or returns None if there is none
+    boost::python::object call(const system_variant& t,
+                               const boost::python::tuple& args,
+                               const boost::python::object& out);
+    //Records the entry point compiled for args
+    void insert(const system_variant& t,
+                const boost::python::tuple& args,
+                const boost::python::object& fn);
+    size_t hits() const;
+    size_t misses() const;
+    size_t size() const;
+};
+
+//Exposes the dispatcher to Python
+void export_dispatcher();
+
+}
@@ -24,3 +24,12 @@ typedef std::tuple<void*, size_t, std::shared_ptr<const backend::type_t>, boost:
 np_array_info inspect_array(PyObject* in);
 bool isnumpyarray(PyObject* in);
 boost::python::object convert_to_array(PyObject* in);
+//Makes a read-only, one dimensional numpy view of n elements of type t
+//at d. The view holds a reference to base, which must own d.
+PyObject* make_array_view(void* d, size_t n,
+                          const std::shared_ptr<const backend::type_t>& t,
+                          PyObject* base);
+//Converts a Python or numpy scalar to the numpy scalar which compiled
+//functions accept, and sets t to its Copperhead type.  Returns a new
+//reference, or NULL if in is not such a scalar.
+PyObject* pack_scalar(PyObject* in, std::shared_ptr<const backend::type_t>& t);
@@ -37,6 +37,8 @@ namespace detail {
 
 boost::shared_ptr<copperhead::system_variant> cpp_tag(
     new copperhead::system_variant(copperhead::cpp_tag()));
+boost::shared_ptr<copperhead::system_variant> pool_tag(
+    new copperhead::system_variant(copperhead::pool_tag()));
 #ifdef CUDA_SUPPORT
 boost::shared_ptr<copperhead::system_variant> cuda_tag(
     new copperhead::system_variant(copperhead::cuda_tag()));
@@ -66,6 +68,9 @@ boost::shared_ptr<copperhead::system_variant> system_variant_from_int(int i) {
         return tbb_tag;
     }
 #endif
+    if (i == 4) {
+        return pool_tag;
+    }
     return cpp_tag;
 }
 
@@ -74,6 +79,9 @@ struct system_variant_to_int_visitor
     int operator()(const copperhead::cpp_tag&) const {
         return 0;
     }
+    int operator()(const copperhead::pool_tag&) const {
+        return 4;
+    }
 #ifdef CUDA_SUPPORT
     int operator()(const copperhead::cuda_tag&) const {
         return 1;
@@ -147,6 +155,7 @@ BOOST_PYTHON_MODULE(tags) {
         ;
     scope current;
     current.attr("cpp") = copperhead::detail::cpp_tag;
+    current.attr("pool") = copperhead::detail::pool_tag;
 #ifdef CUDA_SUPPORT
     current.attr("cuda") = copperhead::detail::cuda_tag;
 #endif
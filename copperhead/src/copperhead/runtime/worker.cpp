@@ -0,0 +1,262 @@
+#include "worker.hpp"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace copperhead {
+
+namespace detail {
+
+//Is this thread the worker?
+thread_local bool t_on_worker = false;
+
+//Does the calling thread hold the GIL?
+bool holds_gil() {
+#if PY_VERSION_HEX >= 0x03040000
+    return PyGILState_Check();
+#else
+    PyThreadState* t = PyGILState_GetThisThreadState();
+    return (t != NULL) && (t == _PyThreadState_Current);
+#endif
+}
+
+//Waits for events without holding the GIL, so that the worker can
+//finish the call which completes them.  The worker never waits: it
+//runs calls in order, so any event it sees belongs to the call it
+//is running, or to a later one.
+void wait_released(event& e) {
+    if (t_on_worker) {
+        return;
+    }
+    if (holds_gil()) {
+        Py_BEGIN_ALLOW_THREADS
+        block(e);
+        Py_END_ALLOW_THREADS
+    } else {
+        block(e);
+    }
+}
+
+struct job {
+    PyObject* m_fn;
+    PyObject* m_args;
+    PyObject* m_kwargs;
+    sp_future m_f;
+    sp_event m_e;
+};
+
+class worker {
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    std::deque<job*> m_queue;
+    size_t m_pending;
+    bool m_stopping;
+    std::thread m_thread;
+
+    void run() {
+        t_on_worker = true;
+        while(true) {
+            job* j;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while(m_queue.empty() && !m_stopping) {
+                    m_work.wait(lock);
+                }
+                if (m_queue.empty()) {
+                    return;
+                }
+                j = m_queue.front();
+                m_queue.pop_front();
+            }
+            PyGILState_STATE gil = PyGILState_Ensure();
+            PyObject* r = PyObject_Call(j->m_fn, j->m_args, j->m_kwargs);
+            if (r != NULL) {
+                j->m_f->set_result(r);
+            } else {
+                PyObject *type, *value, *traceback;
+                PyErr_Fetch(&type, &value, &traceback);
+                j->m_f->set_error(type, value, traceback);
+            }
+            Py_DECREF(j->m_fn);
+            Py_DECREF(j->m_args);
+            Py_XDECREF(j->m_kwargs);
+            sp_event e = j->m_e;
+            delete j;
+            PyGILState_Release(gil);
+            complete(*e);
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_pending--;
+                if (m_pending == 0) {
+                    m_idle.notify_all();
+                }
+            }
+        }
+    }
+public:
+    worker() : m_pending(0), m_stopping(false) {}
+
+    ~worker() {
+        //Exits which skip shutdown leave the thread to the process
+        if (m_thread.joinable()) {
+            m_thread.detach();
+        }
+    }
+
+    //Must be called with the GIL held
+    void push(job* j) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!m_thread.joinable()) {
+            PyEval_InitThreads();
+            m_thread = std::thread(&worker::run, this);
+        }
+        m_pending++;
+        m_queue.push_back(j);
+        m_work.notify_one();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_pending > 0) {
+            m_idle.wait(lock);
+        }
+    }
+
+    //Finishes the queued calls, then ends the thread.  Must be called
+    //without the GIL, since the calls need it.
+    void stop() {
+        drain();
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stopping = true;
+            m_work.notify_one();
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stopping = false;
+    }
+};
+
+worker g_worker;
+
+//Gives a to its own copy of any storage it borrows.  A queued call
+//runs after its caller returns, and the caller may change the numpy
+//arrays whose storage the call's inputs borrow in the meantime.
+void own_storage(const sp_cuarray& a) {
+    std::vector<boost::shared_ptr<chunk> >& chunks =
+        a->get_chunks(cpp_tag(), false);
+    for(std::vector<boost::shared_ptr<chunk> >::iterator i = chunks.begin();
+        i != chunks.end();
+        i++) {
+        if ((*i)->borrowed()) {
+            (*i)->unshare(true);
+        }
+    }
+}
+
+}
+
+future::future(const sp_event& e)
+    : m_e(e), m_result(NULL), m_type(NULL), m_value(NULL),
+      m_traceback(NULL) {}
+
+future::~future() {
+    Py_XDECREF(m_result);
+    Py_XDECREF(m_type);
+    Py_XDECREF(m_value);
+    Py_XDECREF(m_traceback);
+}
+
+bool future::ready() const {
+    return copperhead::ready(*m_e);
+}
+
+void future::wait() {
+    detail::wait_released(*m_e);
+}
+
+boost::python::object future::result() {
+    wait();
+    if (m_type != NULL) {
+        Py_INCREF(m_type);
+        Py_XINCREF(m_value);
+        Py_XINCREF(m_traceback);
+        PyErr_Restore(m_type, m_value, m_traceback);
+        boost::python::throw_error_already_set();
+    }
+    return boost::python::object(boost::python::borrowed(m_result));
+}
+
+void future::set_result(PyObject* r) {
+    m_result = r;
+}
+
+void future::set_error(PyObject* type, PyObject* value, PyObject* traceback) {
+    m_type = type;
+    m_value = value;
+    m_traceback = traceback;
+}
+
+sp_future submit(const boost::python::object& fn,
+                 const boost::python::tuple& args,
+                 const boost::python::object& out) {
+    sp_event e = make_event();
+    sp_future f(new future(e));
+    //Everything the call reads or writes waits for it
+    Py_ssize_t n = PyTuple_GET_SIZE(args.ptr());
+    for(Py_ssize_t i = 0; i < n; i++) {
+        boost::python::extract<sp_cuarray> as_cuarray(
+            PyTuple_GET_ITEM(args.ptr(), i));
+        if (as_cuarray.check()) {
+            detail::own_storage(as_cuarray());
+            as_cuarray()->set_event(e);
+        }
+    }
+    detail::job* j = new detail::job();
+    j->m_fn = boost::python::incref(fn.ptr());
+    j->m_args = boost::python::incref(args.ptr());
+    j->m_kwargs = NULL;
+    if (out.ptr() != Py_None) {
+        sp_cuarray o = boost::python::extract<sp_cuarray>(out);
+        o->set_event(e);
+        boost::python::dict keywords;
+        keywords["out"] = out;
+        j->m_kwargs = boost::python::incref(keywords.ptr());
+    }
+    j->m_f = f;
+    j->m_e = e;
+    detail::g_worker.push(j);
+    return f;
+}
+
+void synchronize() {
+    Py_BEGIN_ALLOW_THREADS
+    detail::g_worker.drain();
+    Py_END_ALLOW_THREADS
+}
+
+void shutdown() {
+    Py_BEGIN_ALLOW_THREADS
+    detail::g_worker.stop();
+    Py_END_ALLOW_THREADS
+}
+
+void export_worker() {
+    using namespace boost::python;
+    set_wait_hook(&detail::wait_released);
+    class_<future, sp_future, boost::noncopyable>("future", no_init)
+        .def("ready", &future::ready)
+        .def("wait", &future::wait)
+        .def("result", &future::result)
+        ;
+    def("submit", &submit);
+    def("synchronize", &synchronize);
+    def("shutdown", &shutdown);
+}
+
+}
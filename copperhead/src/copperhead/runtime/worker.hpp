@@ -0,0 +1,74 @@
+/*
+ *   Copyright 2012      NVIDIA Corporation
+ * 
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ * 
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ * 
+ */
+#pragma once
+#include <boost/python.hpp>
+#include <prelude/runtime/cuarray.hpp>
+#include <prelude/runtime/event.hpp>
+
+namespace copperhead {
+
+//! The result of a call made on the runtime's worker thread
+/*! Calls are run in order on a single worker thread.  The chunks of
+  the cuarrays a call uses carry its completion event until it is
+  done, so that reading them, or passing them to another call, waits
+  for it.  A future waits for the whole call, and gives its result
+  or raises its exception.
+*/
+class future {
+private:
+    sp_event m_e;
+    PyObject* m_result;
+    PyObject* m_type;
+    PyObject* m_value;
+    PyObject* m_traceback;
+    //Not copyable
+    future(const future&);
+    future& operator=(const future&);
+public:
+    future(const sp_event& e);
+    //Must be called with the GIL held
+    ~future();
+    bool ready() const;
+    //Waits for the call to finish, without holding the GIL
+    void wait();
+    //Waits for the call, then returns its result or raises its exception
+    boost::python::object result();
+    //Records the outcome of the call, with the GIL held.
+    //Steals the references.
+    void set_result(PyObject* r);
+    void set_error(PyObject* type, PyObject* value, PyObject* traceback);
+};
+
+typedef boost::shared_ptr<future> sp_future;
+
+//Queues fn(*args, out=out) on the worker thread, omitting out if it
+//is None
+sp_future submit(const boost::python::object& fn,
+                 const boost::python::tuple& args,
+                 const boost::python::object& out);
+
+//Waits until every queued call has finished
+void synchronize();
+
+//Waits until every queued call has finished, then joins the worker
+//thread.  Registered to run at exit.
+void shutdown();
+
+//Exposes futures and the worker to Python
+void export_worker();
+
+}
@@ -39,6 +39,15 @@ from test_zip import *
 from test_update import *
 from test_scan import *
 from test_filter import *
+from test_segmented import *
+from test_out import *
+from test_async import *
+from test_select import *
+from test_random import *
+from test_reduce_by_key import *
+from test_hash import *
+from test_merge import *
+from test_search import *
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,88 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+#
+from copperhead import *
+import numpy as np
+import threading
+import unittest
+from create_tests import create_tests
+
+@cu
+def incr(x):
+    return map(lambda xi: xi + 1, x)
+
+@cu
+def total(x):
+    return sum(x)
+
+class AsyncTest(unittest.TestCase):
+    def setUp(self):
+        self.x = cuarray(np.arange(1000, dtype=np.int32))
+
+    @create_tests(*runtime.backends)
+    def testFuture(self, target):
+        f = incr(self.x, target_place=runtime.driver.Async(target))
+        r = f.result()
+        self.assertTrue(f.ready())
+        self.assertEqual(list(r), range(1, 1001))
+
+    @create_tests(*runtime.backends)
+    def testPendingOut(self, target):
+        out = cuarray(np.zeros(1000, dtype=np.int32))
+        incr(self.x, out=out, target_place=runtime.driver.Async(target))
+        #Using out waits for the call which writes it
+        r = incr(out, target_place=target)
+        self.assertEqual(list(r), range(2, 1002))
+
+    @create_tests(*runtime.backends)
+    def testBorrowedInput(self, target):
+        #The call copies numpy storage when it is queued, so changing
+        #the array afterwards doesn't change its result
+        a = np.arange(1000, dtype=np.int32)
+        f = incr(a, target_place=runtime.driver.Async(target))
+        a[:] = 0
+        self.assertEqual(list(f.result()), range(1, 1001))
+
+    @create_tests(*runtime.backends)
+    def testSynchronize(self, target):
+        p = runtime.driver.Async(target)
+        futures = [incr(self.x, target_place=p) for i in range(10)]
+        runtime.cudata.synchronize()
+        self.assertTrue(all(f.ready() for f in futures))
+        self.assertEqual(list(futures[-1].result()), range(1, 1001))
+
+    @create_tests(*runtime.backends)
+    def testThreads(self, target):
+        #Compiled calls release the GIL, so Python threads may run
+        #them concurrently on shared inputs
+        total(self.x, target_place=target)
+        incr(self.x, target_place=target)
+        results = {}
+        def run(i):
+            results[i] = (total(self.x, target_place=target),
+                          list(incr(self.x, target_place=target)))
+        threads = [threading.Thread(target=run, args=(i,)) for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(len(results), 4)
+        for s, r in results.values():
+            self.assertEqual(s, 499500)
+            self.assertEqual(r, range(1, 1001))
+
+if __name__ == "__main__":
+    unittest.main()
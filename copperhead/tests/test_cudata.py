@@ -20,6 +20,10 @@ from copperhead import *
 import unittest
 from recursive_equal import recursive_equal
 
+@cu
+def incr(x):
+    return map(lambda xi: xi + 1, x)
+
 class CudataTest(unittest.TestCase):
     def testNumpyFlat(self):
         a = np.array([1,2,3,4,5])
@@ -78,6 +82,79 @@ class CudataTest(unittest.TestCase):
         [[6,7,8,9,10], [10,11,12,13,14],
         [15,16,17,18,19,20]]]
         self.assertFalse(recursive_equal(a, cuarray(b)))
-    
+    def testNumpyZeroCopy(self):
+        a = np.arange(100000, dtype=np.float64)
+        before = runtime.cudata.pool_stats()['cpp_tag']['bytes_live']
+        b = cuarray(a)
+        after = runtime.cudata.pool_stats()['cpp_tag']['bytes_live']
+        self.assertEqual(before, after)
+        del a
+        self.assertEqual(b[99999], 99999.0)
+    def testToNumpy(self):
+        a = np.arange(1000, dtype=np.int32)
+        b = to_numpy(cuarray(a))
+        self.assertEqual(b.dtype, np.int32)
+        self.assertTrue(np.all(a == b))
+    def testToNumpyView(self):
+        a = self.pooled()
+        b = to_numpy(a, copy=False)
+        self.assertFalse(b.flags.writeable)
+        del a
+        self.assertEqual(b[999], 1000.0)
+    def testToNumpyBorrowed(self):
+        #Writing to a cuarray releases the storage it borrowed, so
+        #views of that storage would dangle: they are copies instead
+        a = np.arange(1000, dtype=np.float64)
+        c = cuarray(a)
+        b = to_numpy(c, copy=False)
+        self.assertTrue(b.flags.owndata)
+        del a
+        incr(np.zeros(1000, dtype=np.float64), out=c,
+             target_place=places.sequential)
+        self.assertEqual(c[999], 1.0)
+        self.assertEqual(b[999], 999.0)
+    def testToNumpyNested(self):
+        a = cuarray([[1,2], [3,4,5], []])
+        offsets, values = to_numpy(a, copy=False)
+        self.assertEqual(list(offsets), [0, 2, 5, 5])
+        self.assertEqual(list(values), [1, 2, 3, 4, 5])
+    def pooled(self):
+        #Results of compiled functions are allocated from the pool,
+        #unlike cuarrays which borrow numpy storage
+        a = incr(np.arange(1000, dtype=np.float64),
+                 target_place=places.sequential)
+        self.assertEqual(a[999], 1000.0)
+        return a
+    def testPoolStats(self):
+        before = runtime.cudata.pool_stats()['cpp_tag']
+        a = self.pooled()
+        stats = runtime.cudata.pool_stats()['cpp_tag']
+        self.assertTrue(stats['bytes_live'] - before['bytes_live'] >= 8000)
+        self.assertTrue(stats['high_water'] >= stats['bytes_live'])
+        self.assertTrue(stats['mallocs'] >= stats['misses'])
+    def testPoolTrim(self):
+        a = self.pooled()
+        before = runtime.cudata.pool_stats()['cpp_tag']
+        del a
+        freed = runtime.cudata.pool_stats()['cpp_tag']
+        self.assertTrue(before['bytes_live'] - freed['bytes_live'] >= 8000)
+        self.assertTrue(freed['bytes_cached'] - before['bytes_cached'] >= 8000)
+        runtime.cudata.pool_trim(0)
+        stats = runtime.cudata.pool_stats()['cpp_tag']
+        self.assertEqual(stats['bytes_cached'], 0)
+        self.assertEqual(stats['bytes_live'], freed['bytes_live'])
+        runtime.cudata.pool_trim(2**62)
+    def testDispatch(self):
+        a = np.arange(10, dtype=np.int32)
+        b = incr(a, target_place=places.sequential)
+        hits = incr.dispatcher.hits
+        c = incr(cuarray(a), target_place=places.sequential)
+        self.assertEqual(incr.dispatcher.hits, hits + 1)
+        self.assertEqual(list(b), list(c))
+        #Lists aren't classified by the dispatcher, but still work
+        d = incr(range(10), target_place=places.sequential)
+        self.assertEqual(incr.dispatcher.hits, hits + 1)
+        self.assertEqual(list(d), range(1, 11))
+
 if __name__ == '__main__':
     unittest.main()
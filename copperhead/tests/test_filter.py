@@ -36,6 +36,15 @@ class GatherTest(unittest.TestCase):
     @create_tests(*runtime.backends)
     def testFilter(self, target):
         self.run_test(target, test_filter, self.source)
+
+    @create_tests(*runtime.backends)
+    def testFilterBlocks(self, target):
+        source = np.arange(100000, dtype=np.int32) % 7
+        self.run_test(target, test_filter, source)
+
+    @create_tests(*runtime.backends)
+    def testFilterEmpty(self, target):
+        self.run_test(target, test_filter, [1, 2, 3])
         
 if __name__ == "__main__":
     unittest.main()
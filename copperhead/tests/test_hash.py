@@ -0,0 +1,65 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def test_hash_group(x):
+    return hash_group(x)
+
+@cu
+def test_hash_join(l, r):
+    return hash_join(l, r)
+
+class HashTest(unittest.TestCase):
+    def setUp(self):
+        self.keys = np.array([7, 3, 7, 9, 3, 3, -1], dtype=np.int32)
+        self.right = np.array([3, 5, 7, 3, -1], dtype=np.int32)
+
+    def run_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual(list(python_result), list(copperhead_result))
+
+    @create_tests(*runtime.backends)
+    def testHashGroup(self, target):
+        self.run_test(target, test_hash_group, self.keys)
+
+    @create_tests(*runtime.backends)
+    def testHashGroupDouble(self, target):
+        #-0.0 and 0.0 compare equal, so they share a group
+        x = np.array([0.5, -0.0, 2.0, 0.0, 0.5], dtype=np.float64)
+        self.run_test(target, test_hash_group, x)
+
+    @create_tests(*runtime.backends)
+    def testLongHashGroup(self, target):
+        x = (np.arange(100000, dtype=np.int64) * 7919) % 1013
+        self.run_test(target, test_hash_group, x)
+
+    @create_tests(*runtime.backends)
+    def testHashJoin(self, target):
+        self.run_test(target, test_hash_join, self.keys, self.right)
+
+    @create_tests(*runtime.backends)
+    def testLongHashJoin(self, target):
+        l = (np.arange(20000, dtype=np.int32) * 31) % 997
+        r = np.arange(5000, dtype=np.int32) % 1500
+        self.run_test(target, test_hash_join, l, r)
+
+if __name__ == "__main__":
+    unittest.main()
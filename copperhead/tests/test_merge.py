@@ -0,0 +1,91 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def test_merge(a, b):
+    return merge(cmp_lt, a, b)
+
+@cu
+def test_merge_by_key(ka, va, kb, vb):
+    return merge_by_key(cmp_lt, ka, va, kb, vb)
+
+@cu
+def test_merge_zipped(ka, va, kb, vb):
+    def key_lt((xk, xv), (yk, yv)):
+        return xk < yk
+    return merge(key_lt, zip(ka, va), zip(kb, vb))
+
+@cu
+def test_set_intersection(a, b):
+    return set_intersection(cmp_lt, a, b)
+
+@cu
+def test_sorted_join(l, r):
+    return sorted_join(cmp_lt, l, r)
+
+class MergeTest(unittest.TestCase):
+    def setUp(self):
+        self.a = np.array([1, 2, 2, 2, 5, 8, 9], dtype=np.int32)
+        self.b = np.array([0, 2, 2, 3, 5, 9, 9, 11], dtype=np.int32)
+        self.va = np.arange(7, dtype=np.float64)
+        self.vb = -np.arange(8, dtype=np.float64)
+
+    def run_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual(list(python_result), list(copperhead_result))
+
+    @create_tests(*runtime.backends)
+    def testMerge(self, target):
+        self.run_test(target, test_merge, self.a, self.b)
+
+    @create_tests(*runtime.backends)
+    def testMergeByKey(self, target):
+        self.run_test(target, test_merge_by_key,
+                      self.a, self.va, self.b, self.vb)
+
+    @create_tests(*runtime.backends)
+    def testMergeZipped(self, target):
+        self.run_test(target, test_merge_zipped,
+                      self.a, self.va, self.b, self.vb)
+
+    @create_tests(*runtime.backends)
+    def testLongMerge(self, target):
+        #Most keys are equal, so cuts of the output fall inside runs
+        a = np.sort((np.arange(100000, dtype=np.int64) * 7919) % 7)
+        b = np.sort((np.arange(60000, dtype=np.int64) * 31) % 5)
+        self.run_test(target, test_merge, a, b)
+
+    @create_tests(*runtime.backends)
+    def testSetIntersection(self, target):
+        self.run_test(target, test_set_intersection, self.a, self.b)
+
+    @create_tests(*runtime.backends)
+    def testSortedJoin(self, target):
+        self.run_test(target, test_sorted_join, self.a, self.b)
+
+    @create_tests(*runtime.backends)
+    def testLongSortedJoin(self, target):
+        l = np.sort((np.arange(20000, dtype=np.int32) * 31) % 997)
+        r = np.sort(np.arange(5000, dtype=np.int32) % 1500)
+        self.run_test(target, test_sorted_join, l, r)
+
+if __name__ == "__main__":
+    unittest.main()
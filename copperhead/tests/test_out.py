@@ -0,0 +1,90 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+#
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def saxpy(a, x, y):
+    return map(lambda xi, yi: a * xi + yi, x, y)
+
+@cu
+def running_sum(x):
+    return scan(op_add, x)
+
+def pool_calls():
+    stats = runtime.cudata.pool_stats()['cpp_tag']
+    return stats['hits'] + stats['misses']
+
+class OutTest(unittest.TestCase):
+    def setUp(self):
+        self.x = cuarray(np.arange(1000, dtype=np.float32))
+        self.y = cuarray(np.ones(1000, dtype=np.float32))
+        self.golden = [2.0 * xi + 1.0 for xi in range(1000)]
+
+    @create_tests(*runtime.backends)
+    def testOut(self, target):
+        out = saxpy(np.float32(2.0), self.x, self.y, target_place=target)
+        result = saxpy(np.float32(3.0), self.x, self.y, out=out,
+                       target_place=target)
+        self.assertTrue(result is out)
+        self.assertEqual(list(out), [3.0 * xi + 1.0 for xi in range(1000)])
+
+    @create_tests(*runtime.backends)
+    def testOutCopied(self, target):
+        x = cuarray(np.arange(10, dtype=np.int32))
+        out = running_sum(x, target_place=target)
+        x = cuarray(np.ones(10, dtype=np.int32))
+        result = running_sum(x, out=out, target_place=target)
+        self.assertTrue(result is out)
+        self.assertEqual(list(out), range(1, 11))
+
+    def testSteadyStateAllocations(self):
+        out = saxpy(np.float32(2.0), self.x, self.y,
+                    target_place=places.sequential)
+        before = pool_calls()
+        for i in range(10):
+            saxpy(np.float32(2.0), self.x, self.y, out=out,
+                  target_place=places.sequential)
+        self.assertEqual(before, pool_calls())
+        self.assertEqual(list(out), self.golden)
+
+    def testWrongShape(self):
+        out = cuarray(np.zeros(10, dtype=np.int32))
+        x = cuarray(np.ones(20, dtype=np.int32))
+        self.assertRaises(ValueError, running_sum, x, out=out,
+                          target_place=places.sequential)
+
+    def testWrongType(self):
+        #The same number of bytes, but not the type of the result
+        out = cuarray(np.zeros(10, dtype=np.float32))
+        x = cuarray(np.ones(10, dtype=np.int32))
+        self.assertRaises(ValueError, running_sum, x, out=out,
+                          target_place=places.sequential)
+        out = cuarray(np.zeros(1000, dtype=np.int32))
+        self.assertRaises(ValueError, saxpy, np.float32(2.0), self.x,
+                          self.y, out=out,
+                          target_place=places.sequential)
+
+    def testAliasedInput(self):
+        self.assertRaises(ValueError, saxpy, np.float32(2.0), self.x,
+                          self.y, out=self.y,
+                          target_place=places.sequential)
+
+if __name__ == "__main__":
+    unittest.main()
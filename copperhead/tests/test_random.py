@@ -0,0 +1,84 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+#
+from copperhead import *
+from copperhead import prelude
+import numpy as np
+import unittest
+from create_tests import create_tests
+from recursive_equal import recursive_equal
+
+@cu
+def uniform(seed, n):
+    return random_uniform(seed, n)
+
+@cu
+def normal(seed, n):
+    return random_normal(seed, n)
+
+@cu
+def scaled_uniform(seed, x):
+    def el(xi, ui):
+        return xi * ui
+    return map(el, x, random_uniform(seed, len(x)))
+
+@cu
+def mean_normal(seed, n):
+    return sum(random_normal(seed, n)) / float64(n)
+
+class RandomTest(unittest.TestCase):
+    def setUp(self):
+        self.seed = 20121017
+        self.n = 1000
+        self.uniform = np.array(
+            prelude.random_uniform(self.seed, self.n))
+        self.normal = np.array(
+            prelude.random_normal(self.seed, self.n))
+
+    def run_test(self, target, f, g, *args):
+        with target:
+            self.assertTrue(recursive_equal(f(*args), g))
+
+    @create_tests(*runtime.backends)
+    def testUniform(self, target):
+        self.run_test(target, uniform, self.uniform, self.seed, self.n)
+
+    @create_tests(*runtime.backends)
+    def testUniformRange(self, target):
+        with target:
+            u = np.array(uniform(self.seed, self.n))
+        self.assertTrue(np.all(u >= 0.0) and np.all(u < 1.0))
+
+    @create_tests(*runtime.backends)
+    def testNormal(self, target):
+        with target:
+            z = np.array(normal(self.seed, self.n))
+        self.assertTrue(np.allclose(z, self.normal))
+
+    @create_tests(*runtime.backends)
+    def testFused(self, target):
+        x = np.arange(self.n, dtype=np.float64)
+        self.run_test(target, scaled_uniform, x * self.uniform,
+                      self.seed, x)
+
+    @create_tests(*runtime.backends)
+    def testMoments(self, target):
+        with target:
+            m = mean_normal(self.seed, 100000)
+        self.assertTrue(abs(m) < 0.02)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,70 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def test_reduce_by_key(k, v):
+    return reduce_by_key(op_add, k, v)
+
+@cu
+def test_max_by_key(k, v):
+    return reduce_by_key(maximum, k, v)
+
+@cu
+def test_group_aggregate(k, v):
+    return group_aggregate(k, v)
+
+class ReduceByKeyTest(unittest.TestCase):
+    def setUp(self):
+        self.keys = np.array([1, 1, 2, 1, 3, 3, 3, 2], dtype=np.int32)
+        self.values = np.array([1.0, 2.0, 3.0, 4.0, -1.0, 5.0, 2.5, 6.0],
+                               dtype=np.float64)
+
+    def run_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual(list(python_result), list(copperhead_result))
+
+    @create_tests(*runtime.backends)
+    def testReduceByKey(self, target):
+        self.run_test(target, test_reduce_by_key, self.keys, self.values)
+
+    @create_tests(*runtime.backends)
+    def testMaxByKey(self, target):
+        self.run_test(target, test_max_by_key, self.keys, self.values)
+
+    @create_tests(*runtime.backends)
+    def testLongRuns(self, target):
+        #Runs cross the blocks reduced in parallel
+        k = np.arange(200000, dtype=np.int64) // 30000
+        v = np.arange(200000, dtype=np.int64) % 5
+        self.run_test(target, test_reduce_by_key, k, v)
+
+    @create_tests(*runtime.backends)
+    def testGroupAggregate(self, target):
+        self.run_test(target, test_group_aggregate, self.keys, self.values)
+
+    @create_tests(*runtime.backends)
+    def testLongGroupAggregate(self, target):
+        k = (np.arange(100000, dtype=np.int32) * 7919) % 101
+        v = np.arange(100000, dtype=np.int32) % 13
+        self.run_test(target, test_group_aggregate, k, v)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -23,6 +23,12 @@ from create_tests import create_tests
 def test_rotate(x, amount):
     return rotate(x, amount)
 
+@cu
+def test_periodic(x):
+    def el(l, c, r):
+        return l - 2 * c + r
+    return map(el, rotate(x, -1), x, rotate(x, 1))
+
 class RotateTest(unittest.TestCase):
     def setUp(self):
         self.source = [1,2,3,4,5]
@@ -41,6 +47,15 @@ class RotateTest(unittest.TestCase):
     def testRotateN(self, target):
         self.run_test(target, test_rotate, self.source, -2)
 
+    @create_tests(*runtime.backends)
+    def testRotateWrap(self, target):
+        self.run_test(target, test_rotate, self.source, 12)
+
+    @create_tests(*runtime.backends)
+    def testPeriodic(self, target):
+        self.run_test(target, test_periodic,
+                      np.arange(1000, dtype=np.float64) ** 2)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -16,6 +16,7 @@
 #
 from copperhead import *
 import numpy as np
+import math
 import unittest
 from create_tests import create_tests
 from recursive_equal import recursive_equal
@@ -52,6 +53,34 @@ def test_sqrt(x):
 def test_seq_sqrt(x):
     return map(sqrt, x)
 
+@cu
+def test_seq_trig(x):
+    return map(sin, x), map(cos, x), map(tan, x)
+
+@cu
+def test_seq_erf(x):
+    return map(erf, x)
+
+@cu
+def test_seq_round(x):
+    return map(floor, x), map(ceil, x)
+
+@cu
+def test_pow(x, y):
+    return pow(x, y)
+
+@cu
+def test_seq_pow(x, y):
+    return map(pow, x, y)
+
+@cu
+def test_seq_atan2(x, y):
+    return map(atan2, x, y)
+
+@cu
+def test_seq_minmax(x, y):
+    return map(minimum, x, y), map(maximum, x, y)
+
 
 
 class ScalarMathTest(unittest.TestCase):
@@ -59,6 +88,22 @@ class ScalarMathTest(unittest.TestCase):
     def run_test(self, target, f, g, *args):
         with target:
             self.assertTrue(recursive_equal(f(*args), g))
+
+    def run_close(self, target, f, g, *args):
+        #Transcendentals are compared with a tolerance suited to the
+        #precision of the inputs
+        if args[0].dtype == np.float32:
+            tol = 1e-5
+        else:
+            tol = 1e-12
+        with target:
+            r = f(*args)
+            if not isinstance(g, tuple):
+                r, g = (r,), (g,)
+            self.assertEqual(len(r), len(g))
+            for ri, gi in zip(r, g):
+                self.assertTrue(np.allclose(np.array(ri, dtype=np.float64),
+                                            gi, rtol=tol, atol=tol))
             
     @create_tests(*runtime.backends)
     def testAbs(self, target):
@@ -111,6 +156,56 @@ class ScalarMathTest(unittest.TestCase):
         e_b = np.sqrt(b)
         self.run_test(target, test_seq_sqrt, [e_a, e_b], *([a, b],))
 
+    @create_tests(*runtime.backends)
+    def testTrigSeq(self, target):
+        for dtype in (np.float32, np.float64):
+            a = np.array([-2.5, -1.0, -0.3, 0.0, 0.7, 1.2, 3.0], dtype=dtype)
+            x = a.astype(np.float64)
+            self.run_close(target, test_seq_trig,
+                           (np.sin(x), np.cos(x), np.tan(x)), a)
+
+    @create_tests(*runtime.backends)
+    def testErfSeq(self, target):
+        for dtype in (np.float32, np.float64):
+            a = np.array([-2.0, -0.5, 0.0, 0.1, 0.8, 1.5, 3.0], dtype=dtype)
+            e = np.array([math.erf(x) for x in a.astype(np.float64)])
+            self.run_close(target, test_seq_erf, e, a)
+
+    @create_tests(*runtime.backends)
+    def testRoundSeq(self, target):
+        a = np.array([-1.5, 0.25, 2.0], dtype=np.float32)
+        self.run_test(target, test_seq_round,
+                      ([-2, 0, 2], [-1, 1, 2]), a)
+
+    @create_tests(*runtime.backends)
+    def testPow(self, target):
+        self.run_test(target, test_pow, 1024.0,
+                      *(np.float64(2), np.float64(10)))
+
+    @create_tests(*runtime.backends)
+    def testPowSeq(self, target):
+        a = np.array([2, 3], dtype=np.float32)
+        b = np.array([3, 2], dtype=np.float32)
+        self.run_test(target, test_seq_pow, [8, 9], *(a, b))
+
+    @create_tests(*runtime.backends)
+    def testAtan2Seq(self, target):
+        #Every quadrant, and both axes
+        for dtype in (np.float32, np.float64):
+            a = np.array([1.0, 2.0, -1.5, -0.5, 0.0, 3.0, 0.0, -2.0],
+                         dtype=dtype)
+            b = np.array([1.0, -0.5, -2.0, 4.0, 1.0, 0.0, -1.0, 0.0],
+                         dtype=dtype)
+            e = np.arctan2(a.astype(np.float64), b.astype(np.float64))
+            self.run_close(target, test_seq_atan2, e, *(a, b))
+
+    @create_tests(*runtime.backends)
+    def testMinMaxSeq(self, target):
+        a = np.array([1, 5, -2], dtype=np.int32)
+        b = np.array([3, 4, -2], dtype=np.int32)
+        self.run_test(target, test_seq_minmax,
+                      ([1, 4, -2], [3, 5, -2]), *(a, b))
+
 
 
 if __name__ == "__main__":
@@ -39,6 +39,29 @@ def test_exclusive_scan(x):
 def test_exclusive_rscan(x):
     return exclusive_rscan(fn, cast_to_el(0, x), x)
 
+@cu
+def test_scan_chain(x):
+    a = scan(fn, x)
+    b = scan(fn, a)
+    c = rscan(fn, b)
+    d = map(lambda ai, ci: ai + ci, a, c)
+    return exclusive_scan(fn, cast_to_el(0, x), d)
+
+@cu
+def test_donated_chain(x):
+    a = map(lambda xi: xi + 1, x)
+    b = scan(fn, a)
+    c = sort(cmp_gt, b)
+    d = rscan(fn, c)
+    return exclusive_scan(fn, cast_to_el(0, x), d)
+
+@cu
+def test_shared_input(x):
+    a = map(lambda xi: xi + 1, x)
+    b = scan(fn, a)
+    c = sort(cmp_lt, a)
+    return map(lambda bi, ci: bi - ci, b, c)
+
 class ScanTest(unittest.TestCase):
     def setUp(self):
         self.source = [1,2,3,4,5]
@@ -64,6 +87,18 @@ class ScanTest(unittest.TestCase):
     @create_tests(*runtime.backends)
     def testExrscan(self, target):
         self.run_test(target, test_exclusive_rscan, self.source)
+
+    @create_tests(*runtime.backends)
+    def testScanChain(self, target):
+        self.run_test(target, test_scan_chain, self.source)
+
+    @create_tests(*runtime.backends)
+    def testDonatedChain(self, target):
+        self.run_test(target, test_donated_chain, [3, 1, 4, 1, 5, 9, 2, 6])
+
+    @create_tests(*runtime.backends)
+    def testSharedInput(self, target):
+        self.run_test(target, test_shared_input, [3, 1, 4, 1, 5, 9, 2, 6])
         
         
 if __name__ == "__main__":
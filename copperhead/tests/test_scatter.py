@@ -23,6 +23,10 @@ from create_tests import create_tests
 def test_permute(x, i):
     return permute(x, i)
 
+@cu
+def test_map_permute(x, i):
+    return permute(map(lambda xi: xi + 1, x), i)
+
 class PermuteTest(unittest.TestCase):
     def setUp(self):
         self.source = [1,2,3,4,5]
@@ -37,11 +41,19 @@ class PermuteTest(unittest.TestCase):
     def testPermute(self, target):
         self.run_test(target, test_permute, self.source, self.idx)
 
+    @create_tests(*runtime.backends)
+    def testMapPermute(self, target):
+        self.run_test(target, test_map_permute, self.source, self.idx)
+
 
 @cu
 def test_scatter(x, i, d):
     return scatter(x, i, d)
 
+@cu
+def test_map_scatter(x, i, d):
+    return scatter(map(lambda xi: xi + 1, x), i, map(lambda di: di * 2, d))
+
 class ScatterTest(unittest.TestCase):
     def setUp(self):
         self.source = [1,2]
@@ -56,6 +68,10 @@ class ScatterTest(unittest.TestCase):
     def testPermute(self, target):
         self.run_test(target, test_scatter, self.source, self.idx, self.dest)
 
+    @create_tests(*runtime.backends)
+    def testMapScatter(self, target):
+        self.run_test(target, test_map_scatter, self.source, self.idx, self.dest)
+
         
         
 if __name__ == "__main__":
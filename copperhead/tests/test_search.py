@@ -0,0 +1,82 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def test_lower_bound(h, x):
+    return lower_bound(h, x)
+
+@cu
+def test_upper_bound(h, x):
+    return upper_bound(h, x)
+
+@cu
+def test_searchsorted(h, x):
+    return searchsorted(h, x)
+
+@cu
+def test_bucket_gather(h, x):
+    return gather(h, lower_bound(h, x))
+
+class SearchTest(unittest.TestCase):
+    def setUp(self):
+        self.haystack = np.array([1, 3, 3, 3, 7, 10, 12], dtype=np.int32)
+        self.needles = np.array([3, 0, 12, 8, 3, 13, 7], dtype=np.int32)
+
+    def run_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual(list(python_result), list(copperhead_result))
+
+    @create_tests(*runtime.backends)
+    def testLowerBound(self, target):
+        self.run_test(target, test_lower_bound, self.haystack, self.needles)
+
+    @create_tests(*runtime.backends)
+    def testUpperBound(self, target):
+        self.run_test(target, test_upper_bound, self.haystack, self.needles)
+
+    @create_tests(*runtime.backends)
+    def testSearchsorted(self, target):
+        self.run_test(target, test_searchsorted, self.haystack, self.needles)
+
+    @create_tests(*runtime.backends)
+    def testSortedNeedles(self, target):
+        #Sorted needles walk the haystack along merge path cuts
+        h = np.sort((np.arange(50000, dtype=np.int64) * 7919) % 20011)
+        x = np.arange(40000, dtype=np.int64) // 2
+        self.run_test(target, test_lower_bound, h, x)
+        self.run_test(target, test_upper_bound, h, x)
+
+    @create_tests(*runtime.backends)
+    def testUnsortedNeedles(self, target):
+        #Unsorted needles are searched for in Eytzinger order
+        h = np.sort((np.arange(50000, dtype=np.float64) * 0.37) % 1000.0)
+        x = (np.arange(60000, dtype=np.float64) * 7.31) % 1100.0 - 50.0
+        self.run_test(target, test_lower_bound, h, x)
+        self.run_test(target, test_upper_bound, h, x)
+
+    @create_tests(*runtime.backends)
+    def testBucketGather(self, target):
+        h = np.array([0.0, 1.0, 2.5, 4.0], dtype=np.float64)
+        x = np.array([0.5, 4.0, 2.5, 0.0, 3.9], dtype=np.float64)
+        self.run_test(target, test_bucket_gather, h, x)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,112 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+#
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+
+@cu
+def fn(xa, xb):
+    return xa + xb + 1
+
+@cu
+def test_segmented_reduce(x):
+    return segmented_reduce(fn, x, 0)
+
+@cu
+def test_segmented_scan(x):
+    return segmented_scan(fn, x)
+
+@cu
+def test_segmented_exclusive_scan(x):
+    return segmented_exclusive_scan(fn, 0, x)
+
+@cu
+def test_nested_reduce(x):
+    return map(lambda xi: reduce(fn, xi, 0), x)
+
+@cu
+def test_nested_scan(x):
+    return map(lambda xi: scan(fn, xi), x)
+
+@cu
+def test_nested_sum(x):
+    return map(sum, x)
+
+@cu
+def test_nested_map(x, y):
+    return map(lambda xi: map(lambda xij: xij + y, xi), x)
+
+class SegmentedTest(unittest.TestCase):
+    def setUp(self):
+        self.source = [[1,2,3], [], [4], [5,6,7,8,9], []]
+        self.skewed = [range(1000), [1], [], [2,3]]
+
+    def run_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual(list(python_result), list(copperhead_result))
+
+    def run_nested_test(self, target, fn, *args):
+        python_result = fn(*args, target_place=places.here)
+        copperhead_result = fn(*args, target_place=target)
+        self.assertEqual([list(x) for x in python_result],
+                         [list(x) for x in copperhead_result])
+
+    def segmented(self, f, primitive):
+        #Was the nested operation in f flattened to primitive?
+        return any(primitive + '(' in source
+                   for code in f.get_code().values()
+                   for source in code)
+
+    @create_tests(*runtime.backends)
+    def testSegmentedReduce(self, target):
+        self.run_test(target, test_segmented_reduce, self.source)
+
+    @create_tests(*runtime.backends)
+    def testSegmentedReduceSkewed(self, target):
+        self.run_test(target, test_segmented_reduce, self.skewed)
+
+    @create_tests(*runtime.backends)
+    def testSegmentedScan(self, target):
+        self.run_nested_test(target, test_segmented_scan, self.source)
+
+    @create_tests(*runtime.backends)
+    def testSegmentedExscan(self, target):
+        self.run_nested_test(target, test_segmented_exclusive_scan, self.source)
+
+    @create_tests(*runtime.backends)
+    def testNestedReduce(self, target):
+        self.run_test(target, test_nested_reduce, self.skewed)
+        self.assertTrue(self.segmented(test_nested_reduce, 'segmented_reduce'))
+
+    @create_tests(*runtime.backends)
+    def testNestedSum(self, target):
+        self.run_test(target, test_nested_sum, self.skewed)
+        self.assertTrue(self.segmented(test_nested_sum, 'segmented_reduce'))
+
+    @create_tests(*runtime.backends)
+    def testNestedScan(self, target):
+        self.run_nested_test(target, test_nested_scan, self.source)
+        self.assertTrue(self.segmented(test_nested_scan, 'segmented_scan'))
+
+    @create_tests(*runtime.backends)
+    def testNestedMap(self, target):
+        self.run_nested_test(target, test_nested_map, self.source, 2)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,88 @@
+#
+#   Copyright 2012      NVIDIA Corporation
+# 
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+# 
+#       http://www.apache.org/licenses/LICENSE-2.0
+# 
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# 
+#
+from copperhead import *
+import numpy as np
+import unittest
+from create_tests import create_tests
+from recursive_equal import recursive_equal
+
+@cu
+def clamp(x, lo, hi):
+    def el(xi):
+        if xi < lo:
+            return lo
+        elif xi > hi:
+            return hi
+        else:
+            return xi
+    return map(el, x)
+
+@cu
+def reflect(x):
+    def el(xi):
+        if xi < 0.0:
+            y = 1.0 - xi
+            return y * y
+        else:
+            return xi
+    return map(el, x)
+
+@cu
+def safe_div(x, y):
+    def el(xi, yi):
+        if yi != 0:
+            return xi / yi
+        else:
+            return 0
+    return map(el, x, y)
+
+class SelectTest(unittest.TestCase):
+    def setUp(self):
+        self.floats = np.array([-2.0, -0.5, 0.0, 0.5, 2.0], dtype=np.float64)
+
+    def run_test(self, target, f, g, *args):
+        with target:
+            self.assertTrue(recursive_equal(f(*args), g))
+
+    def selected(self, f):
+        #Was the conditional in f lowered to a select?
+        return any('op_select(' in source
+                   for code in f.get_code().values()
+                   for source in code)
+
+    @create_tests(*runtime.backends)
+    def testClamp(self, target):
+        self.run_test(target, clamp, [-1.0, -0.5, 0.0, 0.5, 1.0],
+                      self.floats, np.float64(-1.0), np.float64(1.0))
+        self.assertTrue(self.selected(clamp))
+
+    @create_tests(*runtime.backends)
+    def testReflect(self, target):
+        self.run_test(target, reflect, [9.0, 2.25, 0.0, 0.5, 2.0],
+                      self.floats)
+        self.assertTrue(self.selected(reflect))
+
+    @create_tests(*runtime.backends)
+    def testSafeDiv(self, target):
+        x = np.array([6, 5, 4], dtype=np.int32)
+        y = np.array([3, 0, 2], dtype=np.int32)
+        self.run_test(target, safe_div, [2, 0, 2], x, y)
+        #Integer division may trap, so it is never speculated
+        self.assertFalse(self.selected(safe_div))
+
+if __name__ == "__main__":
+    unittest.main()
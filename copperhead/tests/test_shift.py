@@ -23,6 +23,25 @@ from create_tests import create_tests
 def test_shift(x, amount, boundary):
     return shift(x, amount, boundary)
 
+@cu
+def test_stencil(x):
+    def el(l, c, r):
+        return l + 2 * c + r
+    return map(el, shift(x, -1, 0), x, shift(x, 1, 0))
+
+@cu
+def test_wide_stencil(x, w):
+    def el(ll, l, c, r, rr):
+        return w * (ll + rr) + l - c + r
+    return map(el, shift(x, -2, 1.0), shift(x, -1, 1.0), x,
+               shift(x, 1, 1.0), shift(x, 2, 1.0))
+
+@cu
+def test_far_stencil(x):
+    def el(l, c, r):
+        return l - c + 2 * r
+    return map(el, shift(x, -9, 3), x, shift(x, 12, 3))
+
 class ShiftTest(unittest.TestCase):
     def setUp(self):
         self.source = [1,2,3,4,5]
@@ -31,6 +50,13 @@ class ShiftTest(unittest.TestCase):
         python_result = fn(*args, target_place=places.here)
         copperhead_result = fn(*args, target_place=target)
         self.assertEqual(list(python_result), list(copperhead_result))
+
+    def stenciled(self, f):
+        #Was the map of shifts in f lowered to a stencil?
+        return any('stencil(' in source
+                   for code in f.get_code().values()
+                   for source in code)
+
     @create_tests(*runtime.backends)
     def testShiftP(self, target):
         self.run_test(target, test_shift, self.source, 2, 3)
@@ -39,6 +65,28 @@ class ShiftTest(unittest.TestCase):
     def testShiftN(self, target):
         self.run_test(target, test_shift, self.source, -2, 4)
 
+    @create_tests(*runtime.backends)
+    def testShiftPastEnd(self, target):
+        self.run_test(target, test_shift, self.source, 7, 0)
+
+    @create_tests(*runtime.backends)
+    def testStencil(self, target):
+        self.run_test(target, test_stencil, np.arange(1000, dtype=np.int32))
+        self.assertTrue(self.stenciled(test_stencil))
+
+    @create_tests(*runtime.backends)
+    def testWideStencil(self, target):
+        #Long enough to span several tiles
+        x = np.arange(40000, dtype=np.float64) % 17
+        self.run_test(target, test_wide_stencil, x, 0.5)
+        self.assertTrue(self.stenciled(test_wide_stencil))
+
+    @create_tests(*runtime.backends)
+    def testFarStencil(self, target):
+        #Offsets reach past both ends of the input
+        self.run_test(target, test_far_stencil, self.source)
+        self.assertTrue(self.stenciled(test_far_stencil))
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -28,6 +28,22 @@ def lt_sort(x):
 def gt_sort(x):
     return sort(cmp_gt, x)
 
+@cu
+def map_sort(x):
+    return sort(cmp_lt, map(lambda xi: xi * 2, x))
+
+@cu
+def lt_argsort(x):
+    return argsort(cmp_lt, x)
+
+@cu
+def gt_sort_by_key(k, v):
+    return sort_by_key(cmp_gt, k, v)
+
+@cu
+def zipped_sort_by_key(k, a, b):
+    return sort_by_key(cmp_lt, k, zip(a, b))
+
 class SortTest(unittest.TestCase):
     def setUp(self):
         self.source = np.array([random.random() for x in range(5)], dtype=np.float32)
@@ -46,6 +62,55 @@ class SortTest(unittest.TestCase):
     def testGtSort(self, target):
         self.run_test(target, gt_sort, self.source)
 
+    @create_tests(*runtime.backends)
+    def testMapSort(self, target):
+        self.run_test(target, map_sort, self.source)
+
+    @create_tests(*runtime.backends)
+    def testLongSort(self, target):
+        #Long enough to split into several radix sort blocks
+        x = np.array([random.randint(-1000, 1000) for i in range(100000)],
+                     dtype=np.int32)
+        self.run_test(target, lt_sort, x)
+        self.run_test(target, gt_sort, x)
+
+    @create_tests(*runtime.backends)
+    def testDoubleSort(self, target):
+        x = np.array([-2.5, 0.0, 3.0, -1e300, 1e-300, 3.0, -0.5],
+                     dtype=np.float64)
+        self.run_test(target, lt_sort, x)
+        self.run_test(target, gt_sort, x)
+
+    @create_tests(*runtime.backends)
+    def testArgsort(self, target):
+        x = np.array([3, 1, 2, 1, 3, 0], dtype=np.int64)
+        self.run_test(target, lt_argsort, x)
+
+    @create_tests(*runtime.backends)
+    def testSortByKey(self, target):
+        k = np.array([2, 5, 2, 1, 5, 0], dtype=np.int32)
+        v = np.array([0.5, 1.5, 2.5, 3.5, 4.5, 5.5], dtype=np.float32)
+        self.run_test(target, gt_sort_by_key, k, v)
+
+    @create_tests(*runtime.backends)
+    def testZippedSortByKey(self, target):
+        k = np.array([0.25, -1.0, 0.25, 7.0], dtype=np.float32)
+        a = np.array([1, 2, 3, 4], dtype=np.int32)
+        b = np.array([10.0, 20.0, 30.0, 40.0], dtype=np.float64)
+        self.run_test(target, zipped_sort_by_key, k, a, b)
+
+    @create_tests(*runtime.backends)
+    def testSignedZeros(self, target):
+        #-0.0 and 0.0 compare equal, so they keep their order
+        for dtype in (np.float32, np.float64):
+            x = np.array([0.0, -0.0, 1.0, -0.0, 0.0, -1.0, -0.0, 0.0],
+                         dtype=dtype)
+            v = np.arange(len(x), dtype=np.int32)
+            self.run_test(target, lt_argsort, x)
+            self.run_test(target, gt_sort_by_key, x, v)
+            #Sorting keeps the sign of each zero
+            s = np.array(lt_sort(x, target_place=target))
+            self.assertEqual(np.sum(np.signbit(s)), np.sum(np.signbit(x)))
 
 if __name__ == "__main__":
     unittest.main()